@@ -2,15 +2,16 @@
 #include "config.h"
 #include "X11.h"
 #include "util.h"
-#include "image.h"
 
 #include <X11/Xatom.h>
+#include <X11/Xutil.h>
 
 #include <assert.h>
 #include <string.h>
 #include <ranges>
 #include <algorithm>
-#include <fstream>
+#include <future>
+#include <optional>
 
 static Display* display = nullptr;
 
@@ -117,11 +118,7 @@ const RRMonitorInfo get_monitors()
 
 const std::string get_atom_name(Atom name)
 {
-    assert(display);
-    char* atom_name = XGetAtomName(display, name);
-    const std::string atom_name_str = atom_name;
-    XFree(atom_name);
-    return atom_name_str;
+    return get_atom_name_async(name).get();
 }
 
 
@@ -130,6 +127,7 @@ void set_display(Display* _display)
     display = _display;
 }
 
+
 Display* get_display()
 {
     assert(display);
@@ -165,32 +163,38 @@ const bool allow_events(int event_mode, Time time)
 
 const Pos get_cursor_position()
 {
-    assert(display);
-    Pos position;
-	Window window_return;
-    int others;
-    uint mask_return;
-    XQueryPointer(display, DefaultRootWindow(display), &window_return, &window_return, &position.x, &position.y, &others, &others, &mask_return);
-	return position;
+    return get_cursor_position_async().get();
 }
 
 
 void grab_key(KeySym key_sym, unsigned int main_modifier, Window window)
 {
     assert(display);
-    XGrabKey(display, XKeysymToKeycode(display, key_sym), main_modifier | Mod2Mask, window, false, GrabModeAsync, GrabModeAsync);
-    XGrabKey(display, XKeysymToKeycode(display, key_sym), main_modifier, window, false, GrabModeAsync, GrabModeAsync);
-    XGrabKey(display, XKeysymToKeycode(display, key_sym), main_modifier | LockMask, window, false, GrabModeAsync, GrabModeAsync);
-    XGrabKey(display, XKeysymToKeycode(display, key_sym), main_modifier | Mod2Mask | LockMask, window, false, GrabModeAsync, GrabModeAsync);
+
+    //Keysyms the keyboard does not have would grab AnyKey
+    const KeyCode keycode = XKeysymToKeycode(display, key_sym);
+    if (keycode == 0)
+        return;
+
+    XGrabKey(display, keycode, main_modifier | Mod2Mask, window, false, GrabModeAsync, GrabModeAsync);
+    XGrabKey(display, keycode, main_modifier, window, false, GrabModeAsync, GrabModeAsync);
+    XGrabKey(display, keycode, main_modifier | LockMask, window, false, GrabModeAsync, GrabModeAsync);
+    XGrabKey(display, keycode, main_modifier | Mod2Mask | LockMask, window, false, GrabModeAsync, GrabModeAsync);
 }
 
 void ungrab_key(KeySym key_sym, unsigned int main_modifier, Window window)
 {
     assert(display);
-    XUngrabKey(display, XKeysymToKeycode(display, key_sym), main_modifier, window);
-    XUngrabKey(display, XKeysymToKeycode(display, key_sym), main_modifier | Mod2Mask, window);
-    XUngrabKey(display, XKeysymToKeycode(display, key_sym), main_modifier | LockMask, window);
-    XUngrabKey(display, XKeysymToKeycode(display, key_sym), main_modifier | Mod2Mask | LockMask, window);
+
+    //Keycode 0 is AnyKey, it would drop every grab with these modifiers
+    const KeyCode keycode = XKeysymToKeycode(display, key_sym);
+    if (keycode == 0)
+        return;
+
+    XUngrabKey(display, keycode, main_modifier, window);
+    XUngrabKey(display, keycode, main_modifier | Mod2Mask, window);
+    XUngrabKey(display, keycode, main_modifier | LockMask, window);
+    XUngrabKey(display, keycode, main_modifier | Mod2Mask | LockMask, window);
 }
 
 void grab_button(int button, unsigned int main_modifier, Window window, unsigned int masks)
@@ -214,18 +218,17 @@ void ungrab_button(int button, unsigned int main_modifier, Window window)
 
 const WindowAttributes get_window_attributes(Window window)
 {
-    assert(display);
-    XWindowAttributes attr = { 0 };
-    XGetWindowAttributes(display, window, &attr);
-    return {attr.x, attr.y, (uint)attr.width, (uint)attr.height, attr.map_state, (bool)attr.override_redirect};
+    return get_window_attributes_async(window).get();
 }
 
 const WindowProperty get_window_property(Window window, Atom property)
 {
-    assert(display);
-	WindowProperty window_property;
-    window_property.status = XGetWindowProperty(display, window, property, 0, 1024, False, AnyPropertyType, &window_property.type, &window_property.format, &window_property.n_items, &window_property.bytes_after, &window_property.property_value);
-	return std::move(window_property);
+    return get_window_property_async(window, property).get();
+}
+
+const std::string get_window_name(Window window)
+{
+    return get_window_name_async(window).get();
 }
 
 const bool change_window_property(Window window, Atom property, Atom type, const int size, const unsigned char* new_property)
@@ -237,13 +240,7 @@ const bool change_window_property(Window window, Atom property, Atom type, const
 
 const WindowTree query_window_tree(Window window)
 {
-    assert(display);
-    WindowTree window_tree;
-    Window* windows = nullptr;
-    unsigned int n_windows = 0;
-    window_tree.status = XQueryTree(display, window, &window_tree.root, &window_tree.parent, &windows, &n_windows);
-    window_tree.windows = std::span<Window>(windows, n_windows);
-    return std::move(window_tree);
+    return query_window_tree_async(window).get();
 }
 
 
@@ -275,12 +272,9 @@ const bool set_background_color(Window window, Color background_color)
 
 const bool close_window(Window window)
 {
-    Atom* supported_protocols;
-    int num_supported_protocols;
-    const int status = XGetWMProtocols(display, window, &supported_protocols, &num_supported_protocols);
-
-    const bool b_protocol_exists = std::ranges::contains(std::span(supported_protocols, num_supported_protocols), X11::atoms.wm_delete_window);
-    XFree(supported_protocols);
+    const WindowProperty protocols_property = get_window_property(window, atoms.wm_protocols);
+    const bool b_protocol_exists = protocols_property.status == Success && protocols_property.format == 32
+        && std::ranges::contains(std::span((Atom*)protocols_property.property_value, protocols_property.n_items), atoms.wm_delete_window);
 
     if(b_protocol_exists)
     {
@@ -301,10 +295,10 @@ const bool close_window(Window window)
 
 const bool kill_window(Window window)
 {
+    //Requests are processed in order, so there is no need to wait for the kill before ungrabbing
     XGrabServer(display);
     XSetCloseDownMode(display, DestroyAll);
     const int kill_result = XKillClient(display, window);
-    XSync(display, false);
     XUngrabServer(display);
     return kill_result == Success;
 }
@@ -376,79 +370,139 @@ const bool resize_window(Window window, const Rect& size)
     return XResizeWindow(display, window, size.width, size.height) == Success;
 }
 
+const bool move_resize_window(Window window, const Rect& geometry)
+{
+    assert(display);
+    return XMoveResizeWindow(display, window, geometry.x, geometry.y, geometry.width, geometry.height) == Success;
+}
+
 
-Image* retrieve_window_icon(Window window)
+static std::string property_string(const WindowProperty& property)
 {
-    Image* image = new Image();
-    Atom type_return;
-    int format_return;
-    unsigned long nitems_return;
-    unsigned long bytes_after_return;
-    unsigned char* data_return = nullptr;
+    if (property.status != Success || property.format != 8 || !property.property_value)
+        return "";
 
-    int status = XGetWindowProperty(X11::get_display(), window, X11::atoms.window_icon, 0, 1, false, X11::atoms.cardinal, &type_return, &format_return, &nitems_return, &bytes_after_return, &data_return);
-    if (status == Success && data_return)
-    {
-        const int width = *(unsigned int*)data_return;
-        XFree(data_return);
+    return std::string((const char*)property.property_value, property.n_items);
+}
 
-        XGetWindowProperty(X11::get_display(), window, X11::atoms.window_icon, 1, 1, false, X11::atoms.cardinal, &type_return, &format_return, &nitems_return, &bytes_after_return, &data_return);
-        const int height = *(unsigned int*)data_return;
-        XFree(data_return);
+//The properties the icon cache looks at. WM_CLASS and WM_ICON_NAME are small, _NET_WM_ICON can be megabytes.
+struct icon_requests
+{
+    std::future<WindowProperty> window_class;
+    std::future<WindowProperty> icon_name;
+    std::future<WindowProperty> icon;
+};
 
-        XGetWindowProperty(X11::get_display(), window, X11::atoms.window_icon, 2, width * height, false, X11::atoms.cardinal, &type_return, &format_return, &nitems_return, &bytes_after_return, &data_return);
-        uint32_t* img_data = new uint32_t[width * height];
-        const ulong* ul = (ulong*)data_return;
+static icon_requests request_icon(Window window)
+{
+    const long max_property_length = 0x100000;
 
-        for (int i = 0; i < nitems_return; i++)
-            img_data[i] = (uint32_t)ul[i];
+    return {
+        get_window_property_async(window, atoms.window_class),
+        get_window_property_async(window, atoms.window_icon_name),
+        get_window_property_async(window, atoms.window_icon, max_property_length)
+    };
+}
 
-        XFree(data_return);
+static void collect_icon(icon_requests& requests, WindowPrefetch& prefetch)
+{
+    //WM_CLASS holds the instance and class name separated by \0, only the instance is used
+    prefetch.window_class = property_string(requests.window_class.get()).c_str();
+    prefetch.icon_name = property_string(requests.icon_name.get()).c_str();
 
-        image->image = imlib_create_image_using_data(width, height, img_data);
-        if (image->image)
-            return image;
-    }
+    const WindowProperty icon_property = requests.icon.get();
+    if (icon_property.status == Success && icon_property.format == 32)
+        prefetch.icon_data.assign((const unsigned long*)icon_property.property_value, (const unsigned long*)icon_property.property_value + icon_property.n_items);
+}
 
-    status = XGetWindowProperty(X11::get_display(), window, X11::atoms.window_icon_name, 0, 1024, False, AnyPropertyType, &type_return, &format_return, &nitems_return, &bytes_after_return, &data_return);
-    if (status == Success && type_return != None && format_return == 8 && data_return)
+const std::vector<WindowPrefetch> prefetch_windows(std::span<const Window> windows, bool b_only_viewable)
+{
+    struct name_requests
     {
-        image->image = imlib_load_image(std::string("/usr/share/icons/hicolor/256x256/apps/" + std::string((const char*)data_return) + ".png").c_str());
-        XFree(data_return);
-        if (image->image)
-            return image;
-    }
+        std::future<WindowProperty> net_wm_name;
+        std::future<WindowProperty> wm_name;
+        icon_requests icon;
+    };
+
+    struct window_requests
+    {
+        std::future<WindowAttributes> attributes;
+        std::future<WindowProperty> window_type;
+        std::optional<name_requests> names;
+    };
 
-    status = XGetWindowProperty(X11::get_display(), window, X11::atoms.window_class, 0, 1024, False, AnyPropertyType, &type_return, &format_return, &nitems_return, &bytes_after_return, &data_return);
-    if (status == Success && type_return != None && format_return == 8 && data_return)
+    auto request_names = [](Window window)
     {
-        std::ifstream desktop_file("/usr/share/applications/" + std::string((const char*)data_return) + ".desktop");
-        std::cout << (const char*)data_return << std::endl;
+        return name_requests{get_window_property_async(window, atoms.net_wm_name), get_window_property_async(window, atoms.window_name), request_icon(window)};
+    };
+
+    //Send every request first. With the xcb backend nothing blocks until the first reply is collected.
+    //A window that is being mapped gets everything in this one batch. At startup most top level windows never get
+    //a frame, so their names and icons are only requested once their attributes show they will.
+    std::future<Pos> cursor_position = get_cursor_position_async();
+
+    std::vector<window_requests> requests;
+    requests.reserve(windows.size());
+    for (Window window : windows)
+        requests.push_back({get_window_attributes_async(window), get_window_property_async(window, atoms.window_type), b_only_viewable ? std::nullopt : std::optional(request_names(window))});
 
-        if (!desktop_file.is_open())
-            return nullptr;
+    flush();
+
+    const Pos collected_cursor_position = cursor_position.get();
+
+    std::vector<WindowPrefetch> prefetches(windows.size());
+    bool b_second_batch = false;
+    for (size_t i = 0; i < windows.size(); ++i)
+    {
+        WindowPrefetch& prefetch = prefetches[i];
+        prefetch.window = windows[i];
+        prefetch.cursor_position = collected_cursor_position;
+        prefetch.attributes = requests[i].attributes.get();
 
-        std::string line;
-        std::string icon_name;
+        const WindowProperty type_property = requests[i].window_type.get();
+        if (type_property.status == Success && type_property.format == 32)
+            prefetch.window_type.assign((Atom*)type_property.property_value, (Atom*)type_property.property_value + type_property.n_items);
 
-        while (getline(desktop_file, line))
+        if (!requests[i].names && !prefetch.attributes.override_redirect && prefetch.attributes.map_state == IsViewable)
         {
-            if (line.find("Icon") != std::string::npos)
-            {
-                size_t Del = line.find("=");
-                icon_name = line.substr(Del + 1);
-                break;
-            }
+            requests[i].names = request_names(windows[i]);
+            b_second_batch = true;
         }
+    }
+
+    if (b_second_batch)
+        flush();
+
+    for (size_t i = 0; i < windows.size(); ++i)
+    {
+        if (!requests[i].names)
+            continue;
 
-        desktop_file.close();
-        XFree(data_return);
+        WindowPrefetch& prefetch = prefetches[i];
+        prefetch.name = property_string(requests[i].names->net_wm_name.get());
+        const std::string wm_name = property_string(requests[i].names->wm_name.get());
+        if (prefetch.name.empty())
+            prefetch.name = wm_name;
 
-        image->image = imlib_load_image(std::string("/usr/share/icons/hicolor/256x256/apps/" + icon_name + ".png").c_str());
-        if (image->image)
-            return image;
+        collect_icon(requests[i].names->icon, prefetch);
     }
 
-    return nullptr;
+    return prefetches;
+}
+
+const WindowPrefetch prefetch_window(Window window)
+{
+    return std::move(prefetch_windows(std::span(&window, 1), false)[0]);
+}
+
+const WindowPrefetch prefetch_window_icon(Window window)
+{
+    WindowPrefetch prefetch;
+    prefetch.window = window;
+
+    icon_requests requests = request_icon(window);
+    flush();
+    collect_icon(requests, prefetch);
+    return prefetch;
 }
 };
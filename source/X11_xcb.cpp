@@ -0,0 +1,183 @@
+#include "X11.h"
+
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <assert.h>
+
+/**
+ * xcb implementation of the X11 requests that need a reply.
+ * xcb shares the connection with Xlib. Every request is sent as soon as the async function is called and
+ * the future only waits for the reply, so any number of requests can be in flight at once.
+*/
+namespace X11
+{
+static xcb_connection_t* get_connection()
+{
+    return XGetXCBConnection(get_display());
+}
+
+//Errors are collected here instead of going through the Xlib error handler, the window may already be gone
+template <typename Reply>
+static Reply* collect_reply(Reply* reply, xcb_generic_error_t** error)
+{
+    free(*error);
+    *error = nullptr;
+    return reply;
+}
+
+void flush()
+{
+    XFlush(get_display());
+    xcb_flush(get_connection());
+}
+
+std::future<std::string> get_atom_name_async(Atom name)
+{
+    const xcb_get_atom_name_cookie_t cookie = xcb_get_atom_name(get_connection(), name);
+    return std::async(std::launch::deferred, [cookie]()
+    {
+        xcb_generic_error_t* error = nullptr;
+        xcb_get_atom_name_reply_t* reply = collect_reply(xcb_get_atom_name_reply(get_connection(), cookie, &error), &error);
+        if (!reply)
+            return std::string();
+
+        const std::string atom_name(xcb_get_atom_name_name(reply), xcb_get_atom_name_name_length(reply));
+        free(reply);
+        return atom_name;
+    });
+}
+
+std::future<Pos> get_cursor_position_async()
+{
+    const xcb_query_pointer_cookie_t cookie = xcb_query_pointer(get_connection(), get_root_window());
+    return std::async(std::launch::deferred, [cookie]()
+    {
+        Pos position = {0, 0};
+        xcb_generic_error_t* error = nullptr;
+        if (xcb_query_pointer_reply_t* reply = collect_reply(xcb_query_pointer_reply(get_connection(), cookie, &error), &error))
+        {
+            position = {reply->root_x, reply->root_y};
+            free(reply);
+        }
+        return position;
+    });
+}
+
+std::future<WindowAttributes> get_window_attributes_async(Window window)
+{
+    //Xlib's XGetWindowAttributes is two requests as well
+    const xcb_get_window_attributes_cookie_t attributes_cookie = xcb_get_window_attributes(get_connection(), window);
+    const xcb_get_geometry_cookie_t geometry_cookie = xcb_get_geometry(get_connection(), window);
+    return std::async(std::launch::deferred, [attributes_cookie, geometry_cookie]()
+    {
+        WindowAttributes attributes = {};
+        xcb_generic_error_t* error = nullptr;
+
+        if (xcb_get_window_attributes_reply_t* reply = collect_reply(xcb_get_window_attributes_reply(get_connection(), attributes_cookie, &error), &error))
+        {
+            attributes.map_state = reply->map_state;
+            attributes.override_redirect = reply->override_redirect;
+            free(reply);
+        }
+
+        if (xcb_get_geometry_reply_t* reply = collect_reply(xcb_get_geometry_reply(get_connection(), geometry_cookie, &error), &error))
+        {
+            attributes.geometry = {reply->x, reply->y, reply->width, reply->height};
+            free(reply);
+        }
+
+        return attributes;
+    });
+}
+
+std::future<WindowProperty> get_window_property_async(Window window, Atom property, long max_length)
+{
+    const xcb_get_property_cookie_t cookie = xcb_get_property(get_connection(), false, window, property, XCB_GET_PROPERTY_TYPE_ANY, 0, max_length);
+    return std::async(std::launch::deferred, [cookie]()
+    {
+        WindowProperty window_property;
+        window_property.type = None;
+
+        xcb_generic_error_t* error = nullptr;
+        xcb_get_property_reply_t* reply = xcb_get_property_reply(get_connection(), cookie, &error);
+        if (!reply)
+        {
+            window_property.status = error ? error->error_code : BadImplementation;
+            free(error);
+            return window_property;
+        }
+
+        window_property.status = Success;
+        window_property.type = reply->type;
+        window_property.format = reply->format;
+        window_property.bytes_after = reply->bytes_after;
+        window_property.n_items = reply->value_len;
+
+        //Match what XGetWindowProperty hands out: format 32 items are longs and there is always a trailing \0
+        if (reply->format != 0)
+        {
+            const size_t item_size = reply->format == 32 ? sizeof(long) : reply->format / 8;
+            window_property.property_value = (unsigned char*)calloc(reply->value_len * item_size + 1, 1);
+
+            if (reply->format == 32)
+            {
+                const uint32_t* values = (const uint32_t*)xcb_get_property_value(reply);
+                for (uint32_t i = 0; i < reply->value_len; ++i)
+                    ((unsigned long*)window_property.property_value)[i] = values[i];
+            }
+            else memcpy(window_property.property_value, xcb_get_property_value(reply), xcb_get_property_value_length(reply));
+        }
+
+        free(reply);
+        return window_property;
+    });
+}
+
+std::future<std::string> get_window_name_async(Window window)
+{
+    const xcb_get_property_cookie_t cookie = xcb_get_property(get_connection(), false, window, XCB_ATOM_WM_NAME, XCB_GET_PROPERTY_TYPE_ANY, 0, 1024);
+    return std::async(std::launch::deferred, [cookie]()
+    {
+        xcb_generic_error_t* error = nullptr;
+        xcb_get_property_reply_t* reply = collect_reply(xcb_get_property_reply(get_connection(), cookie, &error), &error);
+        if (!reply)
+            return std::string();
+
+        const std::string window_name = reply->format == 8 ? std::string((const char*)xcb_get_property_value(reply), xcb_get_property_value_length(reply)) : "";
+        free(reply);
+        return window_name;
+    });
+}
+
+std::future<WindowTree> query_window_tree_async(Window window)
+{
+    const xcb_query_tree_cookie_t cookie = xcb_query_tree(get_connection(), window);
+    return std::async(std::launch::deferred, [cookie]()
+    {
+        WindowTree window_tree;
+
+        xcb_generic_error_t* error = nullptr;
+        xcb_query_tree_reply_t* reply = collect_reply(xcb_query_tree_reply(get_connection(), cookie, &error), &error);
+        if (!reply)
+            return window_tree;
+
+        //WindowTree frees the list with XFree, which is free
+        const int n_windows = xcb_query_tree_children_length(reply);
+        const xcb_window_t* children = xcb_query_tree_children(reply);
+        Window* windows = (Window*)malloc(std::max(n_windows, 1) * sizeof(Window));
+        for (int i = 0; i < n_windows; ++i)
+            windows[i] = children[i];
+
+        window_tree.status = 1;
+        window_tree.root = reply->root;
+        window_tree.parent = reply->parent;
+        window_tree.windows = std::span<Window>(windows, n_windows);
+        free(reply);
+        return window_tree;
+    });
+}
+};
@@ -0,0 +1,89 @@
+#include "X11.h"
+
+#include <X11/Xutil.h>
+
+#include <assert.h>
+
+/**
+ * Xlib implementation of the X11 requests that need a reply.
+ * Xlib cannot send a request without waiting for its reply, so the futures are deferred and the request
+ * is made when the future is read.
+*/
+namespace X11
+{
+void flush()
+{
+    XFlush(get_display());
+}
+
+std::future<std::string> get_atom_name_async(Atom name)
+{
+    return std::async(std::launch::deferred, [name]()
+    {
+        char* atom_name = XGetAtomName(get_display(), name);
+        const std::string atom_name_str = atom_name ? atom_name : "";
+        XFree(atom_name);
+        return atom_name_str;
+    });
+}
+
+std::future<Pos> get_cursor_position_async()
+{
+    return std::async(std::launch::deferred, []()
+    {
+        Pos position = {0, 0};
+        Window window_return;
+        int others;
+        uint mask_return;
+        XQueryPointer(get_display(), get_root_window(), &window_return, &window_return, &position.x, &position.y, &others, &others, &mask_return);
+        return position;
+    });
+}
+
+std::future<WindowAttributes> get_window_attributes_async(Window window)
+{
+    return std::async(std::launch::deferred, [window]()
+    {
+        XWindowAttributes attr = { 0 };
+        XGetWindowAttributes(get_display(), window, &attr);
+        return WindowAttributes{attr.x, attr.y, (uint)attr.width, (uint)attr.height, attr.map_state, (bool)attr.override_redirect};
+    });
+}
+
+std::future<WindowProperty> get_window_property_async(Window window, Atom property, long max_length)
+{
+    return std::async(std::launch::deferred, [window, property, max_length]()
+    {
+        WindowProperty window_property;
+        window_property.status = XGetWindowProperty(get_display(), window, property, 0, max_length, False, AnyPropertyType, &window_property.type, &window_property.format, &window_property.n_items, &window_property.bytes_after, &window_property.property_value);
+        return window_property;
+    });
+}
+
+std::future<std::string> get_window_name_async(Window window)
+{
+    return std::async(std::launch::deferred, [window]()
+    {
+        XTextProperty name = { 0 };
+        if (!XGetWMName(get_display(), window, &name) || !name.value)
+            return std::string();
+
+        const std::string window_name = (const char*)name.value;
+        XFree(name.value);
+        return window_name;
+    });
+}
+
+std::future<WindowTree> query_window_tree_async(Window window)
+{
+    return std::async(std::launch::deferred, [window]()
+    {
+        WindowTree window_tree;
+        Window* windows = nullptr;
+        unsigned int n_windows = 0;
+        window_tree.status = XQueryTree(get_display(), window, &window_tree.root, &window_tree.parent, &windows, &n_windows);
+        window_tree.windows = std::span<Window>(windows, n_windows);
+        return window_tree;
+    });
+}
+};
@@ -1,75 +1,461 @@
-
 #include "background.h"
+#include "config.h"
+#include "event_loop.h"
+#include "image_decoder.h"
+#include "util.h"
 #include "X11.h"
 
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <X11/Xatom.h>
+#include <X11/extensions/Xrandr.h>
+
+#include <sys/stat.h>
 
-#include <Imlib2.h>
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <thread>
 
-namespace EshyBg
+namespace fs = std::filesystem;
+
+enum EBackgroundMode : uint8_t
 {
-void set_background(const std::string& file_path)
+    BM_Fill,
+    BM_Fit,
+    BM_Span
+};
+
+//The part of the wallpaper that covers one monitor
+struct wallpaper_tile
 {
-    Imlib_Image bg_image = imlib_load_image(file_path.c_str());;
-    if (!bg_image)
-        return;
+    Rect monitor;
+    EBackgroundMode mode;
+    //Span tiles are cut out of one image covering this box
+    Rect span_box;
+    //monitor.width * monitor.height opaque ARGB pixels, filled in by the worker
+    std::vector<uint32_t> pixels;
+};
 
-    const auto monitor_info = X11::get_monitors();
-    if (monitor_info.monitors.size() == 0)
-        return;
+struct wallpaper_job
+{
+    uint64_t generation;
+    std::string file_path;
+    std::vector<wallpaper_tile> tiles;
+};
+
+//Header of a cached tile, followed by width * height pixels
+struct tile_file_header
+{
+    char magic[8];
+    uint32_t width;
+    uint32_t height;
+};
+
+static const char TILE_MAGIC[8] = {'E', 'S', 'H', 'Y', 'W', 'P', '0', '1'};
+static const size_t MAX_CACHED_TILES = 16;
+
+static std::string background_path;
+static Pixmap wallpaper_pixmap = None;
+//Results of older jobs are dropped, only the newest set of outputs is drawn
+static uint64_t generation = 0;
+
+static std::thread worker;
+static std::mutex job_mutex;
+static std::condition_variable job_condition;
+static std::optional<wallpaper_job> pending_job;
+static bool b_stop_worker = false;
+
+//The config allows the path in quotes and starting with $HOME or ~ since it used to go through a shell
+static std::string expand_path(std::string path)
+{
+    if (path.size() >= 2 && path.front() == '"' && path.back() == '"')
+        path = path.substr(1, path.size() - 2);
+
+    const char* home = getenv("HOME");
+    if (home && path.starts_with("$HOME"))
+        path = home + path.substr(5);
+    else if (home && path.starts_with("~"))
+        path = home + path.substr(1);
+
+    return path;
+}
+
+static EBackgroundMode parse_mode(const std::string& mode)
+{
+    if (mode == "fit")
+        return BM_Fit;
+    if (mode == "span")
+        return BM_Span;
+
+    return BM_Fill;
+}
+
+//background_output_modes is a comma separated list of output=mode, outputs that are not listed use background_mode
+static EBackgroundMode get_output_mode(const std::string& output_name)
+{
+    const std::string& overrides = EshyWMConfig::background_output_modes;
+
+    for (size_t start = 0; start < overrides.size();)
+    {
+        size_t end = overrides.find(',', start);
+        if (end == std::string::npos)
+            end = overrides.size();
+
+        const std::string entry = overrides.substr(start, end - start);
+        const size_t separator = entry.find('=');
+        if (separator != std::string::npos && entry.substr(0, separator) == output_name)
+            return parse_mode(entry.substr(separator + 1));
+
+        start = end + 1;
+    }
 
-    const int width = monitor_info.monitors[0].width;
-    const int height = monitor_info.monitors[0].height; 
+    return parse_mode(EshyWMConfig::background_mode);
+}
+
+static fs::path get_cache_directory()
+{
+    const char* cache_home = getenv("XDG_CACHE_HOME");
+    const fs::path cache_directory = (cache_home && *cache_home) ? fs::path(cache_home) : fs::path(getenv("HOME")) / ".cache";
+    return cache_directory / "eshywm" / "wallpapers";
+}
+
+//Everything the scaled pixels of a tile depend on, hashed with FNV-1a
+static std::string get_tile_key(const std::string& file_path, const struct stat& file_stat, const wallpaper_tile& tile)
+{
+    std::string key = file_path + '\n' + std::to_string(file_stat.st_mtim.tv_sec) + '.' + std::to_string(file_stat.st_mtim.tv_nsec) + '\n'
+        + std::to_string(tile.mode) + '\n' + std::to_string(tile.monitor.width) + 'x' + std::to_string(tile.monitor.height);
+
+    //Where a span tile sits in the span box decides which part of the image it shows
+    if (tile.mode == BM_Span)
+    {
+        key += '\n' + std::to_string(tile.span_box.width) + 'x' + std::to_string(tile.span_box.height)
+            + '+' + std::to_string(tile.monitor.x - tile.span_box.x) + '+' + std::to_string(tile.monitor.y - tile.span_box.y);
+    }
+
+    uint64_t hash = 14695981039346656037ull;
+    for (const char c : key)
+    {
+        hash ^= (unsigned char)c;
+        hash *= 1099511628211ull;
+    }
+
+    char name[17];
+    snprintf(name, sizeof(name), "%016lx", (unsigned long)hash);
+    return name;
+}
+
+static bool read_tile_file(const fs::path& path, wallpaper_tile& tile)
+{
+    std::ifstream file(path, std::ios::binary);
+    tile_file_header header;
+    if (!file.read((char*)&header, sizeof(header)) || memcmp(header.magic, TILE_MAGIC, sizeof(TILE_MAGIC)) != 0
+        || header.width != tile.monitor.width || header.height != tile.monitor.height)
+        return false;
+
+    tile.pixels.resize((size_t)header.width * header.height);
+    if (!file.read((char*)tile.pixels.data(), tile.pixels.size() * sizeof(uint32_t)))
+    {
+        tile.pixels.clear();
+        return false;
+    }
 
-    Display* display1 = X11::get_display();
-    if (!display1)
+    return true;
+}
+
+//Written next to the final file and renamed over it, so a half written tile is never read
+static void write_tile_file(const fs::path& path, const wallpaper_tile& tile)
+{
+    std::error_code error;
+    fs::create_directories(path.parent_path(), error);
+
+    tile_file_header header;
+    memcpy(header.magic, TILE_MAGIC, sizeof(TILE_MAGIC));
+    header.width = tile.monitor.width;
+    header.height = tile.monitor.height;
+
+    const fs::path temporary_path = path.string() + ".tmp";
+    {
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+        file.write((const char*)&header, sizeof(header));
+        file.write((const char*)tile.pixels.data(), tile.pixels.size() * sizeof(uint32_t));
+        if (!file)
+        {
+            LOGE("Failed to cache a scaled wallpaper");
+            return;
+        }
+    }
+
+    rename(temporary_path.c_str(), path.c_str());
+}
+
+//Keeps the newest tiles, a tile is a full screen of pixels
+static void prune_cache(const fs::path& directory)
+{
+    std::error_code error;
+    std::vector<fs::directory_entry> entries;
+    for (const fs::directory_entry& entry : fs::directory_iterator(directory, error))
+        entries.push_back(entry);
+
+    if (entries.size() <= MAX_CACHED_TILES)
         return;
-    
-    Window root1 = X11::get_root_window();
-    const auto depth1 = DefaultDepth(display1, DefaultScreen(display1));
-
-    const Pixmap bg_pixmap1 = XCreatePixmap(display1, root1, width, height, depth1);
-    imlib_context_set_drawable(bg_pixmap1);
-    imlib_context_set_image(bg_image);
-    imlib_render_image_on_drawable_at_size(0, 0, width, height);
-    imlib_free_image();
-
-    //Open new display and copy pixmap over; done on a second display because nothing should have to interact with the wallpaper
-    Display* display2 = XOpenDisplay(NULL);
-    if (!display2)
+
+    std::sort(entries.begin(), entries.end(), [](const fs::directory_entry& a, const fs::directory_entry& b)
+    {
+        std::error_code error;
+        return a.last_write_time(error) > b.last_write_time(error);
+    });
+
+    for (size_t i = MAX_CACHED_TILES; i < entries.size(); ++i)
+        fs::remove(entries[i].path(), error);
+}
+
+//Runs on the worker thread
+static void render_tile(const decoded_image& image, wallpaper_tile& tile)
+{
+    const double image_width = image.width;
+    const double image_height = image.height;
+
+    //Region of the image to use and where it goes on the monitor
+    double source_x = 0, source_y = 0, source_width = image_width, source_height = image_height;
+    Rect destination = {0, 0, tile.monitor.width, tile.monitor.height};
+
+    if (tile.mode == BM_Fit)
+    {
+        const double scale = std::min(tile.monitor.width / image_width, tile.monitor.height / image_height);
+        destination.width = std::max<uint>(image_width * scale, 1);
+        destination.height = std::max<uint>(image_height * scale, 1);
+        destination.x = (tile.monitor.width - destination.width) / 2;
+        destination.y = (tile.monitor.height - destination.height) / 2;
+    }
+    else
+    {
+        //The image covers the box, centered, and the monitor shows its part of the box
+        const Rect box = tile.mode == BM_Span ? tile.span_box : tile.monitor;
+        const double scale = std::max(box.width / image_width, box.height / image_height);
+        const double offset_x = (box.width - image_width * scale) / 2;
+        const double offset_y = (box.height - image_height * scale) / 2;
+
+        source_x = (tile.monitor.x - box.x - offset_x) / scale;
+        source_y = (tile.monitor.y - box.y - offset_y) / scale;
+        source_width = tile.monitor.width / scale;
+        source_height = tile.monitor.height / scale;
+    }
+
+    tile.pixels.assign((size_t)tile.monitor.width * tile.monitor.height, 0xFF000000);
+
+    uint32_t* const target = tile.pixels.data() + (size_t)destination.y * tile.monitor.width + destination.x;
+    ImageDecoder::scale(image, source_x, source_y, std::max(source_width, 1.0), std::max(source_height, 1.0), destination.width, destination.height, target, tile.monitor.width);
+
+    for (uint y = 0; y < destination.height; ++y)
+    {
+        uint32_t* row = target + (size_t)y * tile.monitor.width;
+        std::for_each(row, row + destination.width, [](uint32_t& pixel){ pixel |= 0xFF000000; });
+    }
+}
+
+//Returns false if the wallpaper could not be loaded
+static bool run_job(wallpaper_job& job)
+{
+    struct stat file_stat;
+    if (stat(job.file_path.c_str(), &file_stat) != 0)
+    {
+        LOGE("Failed to read the wallpaper");
+        return false;
+    }
+
+    const fs::path cache_directory = get_cache_directory();
+    std::vector<wallpaper_tile*> missing;
+
+    for (wallpaper_tile& tile : job.tiles)
+    {
+        if (!read_tile_file(cache_directory / get_tile_key(job.file_path, file_stat, tile), tile))
+            missing.push_back(&tile);
+    }
+
+    if (!missing.empty())
+    {
+        //Decoded and scaled without the idle mutex, the event thread only gets the finished pixels
+        decoded_image image;
+        if (!ImageDecoder::load_file(job.file_path, image))
+        {
+            LOGE("Failed to load the wallpaper");
+            return false;
+        }
+
+        for (wallpaper_tile* tile : missing)
+            render_tile(image, *tile);
+
+        for (wallpaper_tile* tile : missing)
+            write_tile_file(cache_directory / get_tile_key(job.file_path, file_stat, *tile), *tile);
+
+        prune_cache(cache_directory);
+    }
+
+    return true;
+}
+
+static void apply_tiles(const std::vector<wallpaper_tile>& tiles);
+
+static void wallpaper_worker()
+{
+    while (true)
+    {
+        wallpaper_job job;
+        {
+            std::unique_lock<std::mutex> lock(job_mutex);
+            job_condition.wait(lock, [](){ return b_stop_worker || pending_job; });
+            if (b_stop_worker)
+                return;
+
+            job = std::move(*pending_job);
+            pending_job.reset();
+        }
+
+        if (!run_job(job))
+            continue;
+
+        EventLoop::post([job = std::make_shared<wallpaper_job>(std::move(job))]()
+        {
+            if (job->generation == generation)
+                apply_tiles(job->tiles);
+        });
+    }
+}
+
+//Puts every tile on one new pixmap and makes it the root background
+static void apply_tiles(const std::vector<wallpaper_tile>& tiles)
+{
+    Display* display = X11::get_display();
+    const int screen = DefaultScreen(display);
+    const int depth = DefaultDepth(display, screen);
+    const Window root = X11::get_root_window();
+
+    if (tiles.empty() || (depth != 24 && depth != 32))
         return;
 
-    Window root2 = XRootWindow(display2, DefaultScreen(display2));
-    const auto depth2 = DefaultDepth(display2, DefaultScreen(display2));
-    XSync(display1, false);
-    const Pixmap bg_pixmap2 = XCreatePixmap(display2, root2, width, height, depth2);
+    //Every monitor lies inside the root window, which is resized along with the outputs
+    uint root_width = 0;
+    uint root_height = 0;
+    for (const wallpaper_tile& tile : tiles)
+    {
+        root_width = std::max<uint>(root_width, tile.monitor.x + tile.monitor.width);
+        root_height = std::max<uint>(root_height, tile.monitor.y + tile.monitor.height);
+    }
+
+    const Pixmap pixmap = XCreatePixmap(display, root, root_width, root_height, depth);
+    GC gc = XCreateGC(display, pixmap, 0, nullptr);
+    XSetForeground(display, gc, BlackPixel(display, screen));
+    XFillRectangle(display, pixmap, gc, 0, 0, root_width, root_height);
+
+    for (const wallpaper_tile& tile : tiles)
+    {
+        if (tile.pixels.size() != (size_t)tile.monitor.width * tile.monitor.height)
+            continue;
+
+        XImage* image = XCreateImage(display, DefaultVisual(display, screen), depth, ZPixmap, 0, (char*)tile.pixels.data(), tile.monitor.width, tile.monitor.height, 32, 0);
+        XPutImage(display, pixmap, gc, image, 0, 0, tile.monitor.x, tile.monitor.y, tile.monitor.width, tile.monitor.height);
+
+        //The pixels belong to the tile
+        image->data = nullptr;
+        XDestroyImage(image);
+    }
 
-    XGCValues gc_values;
-    gc_values.fill_style = FillTiled;
-    gc_values.tile = bg_pixmap1;
+    XFreeGC(display, gc);
 
-    GC bg_gc = XCreateGC(display2, bg_pixmap2, GCFillStyle | GCTile, &gc_values);
-    XFillRectangle(display2, bg_pixmap2, bg_gc, 0, 0, width, height);
-    XFreeGC(display2, bg_gc);
-    XSync(display2, false);
-    XSync(display1, false);
-    XFreePixmap(display1, bg_pixmap1);
+    //Compositors and pseudo transparent clients read the wallpaper from these
+    const Atom prop_root = XInternAtom(display, "_XROOTPMAP_ID", False);
+    const Atom prop_esetroot = XInternAtom(display, "ESETROOT_PMAP_ID", False);
+    XChangeProperty(display, root, prop_root, XA_PIXMAP, 32, PropModeReplace, (unsigned char*)&pixmap, 1);
+    XChangeProperty(display, root, prop_esetroot, XA_PIXMAP, 32, PropModeReplace, (unsigned char*)&pixmap, 1);
 
-	const Atom prop_root = XInternAtom(display2, "_XROOTPMAP_ID", False);
-	const Atom prop_esetroot = XInternAtom(display2, "ESETROOT_PMAP_ID", False);
+    XSetWindowBackgroundPixmap(display, root, pixmap);
+    XClearWindow(display, root);
 
-	if (prop_root == None || prop_esetroot == None)
+    if (wallpaper_pixmap != None)
+        XFreePixmap(display, wallpaper_pixmap);
+
+    wallpaper_pixmap = pixmap;
+    XFlush(display);
+}
+
+
+void EshyBg::set_background(const std::string& file_path)
+{
+    background_path = expand_path(file_path);
+    update_outputs();
+}
+
+void EshyBg::update_outputs()
+{
+    if (background_path.empty())
         return;
 
-	XChangeProperty(display2, root2, prop_root, XA_PIXMAP, 32, PropModeReplace, (unsigned char*)&bg_pixmap2, 1);
-	XChangeProperty(display2, root2, prop_esetroot, XA_PIXMAP, 32, PropModeReplace, (unsigned char*)&bg_pixmap2, 1);
+    wallpaper_job job;
+    job.generation = ++generation;
+    job.file_path = background_path;
+
+    const X11::RRMonitorInfo monitor_info = X11::get_monitors();
+    for (const XRRMonitorInfo& monitor : monitor_info.monitors)
+    {
+        if (monitor.width <= 0 || monitor.height <= 0)
+            continue;
+
+        wallpaper_tile tile;
+        tile.monitor = {monitor.x, monitor.y, (uint)monitor.width, (uint)monitor.height};
+        tile.mode = get_output_mode(X11::get_atom_name(monitor.name));
+        job.tiles.push_back(std::move(tile));
+    }
+
+    //Monitors in span mode share the box around all of them
+    Rect span_box = {0, 0, 0, 0};
+    bool b_has_span = false;
+    for (const wallpaper_tile& tile : job.tiles)
+    {
+        if (tile.mode != BM_Span)
+            continue;
+
+        if (!b_has_span)
+        {
+            span_box = tile.monitor;
+            b_has_span = true;
+            continue;
+        }
 
-    XSetWindowBackgroundPixmap(display2, root2, bg_pixmap2);
-    XClearWindow(display2, root2);
+        const int right = std::max(span_box.x + (int)span_box.width, tile.monitor.x + (int)tile.monitor.width);
+        const int bottom = std::max(span_box.y + (int)span_box.height, tile.monitor.y + (int)tile.monitor.height);
+        span_box.x = std::min(span_box.x, tile.monitor.x);
+        span_box.y = std::min(span_box.y, tile.monitor.y);
+        span_box.width = right - span_box.x;
+        span_box.height = bottom - span_box.y;
+    }
+
+    for (wallpaper_tile& tile : job.tiles)
+        tile.span_box = span_box;
+
+    {
+        const std::lock_guard<std::mutex> lock(job_mutex);
+        pending_job = std::move(job);
+
+        if (!worker.joinable())
+            worker = std::thread(wallpaper_worker);
+    }
+    job_condition.notify_one();
+}
+
+void EshyBg::shutdown()
+{
+    {
+        const std::lock_guard<std::mutex> lock(job_mutex);
+        b_stop_worker = true;
+        pending_job.reset();
+    }
+    job_condition.notify_one();
 
-    XSetCloseDownMode(display2, RetainPermanent);
-    XCloseDisplay(display2);
+    if (worker.joinable())
+        worker.join();
 }
-}
\ No newline at end of file
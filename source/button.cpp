@@ -107,3 +107,9 @@ void ImageButton::set_image(const Imlib_Image& new_image)
     draw();
 }
 
+void ImageButton::set_image(const char* image_path)
+{
+    delete button_image;
+    button_image = new Image(image_path);
+    draw();
+}
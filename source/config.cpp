@@ -1,8 +1,30 @@
 #include "config.h"
 
-#include <fstream>
-#include <iostream>
-#include <cstring>
+#include "event_loop.h"
+#include "util.h"
+
+#include <X11/Xlib.h>
+
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <variant>
+
+using namespace std::chrono_literals;
 
 //Window frame
 uint EshyWMConfig::window_frame_border_width = 10;
@@ -32,18 +54,43 @@ uint EshyWMConfig::switcher_button_padding = 20;
 ulong EshyWMConfig::switcher_button_color = 0x888888;
 ulong EshyWMConfig::switcher_button_border_color = 0x444444;
 ulong EshyWMConfig::switcher_color = 0xaeb3bd;
+bool EshyWMConfig::switcher_thumbnails = false;
+ulong EshyWMConfig::switcher_thumbnail_refresh_interval = 250;
 //General click time
 ulong EshyWMConfig::double_click_time = 500;
 //Background image path
 std::string EshyWMConfig::background_path = "";
+std::string EshyWMConfig::background_mode = "fill";
+std::string EshyWMConfig::background_output_modes = "";
 std::string EshyWMConfig::default_application_image_path = "";
 
 std::vector<EshyWMConfig::KeyBinding> EshyWMConfig::key_bindings;
 
 std::vector<std::string> EshyWMConfig::startup_commands;
+//Launched commands
+std::string EshyWMConfig::launcher_working_directory = "";
+std::vector<std::string> EshyWMConfig::launcher_environment;
+bool EshyWMConfig::launcher_setsid = true;
+//Tiling
+std::string EshyWMConfig::tiling_layout = "floating";
+uint EshyWMConfig::tiling_gap = 0;
+float EshyWMConfig::tiling_master_ratio = 0.55f;
+//Status providers
+std::string EshyWMConfig::status_clock_format = "%a %d %b %H:%M";
+std::string EshyWMConfig::status_network_interface = "";
+std::vector<std::string> EshyWMConfig::status_scripts;
+//Status bar
+bool EshyWMConfig::status_bar = false;
+std::string EshyWMConfig::status_bar_position = "top";
+uint EshyWMConfig::status_bar_height = 24;
+ulong EshyWMConfig::status_bar_color = 0x15141f;
+ulong EshyWMConfig::status_bar_text_color = 0xededed;
+ulong EshyWMConfig::status_bar_highlight_color = 0x423d66;
+std::string EshyWMConfig::status_bar_providers = "cpu memory network battery clock";
+
 std::unordered_map<std::string, std::string> EshyWMConfig::window_close_data;
 
-enum VarType
+enum VarType : uint8_t
 {
     VT_INT,
     VT_UINT,
@@ -52,164 +99,856 @@ enum VarType
     VT_ULONG_HEX,
     VT_FLOAT,
     VT_STRING,
-    VT_BOOL
+    VT_STRING_LIST,
+    VT_BOOL,
+    VT_KEY
 };
 
-struct key_value_pair
+struct config_option
+{
+    std::string_view name;
+    VarType type;
+    //The global the option sets, nullptr for the key binding options which only make sense in pairs
+    void* value;
+    //EConfigChange flags for what has to be updated when the option changes on a reload
+    uint32_t change;
+};
+
+//A key as written in the config. The name is looked up on the event thread, Xlib's keysym lookup is not thread safe
+struct config_key
+{
+    std::string name;
+    uint modifiers = 0;
+    //Where the value starts, for the error if the name is not a keysym
+    size_t line_number = 0;
+    size_t column = 0;
+
+    bool operator==(const config_key&) const = default;
+};
+
+//Holds whichever type matches the VarType of the option
+typedef std::variant<int, uint, ulong, float, bool, std::string, std::vector<std::string>, config_key> config_value;
+
+struct parsed_key_binding
 {
-    std::string key;
-    std::string value;
+    config_key key;
+    std::string command;
+};
+
+//Every option in config_options order and the key bindings, as read from one pass over the file
+struct parsed_config
+{
+    std::vector<config_value> values;
+    std::vector<parsed_key_binding> key_bindings;
+};
+
+//A line split into its option name and value, columns are 1 based for diagnostics
+struct config_line
+{
+    std::string_view key;
+    std::string_view value;
+    size_t key_column;
+    size_t value_column;
 };
 
 const std::string CONFIG_FILE_PATH = std::string(getenv("HOME")) + "/.config/eshywm/eshywm.conf";
 const std::string DATA_FILE_PATH = std::string(getenv("HOME")) + "/.eshywm";
 
-static void parse_config_option(std::string line, VarType type, void* config_var, std::string option_name)
+static constexpr config_option config_options[] = {
+    {"startup_command", VT_STRING_LIST, &EshyWMConfig::startup_commands, EshyWMConfig::CC_NONE},
+    {"keybind_key", VT_KEY, nullptr, EshyWMConfig::CC_NONE},
+    {"keybind_command", VT_STRING, nullptr, EshyWMConfig::CC_NONE},
+    {"launcher_working_directory", VT_STRING, &EshyWMConfig::launcher_working_directory, EshyWMConfig::CC_NONE},
+    {"launcher_environment", VT_STRING_LIST, &EshyWMConfig::launcher_environment, EshyWMConfig::CC_NONE},
+    {"launcher_setsid", VT_BOOL, &EshyWMConfig::launcher_setsid, EshyWMConfig::CC_NONE},
+    {"tiling_layout", VT_STRING, &EshyWMConfig::tiling_layout, EshyWMConfig::CC_Layout},
+    {"tiling_gap", VT_UINT, &EshyWMConfig::tiling_gap, EshyWMConfig::CC_Tiling},
+    {"tiling_master_ratio", VT_FLOAT, &EshyWMConfig::tiling_master_ratio, EshyWMConfig::CC_Tiling},
+    {"status_clock_format", VT_STRING, &EshyWMConfig::status_clock_format, EshyWMConfig::CC_StatusBar},
+    {"status_network_interface", VT_STRING, &EshyWMConfig::status_network_interface, EshyWMConfig::CC_StatusBar},
+    {"status_script", VT_STRING_LIST, &EshyWMConfig::status_scripts, EshyWMConfig::CC_StatusBar},
+
+    {"background", VT_STRING, &EshyWMConfig::background_path, EshyWMConfig::CC_Background},
+    {"background_mode", VT_STRING, &EshyWMConfig::background_mode, EshyWMConfig::CC_Background},
+    {"background_output_modes", VT_STRING, &EshyWMConfig::background_output_modes, EshyWMConfig::CC_Background},
+    {"default_application_image_path", VT_STRING, &EshyWMConfig::default_application_image_path, EshyWMConfig::CC_Icons},
+
+    {"window_frame_border_width", VT_UINT, &EshyWMConfig::window_frame_border_width, EshyWMConfig::CC_Border},
+    {"window_frame_border_color", VT_ULONG_HEX, &EshyWMConfig::window_frame_border_color, EshyWMConfig::CC_Border},
+    {"window_background_color", VT_ULONG_HEX, &EshyWMConfig::window_background_color, EshyWMConfig::CC_Titlebar | EshyWMConfig::CC_Icons},
+    {"close_button_color", VT_ULONG_HEX, &EshyWMConfig::close_button_color, EshyWMConfig::CC_Titlebar},
+    {"minimize_button_image_path", VT_STRING, &EshyWMConfig::minimize_button_image_path, EshyWMConfig::CC_Titlebar},
+    {"maximize_button_image_path", VT_STRING, &EshyWMConfig::maximize_button_image_path, EshyWMConfig::CC_Titlebar},
+    {"close_button_image_path", VT_STRING, &EshyWMConfig::close_button_image_path, EshyWMConfig::CC_Titlebar},
+
+    {"window_opacity_step", VT_FLOAT, &EshyWMConfig::window_opacity_step, EshyWMConfig::CC_NONE},
+    {"window_x_movement_step", VT_INT, &EshyWMConfig::window_x_movement_step, EshyWMConfig::CC_NONE},
+    {"window_y_movement_step", VT_INT, &EshyWMConfig::window_y_movement_step, EshyWMConfig::CC_NONE},
+    {"window_width_resize_step", VT_INT, &EshyWMConfig::window_width_resize_step, EshyWMConfig::CC_NONE},
+    {"window_height_resize_step", VT_INT, &EshyWMConfig::window_height_resize_step, EshyWMConfig::CC_NONE},
+
+    {"titlebar_height", VT_UINT, &EshyWMConfig::titlebar_height, EshyWMConfig::CC_Titlebar | EshyWMConfig::CC_Icons},
+    {"titlebar_button_size", VT_UINT, &EshyWMConfig::titlebar_button_size, EshyWMConfig::CC_Titlebar},
+    {"titlebar_button_padding", VT_UINT, &EshyWMConfig::titlebar_button_padding, EshyWMConfig::CC_Titlebar},
+    {"titlebar_button_normal_color", VT_ULONG_HEX, &EshyWMConfig::titlebar_button_normal_color, EshyWMConfig::CC_Titlebar},
+    {"titlebar_button_hovered_color", VT_ULONG_HEX, &EshyWMConfig::titlebar_button_hovered_color, EshyWMConfig::CC_Titlebar},
+    {"titlebar_button_pressed_color", VT_ULONG_HEX, &EshyWMConfig::titlebar_button_pressed_color, EshyWMConfig::CC_Titlebar},
+    {"titlebar_title_color", VT_ULONG_HEX, &EshyWMConfig::titlebar_title_color, EshyWMConfig::CC_Titlebar},
+    {"titlebar", VT_BOOL, &EshyWMConfig::titlebar, EshyWMConfig::CC_Titlebar},
+
+    {"switcher_button_height", VT_UINT, &EshyWMConfig::switcher_button_height, EshyWMConfig::CC_Switcher | EshyWMConfig::CC_Icons},
+    {"switcher_button_padding", VT_UINT, &EshyWMConfig::switcher_button_padding, EshyWMConfig::CC_Switcher},
+    {"switcher_button_color", VT_ULONG_HEX, &EshyWMConfig::switcher_button_color, EshyWMConfig::CC_Switcher | EshyWMConfig::CC_Icons},
+    {"switcher_button_border_color", VT_ULONG_HEX, &EshyWMConfig::switcher_button_border_color, EshyWMConfig::CC_Switcher},
+    {"switcher_color", VT_ULONG_HEX, &EshyWMConfig::switcher_color, EshyWMConfig::CC_Switcher},
+    {"switcher_thumbnails", VT_BOOL, &EshyWMConfig::switcher_thumbnails, EshyWMConfig::CC_NONE},
+    {"switcher_thumbnail_refresh_interval", VT_ULONG, &EshyWMConfig::switcher_thumbnail_refresh_interval, EshyWMConfig::CC_NONE},
+
+    {"status_bar", VT_BOOL, &EshyWMConfig::status_bar, EshyWMConfig::CC_StatusBar},
+    {"status_bar_position", VT_STRING, &EshyWMConfig::status_bar_position, EshyWMConfig::CC_StatusBar},
+    {"status_bar_height", VT_UINT, &EshyWMConfig::status_bar_height, EshyWMConfig::CC_StatusBar},
+    {"status_bar_color", VT_ULONG_HEX, &EshyWMConfig::status_bar_color, EshyWMConfig::CC_StatusBar},
+    {"status_bar_text_color", VT_ULONG_HEX, &EshyWMConfig::status_bar_text_color, EshyWMConfig::CC_StatusBar},
+    {"status_bar_highlight_color", VT_ULONG_HEX, &EshyWMConfig::status_bar_highlight_color, EshyWMConfig::CC_StatusBar},
+    {"status_bar_providers", VT_STRING, &EshyWMConfig::status_bar_providers, EshyWMConfig::CC_StatusBar},
+
+    {"double_click_time", VT_ULONG, &EshyWMConfig::double_click_time, EshyWMConfig::CC_NONE}
+};
+
+//keybind_key and keybind_command are held in the parsed values, the binding is added once both are set
+static constexpr size_t KEYBIND_KEY_OPTION = 1;
+static constexpr size_t KEYBIND_COMMAND_OPTION = 2;
+static_assert(config_options[KEYBIND_KEY_OPTION].name == "keybind_key" && config_options[KEYBIND_COMMAND_OPTION].name == "keybind_command");
+
+/**
+ * Option names are looked up through a perfect hash: the seed is searched for at compile time so every name
+ * lands in its own slot, and a lookup is one hash and one string compare no matter how many options exist.
+*/
+static constexpr size_t OPTION_SLOT_COUNT = 512;
+static constexpr uint8_t EMPTY_OPTION_SLOT = 0xFF;
+static_assert(std::size(config_options) < EMPTY_OPTION_SLOT);
+
+static constexpr size_t get_option_slot(std::string_view name, uint32_t seed)
 {
-    if(line.find(option_name) == std::string::npos)
-        return;
-    
-    const size_t pos = line.find(': ');
-    const key_value_pair kvp = {line.substr(0, pos).c_str(), line.substr(pos + 1, line.length() - pos).c_str()};
-
-    switch(type)
-    {
-    case VarType::VT_INT:
-        *((int*)config_var) = std::stoi(kvp.value);
-        break;
-    case VarType::VT_UINT:
-        *((uint*)config_var) = std::stoi(kvp.value);
-        break;
-    case VarType::VT_UINT_HEX:
-        *((uint*)config_var) = std::stoi(kvp.value, 0, 16);
-        break;
-    case VarType::VT_ULONG:
-        *((ulong*)config_var) = std::stoul(kvp.value);
-        break;
-    case VarType::VT_ULONG_HEX:
-        *((ulong*)config_var) = std::stoul(kvp.value, 0, 16);
-        break;
-    case VarType::VT_FLOAT:
-        *((float*)config_var) = std::stoi(kvp.value);
-        break;
-    case VarType::VT_STRING:
-        *(std::string*)config_var = kvp.value;
-        break;
-    case VarType::VT_BOOL:
-        *(bool*)config_var = kvp.value == "true";
-        break;
-    };
+    //FNV-1a
+    uint32_t hash = 2166136261u ^ seed;
+    for (const char c : name)
+    {
+        hash ^= (unsigned char)c;
+        hash *= 16777619u;
+    }
+
+    return hash % OPTION_SLOT_COUNT;
 }
 
-void EshyWMConfig::update_config()
+struct option_slots
+{
+    uint32_t seed;
+    std::array<uint8_t, OPTION_SLOT_COUNT> options;
+};
+
+static consteval option_slots build_option_slots()
+{
+    for (uint32_t seed = 0;; ++seed)
+    {
+        option_slots slots = {seed, {}};
+        slots.options.fill(EMPTY_OPTION_SLOT);
+
+        bool b_perfect = true;
+        for (size_t i = 0; i < std::size(config_options) && b_perfect; ++i)
+        {
+            uint8_t& slot = slots.options[get_option_slot(config_options[i].name, seed)];
+            b_perfect = slot == EMPTY_OPTION_SLOT;
+            slot = i;
+        }
+
+        if (b_perfect)
+            return slots;
+    }
+}
+
+static constexpr option_slots OPTION_SLOTS = build_option_slots();
+
+static const config_option* find_config_option(std::string_view name)
+{
+    const uint8_t i = OPTION_SLOTS.options[get_option_slot(name, OPTION_SLOTS.seed)];
+    return (i != EMPTY_OPTION_SLOT && config_options[i].name == name) ? &config_options[i] : nullptr;
+}
+
+static void report_config_error(const std::string& path, size_t line_number, size_t column, const std::string& message)
+{
+    LOGE("%s:%zu:%zu: %s", path.c_str(), line_number, column, message.c_str());
+}
+
+static inline bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+//Returns the column of the first character of the trimmed text, relative to the start of text
+static size_t trim(std::string_view& text)
+{
+    size_t start = 0;
+    while (start < text.size() && is_space(text[start]))
+        ++start;
+
+    size_t end = text.size();
+    while (end > start && is_space(text[end - 1]))
+        --end;
+
+    text = text.substr(start, end - start);
+    return start;
+}
+
+/**
+ * Splits name: value in one pass. Everything after # is a comment.
+ * Returns false for lines without an option, error is set if the line is not empty but malformed.
+*/
+static bool tokenize_config_line(std::string_view line, config_line& out, std::string& error, size_t& error_column)
+{
+    line = line.substr(0, line.find('#'));
+
+    std::string_view key = line;
+    const size_t key_start = trim(key);
+    if (key.empty())
+        return false;
+
+    const size_t separator = line.find(':');
+    if (separator == std::string_view::npos)
+    {
+        error = "expected ':' after the option name";
+        error_column = line.size() + 1;
+        return false;
+    }
+
+    key = line.substr(0, separator);
+    trim(key);
+    if (key.empty())
+    {
+        error = "expected an option name before ':'";
+        error_column = separator + 1;
+        return false;
+    }
+
+    std::string_view value = line.substr(separator + 1);
+    const size_t value_start = separator + 1 + trim(value);
+
+    out = {key, value, key_start + 1, value_start + 1};
+    return true;
+}
+
+template <typename T>
+static bool parse_number(std::string_view text, T& out, int base)
+{
+    if (base == 16 && (text.starts_with("0x") || text.starts_with("0X")))
+        text.remove_prefix(2);
+
+    const auto [end, result] = std::from_chars(text.data(), text.data() + text.size(), out, base);
+    return result == std::errc() && end == text.data() + text.size() && !text.empty();
+}
+
+static bool parse_float(std::string_view text, float& out)
 {
-    std::ifstream config_file(CONFIG_FILE_PATH);
-    std::string line;
+    const auto [end, result] = std::from_chars(text.data(), text.data() + text.size(), out);
+    return result == std::errc() && end == text.data() + text.size() && !text.empty();
+}
 
-    std::string startup_command;
+static bool equals_ignoring_case(std::string_view a, std::string_view b)
+{
+    return std::ranges::equal(a, b, [](char x, char y){ return std::tolower((unsigned char)x) == std::tolower((unsigned char)y); });
+}
 
-    KeyBinding key_binding;
+static bool parse_modifier(std::string_view name, uint& out)
+{
+    static constexpr std::pair<std::string_view, uint> modifier_names[] = {
+        {"Super", Mod4Mask}, {"Mod4", Mod4Mask},
+        {"Alt", Mod1Mask}, {"Mod1", Mod1Mask},
+        {"Control", ControlMask}, {"Ctrl", ControlMask},
+        {"Shift", ShiftMask},
+        {"Mod3", Mod3Mask}, {"Mod5", Mod5Mask}
+    };
 
-    while(std::getline(config_file, line))
+    for (const auto& [modifier_name, mask] : modifier_names)
     {
-        const std::size_t comment_start_pos = line.find("#");
-        if(comment_start_pos != std::string::npos)
+        if (equals_ignoring_case(name, modifier_name))
         {
-            line = line.substr(0, comment_start_pos);
+            out |= mask;
+            return true;
         }
+    }
 
-        parse_config_option(line, VT_STRING, &startup_command, "startup_command");
+    return false;
+}
+
+//Modifier+Modifier+KeysymName, the name is resolved later by resolve_key
+static bool parse_key(std::string_view text, config_key& out)
+{
+    uint modifiers = 0;
+    size_t separator;
+    while ((separator = text.find('+')) != std::string_view::npos && separator + 1 < text.size())
+    {
+        std::string_view modifier = text.substr(0, separator);
+        trim(modifier);
+        if (!parse_modifier(modifier, modifiers))
+            return false;
 
-        if(!startup_command.empty())
+        text.remove_prefix(separator + 1);
+    }
+
+    trim(text);
+    if (text.empty())
+        return false;
+
+    out.name = text;
+    out.modifiers = modifiers != 0 ? modifiers : Mod4Mask;
+    return true;
+}
+
+//A plain number is taken as a keysym like older configs had. Returns NoSymbol if the name is neither
+static KeySym resolve_key(const std::string& name)
+{
+    //Names win so 0 to 9 are the digit keys, numbers are only raw keysyms when no keysym has that name
+    KeySym key_sym = XStringToKeysym(name.c_str());
+    if (key_sym == NoSymbol && !parse_number(std::string_view(name), key_sym, 10))
+        return NoSymbol;
+
+    return key_sym;
+}
+
+//Has to run on the event thread. Bindings whose key is not a keysym are reported and left out
+static std::vector<EshyWMConfig::KeyBinding> resolve_key_bindings(const std::string& path, const std::vector<parsed_key_binding>& parsed_bindings)
+{
+    std::vector<EshyWMConfig::KeyBinding> key_bindings;
+    key_bindings.reserve(parsed_bindings.size());
+
+    for (const parsed_key_binding& binding : parsed_bindings)
+    {
+        const KeySym key_sym = resolve_key(binding.key.name);
+        if (key_sym == NoSymbol)
         {
-            startup_commands.push_back(startup_command);
-            startup_command = "";
+            report_config_error(path, binding.key.line_number, binding.key.column, "expected a key like Super+Shift+Return for keybind_key");
             continue;
         }
 
-        parse_config_option(line, VT_INT, &key_binding.key, "keybind_key");
-        parse_config_option(line, VT_STRING, &key_binding.command, "keybind_command");
+        key_bindings.push_back({key_sym, binding.key.modifiers, binding.command});
+    }
+
+    return key_bindings;
+}
+
+//Writes value into destination, which has the type of the option. Returns what was expected if value does not parse, destination is left as it was
+static const char* set_config_option(const config_option& option, void* destination, std::string_view value)
+{
+    switch (option.type)
+    {
+    case VT_INT:
+        return parse_number(value, *(int*)destination, 10) ? nullptr : "expected an integer";
+    case VT_UINT:
+        return parse_number(value, *(uint*)destination, 10) ? nullptr : "expected a positive integer";
+    case VT_UINT_HEX:
+        return parse_number(value, *(uint*)destination, 16) ? nullptr : "expected a hexadecimal number";
+    case VT_ULONG:
+        return parse_number(value, *(ulong*)destination, 10) ? nullptr : "expected a positive integer";
+    case VT_ULONG_HEX:
+        return parse_number(value, *(ulong*)destination, 16) ? nullptr : "expected a hexadecimal number";
+    case VT_FLOAT:
+        return parse_float(value, *(float*)destination) ? nullptr : "expected a number";
+    case VT_STRING:
+        *(std::string*)destination = value;
+        return nullptr;
+    case VT_STRING_LIST:
+        ((std::vector<std::string>*)destination)->emplace_back(value);
+        return nullptr;
+    case VT_BOOL:
+        if (value != "true" && value != "false")
+            return "expected true or false";
+
+        *(bool*)destination = value == "true";
+        return nullptr;
+    case VT_KEY:
+        return parse_key(value, *(config_key*)destination) ? nullptr : "expected a key like Super+Shift+Return";
+    };
 
-        if(key_binding.key != 0 && key_binding.command != "")
+    return nullptr;
+}
+
+//A whole file mapped read only, empty if it does not exist
+struct mapped_file
+{
+    mapped_file(const std::string& path)
+    {
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+            return;
+
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0)
         {
-            key_bindings.emplace_back(key_binding.key, key_binding.command);
-            key_binding.key = 0;
-            key_binding.command = "";
+            void* mapping = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED)
+                content = std::string_view((const char*)mapping, file_stat.st_size);
+        }
+
+        close(fd);
+    }
+
+    ~mapped_file()
+    {
+        if (!content.empty())
+            munmap((void*)content.data(), content.size());
+    }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    std::string_view content;
+};
+
+//Calls callback for every line that holds an option and reports malformed lines
+template <typename Callback>
+static void read_config_lines(const std::string& path, std::string_view content, Callback callback)
+{
+    for (size_t line_number = 1; !content.empty(); ++line_number)
+    {
+        const size_t line_end = std::min(content.find('\n'), content.size());
+        const std::string_view line = content.substr(0, line_end);
+        content.remove_prefix(std::min(line_end + 1, content.size()));
+
+        config_line tokens;
+        std::string error;
+        size_t error_column = 0;
+
+        if (tokenize_config_line(line, tokens, error, error_column))
+            callback(path, line_number, tokens);
+        else if (!error.empty())
+            report_config_error(path, line_number, error_column, error);
+    }
+}
+
+template <typename Callback>
+static void read_config_file(const std::string& path, Callback callback)
+{
+    const mapped_file file(path);
+    read_config_lines(path, file.content, callback);
+}
+
+template <typename T>
+static config_value read_value(const void* value)
+{
+    return value ? *(const T*)value : T();
+}
+
+//The current value of the global behind option, or an empty value of its type for the key binding options
+static config_value read_option(const config_option& option)
+{
+    switch (option.type)
+    {
+    case VT_INT:
+        return read_value<int>(option.value);
+    case VT_UINT:
+    case VT_UINT_HEX:
+        return read_value<uint>(option.value);
+    case VT_ULONG:
+    case VT_ULONG_HEX:
+        return read_value<ulong>(option.value);
+    case VT_FLOAT:
+        return read_value<float>(option.value);
+    case VT_STRING:
+        return read_value<std::string>(option.value);
+    case VT_STRING_LIST:
+        return read_value<std::vector<std::string>>(option.value);
+    case VT_BOOL:
+        return read_value<bool>(option.value);
+    case VT_KEY:
+        return read_value<config_key>(option.value);
+    };
+
+    return {};
+}
+
+static void write_option(const config_option& option, const config_value& value)
+{
+    if (!option.value)
+        return;
+
+    std::visit([&](const auto& v){ *(std::decay_t<decltype(v)>*)option.value = v; }, value);
+}
+
+static std::vector<config_value> read_options()
+{
+    std::vector<config_value> values;
+    values.reserve(std::size(config_options));
+
+    for (const config_option& option : config_options)
+        values.push_back(read_option(option));
+
+    return values;
+}
+
+//Parses the file on top of initial_values without touching any global, so it can run on any thread
+static parsed_config parse_config_file(const std::string& path, std::vector<config_value> initial_values)
+{
+    parsed_config parsed = {std::move(initial_values), {}};
+
+    read_config_file(path, [&parsed](const std::string& path, size_t line_number, const config_line& line)
+    {
+        const config_option* option = find_config_option(line.key);
+        if (!option)
+        {
+            report_config_error(path, line_number, line.key_column, "unknown option '" + std::string(line.key) + "'");
+            return;
+        }
+
+        //A binding starts at its key, a command left over from a key that did not parse is dropped
+        if (option - config_options == KEYBIND_KEY_OPTION)
+            std::get<std::string>(parsed.values[KEYBIND_COMMAND_OPTION]).clear();
+
+        config_value& value = parsed.values[option - config_options];
+        void* destination = std::visit([](auto& v){ return (void*)&v; }, value);
+
+        config_key& key = std::get<config_key>(parsed.values[KEYBIND_KEY_OPTION]);
+        std::string& command = std::get<std::string>(parsed.values[KEYBIND_COMMAND_OPTION]);
+
+        if (const char* error = set_config_option(*option, destination, line.value))
+            report_config_error(path, line_number, line.value_column, std::string(error) + " for " + std::string(line.key));
+        else if (option - config_options == KEYBIND_KEY_OPTION)
+        {
+            key.line_number = line_number;
+            key.column = line.value_column;
+        }
+
+        if (!key.name.empty() && !command.empty())
+        {
+            parsed.key_bindings.push_back({key, command});
+            key = {};
+            command.clear();
+        }
+    });
+
+    return parsed;
+}
+
+
+//Reloading
+static std::vector<config_value> default_values;
+static EshyWMConfig::ConfigReloaded config_reloaded;
+static int config_watch_fd = -1;
+static EventLoop::TimerHandle reload_timer = 0;
+static std::thread reload_thread;
+
+static void apply_reloaded_config(const parsed_config& parsed)
+{
+    EshyWMConfig::ConfigChanges changes;
+    const std::vector<EshyWMConfig::KeyBinding> key_bindings = resolve_key_bindings(CONFIG_FILE_PATH, parsed.key_bindings);
+
+    for (size_t i = 0; i < std::size(config_options); ++i)
+    {
+        const config_option& option = config_options[i];
+        if (!option.value || read_option(option) == parsed.values[i])
             continue;
+
+        write_option(option, parsed.values[i]);
+        changes.changed |= option.change;
+    }
+
+    for (const EshyWMConfig::KeyBinding& binding : EshyWMConfig::key_bindings)
+    {
+        if (std::find(key_bindings.begin(), key_bindings.end(), binding) == key_bindings.end())
+            changes.removed_key_bindings.push_back(binding);
+    }
+
+    for (const EshyWMConfig::KeyBinding& binding : key_bindings)
+    {
+        if (std::find(EshyWMConfig::key_bindings.begin(), EshyWMConfig::key_bindings.end(), binding) == EshyWMConfig::key_bindings.end())
+            changes.added_key_bindings.push_back(binding);
+    }
+
+    EshyWMConfig::key_bindings = key_bindings;
+
+    if (changes.changed != EshyWMConfig::CC_NONE || !changes.removed_key_bindings.empty() || !changes.added_key_bindings.empty())
+        config_reloaded(changes);
+}
+
+static void start_reload()
+{
+    //A reload takes a fraction of the debounce delay, so the previous one is done or about to be
+    if (reload_thread.joinable())
+        reload_thread.join();
+
+    //Options missing from the file go back to their defaults, the same as on a restart
+    reload_thread = std::thread([values = default_values]() mutable
+    {
+        std::shared_ptr<parsed_config> parsed = std::make_shared<parsed_config>(parse_config_file(CONFIG_FILE_PATH, std::move(values)));
+        EventLoop::post([parsed]()
+        {
+            if (config_watch_fd != -1)
+                apply_reloaded_config(*parsed);
+        });
+    });
+}
+
+static void handle_config_inotify(uint32_t events)
+{
+    const std::string_view config_file_name = std::string_view(CONFIG_FILE_PATH).substr(CONFIG_FILE_PATH.rfind('/') + 1);
+    bool b_config_changed = false;
+
+    alignas(inotify_event) char buffer[4096];
+    ssize_t length;
+    while ((length = read(config_watch_fd, buffer, sizeof(buffer))) > 0)
+    {
+        for (ssize_t offset = 0; offset < length;)
+        {
+            const inotify_event* event = (const inotify_event*)(buffer + offset);
+            if (event->len > 0 && config_file_name == event->name)
+                b_config_changed = true;
+
+            offset += sizeof(inotify_event) + event->len;
         }
+    }
+
+    if (!b_config_changed)
+        return;
 
-        parse_config_option(line, VT_STRING, &background_path, "background:");
-        parse_config_option(line, VT_STRING, &default_application_image_path, "default_application_image_path:");
+    //Editors write a file in several steps, it is read once they are done
+    EventLoop::remove_timer(reload_timer);
+    reload_timer = EventLoop::add_timer(200ms, 0ms, []()
+    {
+        reload_timer = 0;
+        start_reload();
+    });
+}
+
+/**
+ * window_close_data is kept in an append only journal: every change is one more line and later lines win.
+ * A writer thread appends changes in batches with one fdatasync each, and rewrites the file with only the
+ * latest state of every window once most of its lines are outdated.
+*/
+struct journal_entry
+{
+    std::string window;
+    std::string state;
+};
 
-        parse_config_option(line, VT_UINT, &window_frame_border_width, "window_frame_border_width");
-        parse_config_option(line, VT_ULONG_HEX, &window_frame_border_color, "window_frame_border_color");
-        parse_config_option(line, VT_ULONG_HEX, &window_background_color, "window_background_color");
-        parse_config_option(line, VT_ULONG_HEX, &close_button_color, "close_button_color");
-        parse_config_option(line, VT_STRING, &minimize_button_image_path, "minimize_button_image_path");
-        parse_config_option(line, VT_STRING, &maximize_button_image_path, "maximize_button_image_path");
-        parse_config_option(line, VT_STRING, &close_button_image_path, "close_button_image_path");
+static std::thread journal_writer;
+static std::mutex journal_mutex;
+static std::condition_variable journal_condition;
+static std::vector<journal_entry> pending_journal_entries;
+static bool b_stop_journal = false;
 
-        parse_config_option(line, VT_FLOAT, &window_opacity_step, "window_opacity_step");
-        parse_config_option(line, VT_INT, &window_x_movement_step, "window_x_movement_step");
-        parse_config_option(line, VT_INT, &window_y_movement_step, "window_y_movement_step");
-        parse_config_option(line, VT_INT, &window_width_resize_step, "window_width_resize_step");
-        parse_config_option(line, VT_INT, &window_height_resize_step, "window_height_resize_step");
+//Only touched by the writer once it runs
+static std::unordered_map<std::string, std::string> journal_states;
+static size_t journal_lines = 0;
+static bool b_journal_needs_newline = false;
 
-        parse_config_option(line, VT_UINT, &titlebar_height, "titlebar_height");
-        parse_config_option(line, VT_UINT, &titlebar_button_size, "titlebar_button_size");
-        parse_config_option(line, VT_UINT, &titlebar_button_padding, "titlebar_button_padding");
-        parse_config_option(line, VT_ULONG_HEX, &titlebar_button_normal_color, "titlebar_button_normal_color");
-        parse_config_option(line, VT_ULONG_HEX, &titlebar_button_hovered_color, "titlebar_button_hovered_color");
-        parse_config_option(line, VT_ULONG_HEX, &titlebar_button_pressed_color, "titlebar_button_pressed_color");
-        parse_config_option(line, VT_ULONG_HEX, &titlebar_title_color, "titlebar_title_color");
-        parse_config_option(line, VT_BOOL, &titlebar, "titlebar");
+static constexpr auto JOURNAL_BATCH_DELAY = 1s;
+static constexpr size_t MIN_COMPACTED_JOURNAL_LINES = 64;
 
-        parse_config_option(line, VT_ULONG, &switcher_button_height, "switcher_button_height");
-        parse_config_option(line, VT_ULONG, &switcher_button_padding, "switcher_button_padding");
-        parse_config_option(line, VT_ULONG_HEX, &switcher_button_color, "switcher_button_color");
-        parse_config_option(line, VT_ULONG_HEX, &switcher_button_border_color, "switcher_button_border_color");
-        parse_config_option(line, VT_ULONG_HEX, &switcher_color, "switcher_color");
+static std::string format_journal_entry(const std::string& window, const std::string& state)
+{
+    return "window_close_data: " + window + "," + state + "\n";
+}
 
-        parse_config_option(line, VT_ULONG, &double_click_time, "double_click_time");
+static bool write_all(int fd, const std::string& data)
+{
+    for (size_t written = 0; written < data.size();)
+    {
+        const ssize_t result = write(fd, data.data() + written, data.size() - written);
+        if (result == -1 && errno == EINTR)
+            continue;
+
+        if (result <= 0)
+            return false;
+
+        written += result;
     }
 
-    config_file.close();
+    return true;
 }
 
-void EshyWMConfig::update_data()
+static bool append_journal(const std::string& data)
+{
+    const int fd = open(DATA_FILE_PATH.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1)
+        return false;
+
+    const bool b_written = write_all(fd, data) && fdatasync(fd) == 0;
+    close(fd);
+    return b_written;
+}
+
+//Writes the latest states to a new file and renames it over the journal, so a crash leaves one or the other
+static bool compact_journal()
 {
-    std::ifstream config_file(DATA_FILE_PATH);
-    std::string line;
+    std::string data;
+    for (const auto& [window, state] : journal_states)
+        data += format_journal_entry(window, state);
+
+    const std::string temporary_path = DATA_FILE_PATH + ".tmp";
+    const int fd = open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1)
+        return false;
+
+    const bool b_written = write_all(fd, data) && fsync(fd) == 0;
+    close(fd);
+
+    if (!b_written || rename(temporary_path.c_str(), DATA_FILE_PATH.c_str()) != 0)
+    {
+        unlink(temporary_path.c_str());
+        return false;
+    }
+
+    journal_lines = journal_states.size();
+    b_journal_needs_newline = false;
+    return true;
+}
 
-    std::string window_data;
+static void write_journal()
+{
+    std::unique_lock<std::mutex> lock(journal_mutex);
 
-    while(std::getline(config_file, line))
+    while (true)
     {
-        parse_config_option(line, VT_STRING, &window_data, "window_close_data:");
-        if(window_data != "")
+        journal_condition.wait(lock, [](){ return b_stop_journal || !pending_journal_entries.empty(); });
+        if (pending_journal_entries.empty())
+            return;
+
+        //Windows tend to close together, everything closed within the delay shares one write
+        journal_condition.wait_for(lock, JOURNAL_BATCH_DELAY, [](){ return b_stop_journal; });
+
+        std::vector<journal_entry> entries = std::move(pending_journal_entries);
+        pending_journal_entries.clear();
+        lock.unlock();
+
+        std::string data = b_journal_needs_newline ? "\n" : "";
+        for (const journal_entry& entry : entries)
+        {
+            data += format_journal_entry(entry.window, entry.state);
+            journal_states[entry.window] = entry.state;
+        }
+
+        if (journal_lines > MIN_COMPACTED_JOURNAL_LINES && journal_lines + entries.size() > journal_states.size() * 2)
+        {
+            if (!compact_journal())
+                LOGE("Failed to compact the window state journal");
+        }
+        else if (append_journal(data))
+        {
+            journal_lines += entries.size();
+            b_journal_needs_newline = false;
+        }
+        else
         {
-            const size_t pos = window_data.find(',');
-            const key_value_pair kvp = {window_data.substr(0, pos).c_str(), window_data.substr(pos + 1, window_data.length() - pos).c_str()};
-            window_close_data.emplace(kvp.key, kvp.value);
-            window_data = "";
+            LOGE("Failed to write the window state journal");
         }
+
+        lock.lock();
+    }
+}
+
+void EshyWMConfig::update_config()
+{
+    if (default_values.empty())
+        default_values = read_options();
+
+    const parsed_config parsed = parse_config_file(CONFIG_FILE_PATH, default_values);
+    for (size_t i = 0; i < std::size(config_options); ++i)
+        write_option(config_options[i], parsed.values[i]);
+
+    key_bindings = resolve_key_bindings(CONFIG_FILE_PATH, parsed.key_bindings);
+}
+
+void EshyWMConfig::watch_config(ConfigReloaded _config_reloaded)
+{
+    config_reloaded = _config_reloaded;
+
+    //The directory is watched since editors often replace the file instead of writing to it
+    const std::string directory = CONFIG_FILE_PATH.substr(0, CONFIG_FILE_PATH.rfind('/'));
+
+    config_watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (config_watch_fd == -1
+        || inotify_add_watch(config_watch_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR) == -1
+        || !EventLoop::add_fd(config_watch_fd, EPOLLIN, &handle_config_inotify))
+    {
+        LOGE("Failed to watch the config directory, changes to the config need a restart");
+        stop_watching_config();
     }
+}
+
+void EshyWMConfig::stop_watching_config()
+{
+    EventLoop::remove_timer(reload_timer);
+    reload_timer = 0;
 
-    config_file.close();
+    if (reload_thread.joinable())
+        reload_thread.join();
+
+    if (config_watch_fd != -1)
+    {
+        EventLoop::remove_fd(config_watch_fd);
+        close(config_watch_fd);
+        config_watch_fd = -1;
+    }
 }
 
-void EshyWMConfig::update_data_file()
+void EshyWMConfig::update_data()
 {
-    std::fstream config_file(DATA_FILE_PATH, std::ios_base::out);
+    size_t n_lines = 0;
+    bool b_ends_with_newline = true;
 
-    for(auto [a, b] : window_close_data)
-        config_file << "window_close_data: " << a << "," << b << "\n";
+    {
+        const mapped_file file(DATA_FILE_PATH);
+        read_config_lines(DATA_FILE_PATH, file.content, [&n_lines](const std::string& path, size_t line_number, const config_line& line)
+        {
+            ++n_lines;
+            if (line.key != "window_close_data")
+                return;
+
+            const size_t separator = line.value.find(',');
+            if (separator == std::string_view::npos)
+            {
+                report_config_error(path, line_number, line.value_column, "expected window,state");
+                return;
+            }
+
+            //The file is a journal, later lines replace earlier ones
+            window_close_data.insert_or_assign(std::string(line.value.substr(0, separator)), std::string(line.value.substr(separator + 1)));
+        });
+
+        b_ends_with_newline = file.content.empty() || file.content.back() == '\n';
+    }
+
+    journal_lines = n_lines;
+    journal_states = window_close_data;
+    //A write cut short by a crash leaves half a line, the next entry has to start on its own line
+    b_journal_needs_newline = !b_ends_with_newline;
+
+    b_stop_journal = false;
+    journal_writer = std::thread(&write_journal);
+}
+
+void EshyWMConfig::flush_data()
+{
+    {
+        const std::lock_guard<std::mutex> lock(journal_mutex);
+        b_stop_journal = true;
+    }
+    journal_condition.notify_one();
 
-    config_file.close();
+    if (journal_writer.joinable())
+        journal_writer.join();
 }
 
-void EshyWMConfig::add_window_close_state(std::string window, std::string new_state)
+void EshyWMConfig::add_window_close_state(const std::string& window, const std::string& new_state)
 {
-    window_close_data[window] = new_state;
-    update_data_file();
-}
\ No newline at end of file
+    auto [it, b_inserted] = window_close_data.try_emplace(window, new_state);
+    if (!b_inserted && it->second == new_state)
+        return;
+
+    it->second = new_state;
+
+    {
+        const std::lock_guard<std::mutex> lock(journal_mutex);
+        pending_journal_entries.push_back({window, new_state});
+    }
+    journal_condition.notify_one();
+}
@@ -8,6 +8,70 @@
 #include <algorithm>
 #include <assert.h>
 
+void Workspace::set_layout(ELayoutType layout_type)
+{
+    if(get_layout_type() == layout_type)
+        return;
+
+    std::vector<std::shared_ptr<EshyWMWindow>> tiled_windows;
+    if(layout)
+    {
+        tiled_windows = layout->get_windows();
+    }
+    else
+    {
+        //Fullscreen windows are tiled too, they take their tile once they leave fullscreen
+        auto tileable_in_workspace = [this](auto window){return window->parent_workspace.get() == this && window->is_tileable();};
+        for(auto window : EshyWM::window_manager->window_list | std::views::filter(tileable_in_workspace))
+            tiled_windows.push_back(window);
+
+        //window_list is in stacking order, the layout goes from the bottom window up
+        std::ranges::reverse(tiled_windows);
+    }
+
+    layout = create_tiling_layout(layout_type, geometry);
+    if(!layout)
+    {
+        for(auto window : tiled_windows)
+            window->untile_window();
+        return;
+    }
+
+    //Windows that stay in a tile of the same size are not configured again
+    for(auto window : tiled_windows)
+        layout->add_window(window, nullptr);
+
+    layout->apply();
+}
+
+void Workspace::add_tiled_window(std::shared_ptr<EshyWMWindow> window, const EshyWMWindow* next_to)
+{
+    if(!layout || !window->is_tileable())
+        return;
+
+    layout->add_window(window, next_to);
+    layout->apply();
+}
+
+void Workspace::remove_tiled_window(EshyWMWindow* window)
+{
+    if(!layout || !layout->remove_window(window))
+        return;
+
+    window->untile_window();
+    layout->apply();
+}
+
+void Workspace::update_layout()
+{
+    if(!layout)
+        return;
+
+    layout->set_bounds(geometry);
+    layout->apply();
+}
+
+
 void Output::activate_workspace(std::shared_ptr<Workspace> new_workspace)
 {
     assert(new_workspace);
@@ -31,12 +95,17 @@ void Output::activate_workspace(std::shared_ptr<Workspace> new_workspace)
     if(bottom_dock)
         active_workspace->geometry.height -= bottom_dock->geometry.height;
 
+    //Tiles are placed before the windows are mapped again
+    active_workspace->update_layout();
+
     //Raise all windows of this workspace
     auto in_active_workspace = [new_workspace = new_workspace](auto window){return window->parent_workspace == new_workspace;};
     for(auto window : EshyWM::window_manager->window_list | std::views::filter(in_active_workspace))
     {
         window->minimize_window(false);
     }
+
+    EshyWM::workspace_changed_notify();
 }
 
 void Output::deactivate_workspace()
@@ -77,6 +146,8 @@ void Output::add_dock(std::shared_ptr<Dock> new_dock, EDockLocation location)
 
     if(bottom_dock)
         active_workspace->geometry.height -= bottom_dock->geometry.height;
+
+    active_workspace->update_layout();
     
     //Propogate geometry change to all windows in active_workspace
     auto in_active_workspace = [active_workspace = active_workspace](auto window){return window->parent_workspace == active_workspace;};
@@ -114,6 +185,8 @@ void Output::remove_dock(std::shared_ptr<Dock> dock)
     if(bottom_dock)
         active_workspace->geometry.height -= bottom_dock->geometry.height;
 
+    active_workspace->update_layout();
+
     //Propogate geometry change to all windows in active_workspace
     auto in_active_workspace = [active_workspace = active_workspace](auto window){return window->parent_workspace == active_workspace;};
     for(auto window : EshyWM::window_manager->window_list | std::views::filter(in_active_workspace))
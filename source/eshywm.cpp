@@ -7,22 +7,81 @@
 #include "util.h"
 #include "X11.h"
 #include "background.h"
+#include "event_loop.h"
+#include "icon_cache.h"
+#include "icon_index.h"
+#include "launcher.h"
+#include "status_bar.h"
+#include "status_provider.h"
+#include "thumbnail_cache.h"
 
 #include <X11/extensions/Xrandr.h>
 
+#include <sys/epoll.h>
+
 std::shared_ptr<WindowManager> EshyWM::window_manager;
 std::shared_ptr<EshyWMSwitcher> EshyWM::switcher;
+std::vector<std::shared_ptr<EshyWMStatusBar>> EshyWM::status_bars;
 
 bool EshyWM::b_terminate = false;
 
+//One bar per current output, sized to its geometry
+static void build_output_status_bars()
+{
+    EshyWM::status_bars.clear();
+
+    for(std::shared_ptr<Output> output : EshyWM::window_manager->outputs)
+    {
+        EshyWM::status_bars.push_back(std::make_shared<EshyWMStatusBar>(output));
+        EshyWM::status_bars.back()->show();
+    }
+}
+
+//Providers only run while there is a bar to show them
+static void create_status_bars()
+{
+    if(!EshyWMConfig::status_bar)
+        return;
+
+    StatusProviders::initialize([]()
+    {
+        for(std::shared_ptr<EshyWMStatusBar> status_bar : EshyWM::status_bars)
+            status_bar->update_status();
+    });
+
+    build_output_status_bars();
+}
+
+static void destroy_status_bars()
+{
+    EshyWM::status_bars.clear();
+    StatusProviders::shutdown();
+}
+
 bool EshyWM::initialize()
 {
+    //Has to come first, it blocks the handled signals in this thread before any other thread exists
+    if(!EventLoop::initialize())
+        return false;
+
+    EventLoop::add_signal_handler(SIGTERM, [](){ b_terminate = true; });
+    EventLoop::add_signal_handler(SIGCHLD, &Launcher::reap_children);
+
     EshyWMConfig::update_config();
     EshyWMConfig::update_data();
+    IconIndex::initialize();
+    IconCache::initialize();
     
     window_manager = std::make_shared<WindowManager>();
     window_manager->initialize();
 
+    //Before any window is framed, frames are redirected as they are created
+    ThumbnailCache::initialize([](Window frame)
+    {
+        if(switcher)
+            switcher->update_window_option_thumbnail(frame);
+    });
+
     imlib_context_set_display(X11::get_display());
     imlib_context_set_visual(DefaultVisual(X11::get_display(), DefaultScreen(X11::get_display())));
     imlib_context_set_colormap(DefaultColormap(X11::get_display(), DefaultScreen(X11::get_display())));
@@ -31,39 +90,102 @@ bool EshyWM::initialize()
 
     switcher = std::make_shared<EshyWMSwitcher>(Rect{center_x(window_manager->outputs[0], 50), center_y(window_manager->outputs[0], EshyWMConfig::switcher_button_height), 50, 50}, EshyWMConfig::switcher_color);
 
-    for(const std::string command : EshyWMConfig::startup_commands)
+    for(const std::string& command : EshyWMConfig::startup_commands)
     {
-        system((command + "&").c_str());
+        Launcher::spawn(command);
     }
 
     window_manager->handle_preexisting_windows();
-    System::begin_polling();
+    System::initialize();
+    //After the preexisting windows, which would include the bars
+    create_status_bars();
+    EshyWMConfig::watch_config(&on_config_reloaded);
 
-    const int x11_file_descriptor = ConnectionNumber(X11::get_display());
-    fd_set in_file_descriptor_set;
-    struct timeval time_value;
+    EventLoop::add_fd(ConnectionNumber(X11::get_display()), EPOLLIN, [](uint32_t events){ window_manager->handle_events(); });
 
     while(!b_terminate)
     {
-        FD_ZERO(&in_file_descriptor_set);
-        FD_SET(x11_file_descriptor, &in_file_descriptor_set);
-
-        time_value.tv_sec = 0;
-        time_value.tv_usec = 500000;
-
-        select(x11_file_descriptor + 1, &in_file_descriptor_set, 0, 0, &time_value);
-
+        //Xlib reads events into its own queue during round trips, and callbacks may have queued requests.
+        //Both have to be handled before blocking since neither would make the connection readable.
         window_manager->handle_events();
+        EventLoop::dispatch();
     }
 
-    System::end_polling();
+    destroy_status_bars();
+    System::shutdown();
+    EshyWMConfig::stop_watching_config();
+    EshyWMConfig::flush_data();
+    ThumbnailCache::shutdown();
+    EventLoop::shutdown();
+    IconIndex::shutdown();
+    IconCache::shutdown();
+    EshyBg::shutdown();
     return true;
 }
 
 void EshyWM::on_screen_resolution_changed(uint new_width, uint new_height)
 {
-    //Reset the background to match the screen size
-    system(("feh --bg-scale " + std::string(EshyWMConfig::background_path)).c_str());
+    //Scaled wallpapers for output layouts that were seen before come from the cache
+    EshyBg::update_outputs();
+
+    //Outputs may have been added or resized, the providers keep running
+    if(EshyWMConfig::status_bar)
+        build_output_status_bars();
+}
+
+void EshyWM::on_config_reloaded(const EshyWMConfig::ConfigChanges& changes)
+{
+    //Cached icons were scaled and flattened for the old sizes and colors
+    if(changes.changed & EshyWMConfig::CC_Icons)
+        IconCache::clear();
+
+    for(std::shared_ptr<EshyWMWindow> window : window_manager->window_list)
+    {
+        if(changes.changed & EshyWMConfig::CC_Border)
+            window->set_show_border(window_manager->b_show_window_borders);
+
+        if(changes.changed & EshyWMConfig::CC_Titlebar)
+            window->update_titlebar_layout();
+
+        if(changes.changed & EshyWMConfig::CC_Icons)
+        {
+            window->update_icon();
+            window_icon_changed_notify(window);
+        }
+    }
+
+    if(switcher && (changes.changed & EshyWMConfig::CC_Switcher))
+        switcher->reload_config();
+
+    if(changes.changed & EshyWMConfig::CC_Background)
+        EshyBg::set_background(EshyWMConfig::background_path);
+
+    //Layouts picked at runtime are replaced as well, the config is what the user asked for last
+    if(changes.changed & EshyWMConfig::CC_Layout)
+    {
+        for(std::shared_ptr<Workspace> workspace : window_manager->workspaces)
+            workspace->set_layout(parse_layout_type(EshyWMConfig::tiling_layout));
+    }
+
+    if(changes.changed & EshyWMConfig::CC_Tiling)
+    {
+        for(std::shared_ptr<Workspace> workspace : window_manager->workspaces)
+        {
+            if(workspace->layout)
+            {
+                workspace->layout->relayout();
+                workspace->layout->apply();
+            }
+        }
+    }
+
+    if(changes.changed & EshyWMConfig::CC_StatusBar)
+    {
+        destroy_status_bars();
+        create_status_bars();
+    }
+
+    window_manager->update_key_bindings(changes.removed_key_bindings, changes.added_key_bindings);
 }
 
 
@@ -74,6 +196,8 @@ void EshyWM::window_created_notify(std::shared_ptr<EshyWMWindow> window)
 
     if(switcher)
         switcher->add_window_option(window, window->get_window_icon());
+
+    workspace_changed_notify();
 }
 
 void EshyWM::window_destroyed_notify(std::shared_ptr<EshyWMWindow> window)
@@ -83,4 +207,37 @@ void EshyWM::window_destroyed_notify(std::shared_ptr<EshyWMWindow> window)
 
     if(switcher)
         switcher->remove_window_option(window);
+
+    workspace_changed_notify();
+}
+
+void EshyWM::window_icon_changed_notify(std::shared_ptr<EshyWMWindow> window)
+{
+    if(!window)
+        return;
+
+    if(switcher)
+        switcher->update_window_option_icon(window, window->get_window_icon());
+}
+
+void EshyWM::window_title_changed_notify(std::shared_ptr<EshyWMWindow> window)
+{
+    if(!window || window != window_manager->focused_window)
+        return;
+
+    for(std::shared_ptr<EshyWMStatusBar> status_bar : status_bars)
+        status_bar->update_title();
+}
+
+void EshyWM::focus_changed_notify()
+{
+    for(std::shared_ptr<EshyWMStatusBar> status_bar : status_bars)
+        status_bar->update_title();
+}
+
+void EshyWM::workspace_changed_notify()
+{
+    //Workspaces are shared between outputs, so every bar shows which are active and occupied
+    for(std::shared_ptr<EshyWMStatusBar> status_bar : status_bars)
+        status_bar->update_workspaces();
 }
\ No newline at end of file
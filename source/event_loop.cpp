@@ -0,0 +1,320 @@
+#include "event_loop.h"
+#include "util.h"
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <assert.h>
+#include <errno.h>
+
+using namespace std::chrono_literals;
+
+struct FdSource
+{
+    uint32_t events;
+    std::shared_ptr<std::function<void(uint32_t)>> callback;
+};
+
+struct Timer
+{
+    std::chrono::steady_clock::time_point deadline;
+    std::chrono::milliseconds interval;
+    std::shared_ptr<std::function<void()>> callback;
+};
+
+static int epoll_fd = -1;
+static int timer_fd = -1;
+static int signal_fd = -1;
+static int post_fd = -1;
+
+static std::unordered_map<int, FdSource> fd_sources;
+
+static std::unordered_map<EventLoop::TimerHandle, Timer> timers;
+static std::multimap<std::chrono::steady_clock::time_point, EventLoop::TimerHandle> timer_queue;
+static EventLoop::TimerHandle next_timer_handle = 1;
+
+static std::unordered_map<int, std::function<void()>> signal_handlers;
+static sigset_t handled_signals;
+static sigset_t original_signal_mask;
+
+static std::mutex posted_mutex;
+static std::vector<std::function<void()>> posted_callbacks;
+
+static std::mutex idle_mutex;
+static std::unique_lock<std::mutex> idle_lock(idle_mutex, std::defer_lock);
+
+static void arm_timer_fd()
+{
+    itimerspec spec = {};
+
+    if(!timer_queue.empty())
+    {
+        //steady_clock is CLOCK_MONOTONIC on Linux so the deadline can be used as an absolute time directly
+        const auto deadline = timer_queue.begin()->first.time_since_epoch();
+        const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(deadline);
+        spec.it_value.tv_sec = seconds.count();
+        spec.it_value.tv_nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - seconds).count();
+
+        //A zero it_value disarms the timer, which is not what a deadline of exactly zero means
+        if(spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0)
+            spec.it_value.tv_nsec = 1;
+    }
+
+    timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+static void handle_timers(uint32_t events)
+{
+    uint64_t expirations;
+    while(read(timer_fd, &expirations, sizeof(expirations)) > 0) {}
+
+    //Collect first so callbacks can freely add or remove timers
+    const auto now = std::chrono::steady_clock::now();
+    std::vector<EventLoop::TimerHandle> due_timers;
+    for(auto it = timer_queue.begin(); it != timer_queue.end() && it->first <= now; it = timer_queue.erase(it))
+        due_timers.push_back(it->second);
+
+    for(EventLoop::TimerHandle handle : due_timers)
+    {
+        auto it = timers.find(handle);
+        if(it == timers.end())
+            continue;
+
+        const std::shared_ptr<std::function<void()>> callback = it->second.callback;
+
+        if(it->second.interval > 0ms)
+        {
+            //Skip missed intervals instead of firing several times in a row
+            do it->second.deadline += it->second.interval;
+            while(it->second.deadline <= now);
+
+            timer_queue.emplace(it->second.deadline, handle);
+        }
+        else timers.erase(it);
+
+        (*callback)();
+    }
+
+    arm_timer_fd();
+}
+
+static void handle_signals(uint32_t events)
+{
+    signalfd_siginfo info;
+    while(read(signal_fd, &info, sizeof(info)) == sizeof(info))
+    {
+        auto it = signal_handlers.find(info.ssi_signo);
+        if(it != signal_handlers.end())
+            it->second();
+    }
+}
+
+static void handle_posted(uint32_t events)
+{
+    uint64_t count;
+    while(read(post_fd, &count, sizeof(count)) > 0) {}
+
+    std::vector<std::function<void()>> callbacks;
+    {
+        const std::lock_guard<std::mutex> lock(posted_mutex);
+        callbacks.swap(posted_callbacks);
+    }
+
+    for(const std::function<void()>& callback : callbacks)
+        callback();
+}
+
+
+bool EventLoop::initialize()
+{
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    sigemptyset(&handled_signals);
+    signal_fd = signalfd(-1, &handled_signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    post_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if(epoll_fd == -1 || timer_fd == -1 || signal_fd == -1 || post_fd == -1)
+    {
+        LOGE("Failed to create the event loop file descriptors");
+        return false;
+    }
+
+    pthread_sigmask(SIG_SETMASK, nullptr, &original_signal_mask);
+    idle_lock.lock();
+
+    return add_fd(timer_fd, EPOLLIN, &handle_timers) && add_fd(signal_fd, EPOLLIN, &handle_signals) && add_fd(post_fd, EPOLLIN, &handle_posted);
+}
+
+void EventLoop::shutdown()
+{
+    fd_sources.clear();
+    timers.clear();
+    timer_queue.clear();
+    signal_handlers.clear();
+
+    {
+        //Anything posted from now on is dropped
+        const std::lock_guard<std::mutex> lock(posted_mutex);
+        posted_callbacks.clear();
+        close(post_fd);
+        post_fd = -1;
+    }
+
+    //Workers that are waiting for the event thread to become idle can finish now
+    if(idle_lock.owns_lock())
+        idle_lock.unlock();
+
+    close(signal_fd);
+    close(timer_fd);
+    close(epoll_fd);
+    signal_fd = timer_fd = epoll_fd = -1;
+
+    pthread_sigmask(SIG_SETMASK, &original_signal_mask, nullptr);
+}
+
+void EventLoop::dispatch()
+{
+    assert(epoll_fd != -1);
+
+    const int MAX_EVENTS = 32;
+    epoll_event events[MAX_EVENTS];
+
+    idle_lock.unlock();
+    const int n_events = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+    idle_lock.lock();
+
+    if(n_events == -1)
+    {
+        if(errno != EINTR)
+            LOGE("epoll_wait failed");
+        return;
+    }
+
+    for(int i = 0; i < n_events; ++i)
+    {
+        //The source may have been removed by a callback that ran earlier in this iteration
+        auto it = fd_sources.find(events[i].data.fd);
+        if(it == fd_sources.end())
+            continue;
+
+        const std::shared_ptr<std::function<void(uint32_t)>> callback = it->second.callback;
+        (*callback)(events[i].events);
+    }
+}
+
+
+bool EventLoop::add_fd(int fd, uint32_t events, std::function<void(uint32_t)> callback)
+{
+    assert(epoll_fd != -1);
+
+    epoll_event event = {};
+    event.events = events;
+    event.data.fd = fd;
+
+    if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1)
+        return false;
+
+    fd_sources[fd] = {events, std::make_shared<std::function<void(uint32_t)>>(std::move(callback))};
+    return true;
+}
+
+bool EventLoop::modify_fd(int fd, uint32_t events)
+{
+    auto it = fd_sources.find(fd);
+    if(it == fd_sources.end())
+        return false;
+
+    epoll_event event = {};
+    event.events = events;
+    event.data.fd = fd;
+
+    if(epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event) == -1)
+        return false;
+
+    it->second.events = events;
+    return true;
+}
+
+void EventLoop::remove_fd(int fd)
+{
+    if(fd_sources.erase(fd) > 0)
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+
+EventLoop::TimerHandle EventLoop::add_timer(std::chrono::milliseconds delay, std::chrono::milliseconds interval, std::function<void()> callback)
+{
+    const TimerHandle handle = next_timer_handle++;
+    const auto deadline = std::chrono::steady_clock::now() + delay;
+
+    timers[handle] = {deadline, interval, std::make_shared<std::function<void()>>(std::move(callback))};
+    timer_queue.emplace(deadline, handle);
+
+    if(timer_queue.begin()->second == handle)
+        arm_timer_fd();
+
+    return handle;
+}
+
+void EventLoop::remove_timer(TimerHandle handle)
+{
+    auto it = timers.find(handle);
+    if(it == timers.end())
+        return;
+
+    auto [first, last] = timer_queue.equal_range(it->second.deadline);
+    for(auto queued = first; queued != last; ++queued)
+    {
+        if(queued->second == handle)
+        {
+            timer_queue.erase(queued);
+            break;
+        }
+    }
+
+    timers.erase(it);
+}
+
+
+bool EventLoop::add_signal_handler(int signal_number, std::function<void()> callback)
+{
+    assert(signal_fd != -1);
+
+    sigaddset(&handled_signals, signal_number);
+    if(pthread_sigmask(SIG_BLOCK, &handled_signals, nullptr) != 0 || signalfd(signal_fd, &handled_signals, 0) == -1)
+        return false;
+
+    signal_handlers[signal_number] = std::move(callback);
+    return true;
+}
+
+
+void EventLoop::post(std::function<void()> callback)
+{
+    const std::lock_guard<std::mutex> lock(posted_mutex);
+    if(post_fd == -1)
+        return;
+
+    posted_callbacks.push_back(std::move(callback));
+
+    const uint64_t count = 1;
+    write(post_fd, &count, sizeof(count));
+}
+
+std::mutex& EventLoop::get_idle_mutex()
+{
+    return idle_mutex;
+}
+
+
+const sigset_t& EventLoop::get_default_signal_mask()
+{
+    return original_signal_mask;
+}
@@ -0,0 +1,101 @@
+#include "font_manager.h"
+
+#include <memory>
+#include <unordered_map>
+
+static std::unordered_map<std::string, std::unique_ptr<CachedFont>> fonts;
+
+//Decodes the UTF-8 sequence starting at text[i] and advances i past it. Invalid bytes are returned as is.
+static uint32_t next_codepoint(const std::string& text, size_t& i)
+{
+    const unsigned char lead = text[i];
+    const int length = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 1;
+
+    if (length == 1 || i + length > text.size())
+    {
+        i++;
+        return lead;
+    }
+
+    uint32_t codepoint = lead & (0x7F >> length);
+    for (int j = 1; j < length; ++j)
+        codepoint = (codepoint << 6) | (text[i + j] & 0x3F);
+
+    i += length;
+    return codepoint;
+}
+
+static int glyph_advance(CachedFont* font, const std::string& text, size_t start, size_t end, uint32_t codepoint)
+{
+    if (const int* advance = font->advances.find(codepoint))
+        return *advance;
+
+    int horizontal_advance = 0;
+    int vertical_advance = 0;
+    imlib_context_set_font(font->font);
+    imlib_get_text_advance(text.substr(start, end - start).c_str(), &horizontal_advance, &vertical_advance);
+
+    font->advances.insert_or_assign(codepoint, horizontal_advance);
+    return horizontal_advance;
+}
+
+
+CachedFont* FontManager::get_font(const std::string& face, int size)
+{
+    const std::string name = face + "/" + std::to_string(size);
+
+    //A remembered failed load is still reported as nullptr
+    auto it = fonts.find(name);
+    if (it != fonts.end())
+        return it->second->font ? it->second.get() : nullptr;
+
+    static bool b_added_font_path = false;
+    if (!b_added_font_path)
+    {
+        imlib_add_path_to_font_path("/usr/share/fonts/TTF");
+        b_added_font_path = true;
+    }
+
+    //Failed loads are remembered too so they are not retried for every window
+    std::unique_ptr<CachedFont>& font = fonts[name];
+    font = std::make_unique<CachedFont>();
+    font->font = imlib_load_font(name.c_str());
+    return font->font ? font.get() : nullptr;
+}
+
+int FontManager::measure_text(CachedFont* font, const std::string& text)
+{
+    int width = 0;
+    for (size_t i = 0; i < text.size();)
+    {
+        const size_t start = i;
+        const uint32_t codepoint = next_codepoint(text, i);
+        width += glyph_advance(font, text, start, i, codepoint);
+    }
+    return width;
+}
+
+std::string FontManager::ellipsize_text(CachedFont* font, const std::string& text, int max_width)
+{
+    if (!font || measure_text(font, text) <= max_width)
+        return text;
+
+    const std::string ellipsis = "...";
+    const int available_width = max_width - measure_text(font, ellipsis);
+
+    int width = 0;
+    size_t fitting_length = 0;
+    for (size_t i = 0; i < text.size();)
+    {
+        const size_t start = i;
+        const uint32_t codepoint = next_codepoint(text, i);
+        width += glyph_advance(font, text, start, i, codepoint);
+
+        if (width > available_width)
+            break;
+
+        fitting_length = i;
+    }
+
+    return text.substr(0, fitting_length) + ellipsis;
+}
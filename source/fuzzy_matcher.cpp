@@ -0,0 +1,200 @@
+#include "fuzzy_matcher.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) && !defined(__ILP32__)
+#include <immintrin.h>
+#endif
+
+static inline char to_lower(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+//Letters and digits get a bit each, everything else shares the remaining bits
+static inline uint64_t character_bit(char c)
+{
+    const unsigned char u = c;
+    if (u >= 'a' && u <= 'z')
+        return 1ull << (u - 'a');
+
+    if (u >= '0' && u <= '9')
+        return 1ull << (26 + u - '0');
+
+    return 1ull << (36 + u % 28);
+}
+
+static inline bool is_word_start(const std::string& text, size_t position)
+{
+    if (position == 0)
+        return true;
+
+    const char previous = text[position - 1];
+    return !((previous >= 'a' && previous <= 'z') || (previous >= '0' && previous <= '9'));
+}
+
+/**
+ * A contiguous match beats a scattered one and a match at the start of a word beats one in the middle of it.
+ * Scattered matches are scored on the leftmost match, the same one the filtering found.
+*/
+static int score_match(const std::string& text, const std::string& query)
+{
+    const size_t contiguous = text.find(query);
+    if (contiguous != std::string::npos)
+        return 1000 + (is_word_start(text, contiguous) ? 100 : 0) - (int)std::min<size_t>(contiguous, 100);
+
+    int score = 0;
+    size_t position = 0;
+    size_t previous = std::string::npos;
+
+    for (const char c : query)
+    {
+        position = (const char*)memchr(text.data() + position, c, text.size() - position) - text.data();
+
+        if (previous != std::string::npos && position == previous + 1)
+            score += 8;
+
+        if (is_word_start(text, position))
+            score += 6;
+
+        score -= (int)std::min<size_t>(position - (previous == std::string::npos ? 0 : previous + 1), 4);
+        previous = position++;
+    }
+
+    return score;
+}
+
+
+void FuzzyMatcher::set_candidates(const std::vector<std::string>& new_candidates)
+{
+    candidates.resize(new_candidates.size());
+    character_masks.resize(new_candidates.size());
+
+    for (size_t i = 0; i < new_candidates.size(); ++i)
+    {
+        std::string& candidate = candidates[i];
+        candidate.resize(new_candidates[i].size());
+
+        uint64_t mask = 0;
+        for (size_t j = 0; j < candidate.size(); ++j)
+        {
+            candidate[j] = to_lower(new_candidates[i][j]);
+            mask |= character_bit(candidate[j]);
+        }
+
+        character_masks[i] = mask;
+    }
+
+    //Everything cached was matched against the old candidates
+    query.clear();
+    matches.clear();
+    results.clear();
+}
+
+const std::vector<uint32_t>& FuzzyMatcher::set_query(const std::string& new_query)
+{
+    std::string lower_query(new_query.size(), '\0');
+    std::transform(new_query.begin(), new_query.end(), lower_query.begin(), to_lower);
+
+    //Only the part after what the new query has in common with the current one has to be matched
+    const size_t common = std::mismatch(query.begin(), query.end(), lower_query.begin(), lower_query.end()).first - query.begin();
+    if (common == query.size() && common == lower_query.size() && !matches.empty())
+        return results;
+
+    query = lower_query;
+    matches.resize(std::min(matches.size(), common));
+
+    for (size_t n = matches.size(); n < query.size(); ++n)
+    {
+        std::vector<partial_match> next;
+        if (n == 0)
+            match_all(query[0], next);
+        else
+            match_next(matches[n - 1], query[n], next);
+
+        matches.push_back(std::move(next));
+    }
+
+    rank_results();
+    return results;
+}
+
+void FuzzyMatcher::match_all(char c, std::vector<partial_match>& out) const
+{
+    const uint64_t bit = character_bit(c);
+    const auto match = [&](uint32_t i)
+    {
+        const std::string& candidate = candidates[i];
+        const char* found = (const char*)memchr(candidate.data(), c, candidate.size());
+        if (found)
+            out.push_back({i, (uint32_t)(found - candidate.data()) + 1});
+    };
+
+    uint32_t i = 0;
+
+#if defined(__x86_64__) && !defined(__ILP32__)
+    //Two masks at a time, only candidates whose mask has the bit are searched
+    const __m128i bit_wide = _mm_set1_epi64x(bit);
+    for (; i + 2 <= candidates.size(); i += 2)
+    {
+        const __m128i masks = _mm_loadu_si128((const __m128i*)(character_masks.data() + i));
+        const __m128i missing = _mm_cmpeq_epi32(_mm_and_si128(masks, bit_wide), _mm_setzero_si128());
+
+        //Each 64 bit lane is missing the bit if both of its 32 bit halves are zero
+        const int missing_lanes = _mm_movemask_ps(_mm_castsi128_ps(missing));
+        if ((missing_lanes & 0x3) != 0x3)
+            match(i);
+        if ((missing_lanes & 0xC) != 0xC)
+            match(i + 1);
+    }
+#endif
+
+    for (; i < candidates.size(); ++i)
+    {
+        if (character_masks[i] & bit)
+            match(i);
+    }
+}
+
+void FuzzyMatcher::match_next(const std::vector<partial_match>& previous, char c, std::vector<partial_match>& out) const
+{
+    const uint64_t bit = character_bit(c);
+    out.reserve(previous.size());
+
+    for (const partial_match& partial : previous)
+    {
+        if (!(character_masks[partial.candidate] & bit))
+            continue;
+
+        //The leftmost match of the shorter query is a prefix of the leftmost match of this one
+        const std::string& candidate = candidates[partial.candidate];
+        const char* found = (const char*)memchr(candidate.data() + partial.end, c, candidate.size() - partial.end);
+        if (found)
+            out.push_back({partial.candidate, (uint32_t)(found - candidate.data()) + 1});
+    }
+}
+
+void FuzzyMatcher::rank_results()
+{
+    results.clear();
+    if (query.empty())
+    {
+        results.resize(candidates.size());
+        for (uint32_t i = 0; i < candidates.size(); ++i)
+            results[i] = i;
+
+        return;
+    }
+
+    std::vector<std::pair<int, uint32_t>> scored;
+    scored.reserve(matches.back().size());
+    for (const partial_match& match : matches.back())
+        scored.push_back({score_match(candidates[match.candidate], query), match.candidate});
+
+    std::stable_sort(scored.begin(), scored.end(), [](const auto& a, const auto& b){ return a.first > b.first; });
+
+    results.reserve(scored.size());
+    for (const auto& [score, candidate] : scored)
+        results.push_back(candidate);
+}
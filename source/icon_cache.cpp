@@ -0,0 +1,328 @@
+#include "icon_cache.h"
+#include "config.h"
+#include "event_loop.h"
+#include "icon_index.h"
+#include "image_decoder.h"
+#include "pixel_convert.h"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <unordered_map>
+
+//Everything but the job queue is only touched on the event thread
+static std::unordered_map<std::string, std::shared_ptr<CachedIcon>> icons;
+static std::shared_ptr<CachedIcon> default_icon;
+
+//Callbacks of windows waiting for an icon the worker is loading, keyed like icons
+static std::unordered_map<std::string, std::vector<IconCache::IconLoaded>> pending_icons;
+//Bumped by clear(), icons the worker made before that were scaled with the old config
+static uint64_t cache_generation = 0;
+
+struct icon_job
+{
+    std::string key;
+    std::string window_class;
+    std::string icon_name;
+    //The switcher variant is the largest one, read from the config on the event thread
+    uint size;
+    uint64_t generation;
+};
+
+static std::thread worker;
+static std::mutex job_mutex;
+static std::condition_variable job_condition;
+static std::deque<icon_job> jobs;
+static bool b_stop_worker = false;
+
+static void icon_resolved(const std::string& key, std::shared_ptr<CachedIcon> icon, uint64_t generation);
+
+template <typename Pixel>
+struct icon_pixels
+{
+    uint width;
+    uint height;
+    std::span<const Pixel> pixels;
+};
+
+/**
+ * _NET_WM_ICON holds any number of width, height, pixels entries.
+ * Picks the smallest one that is at least target_size, or the largest one if they are all smaller.
+*/
+static bool select_net_wm_icon(const std::vector<unsigned long>& icon_data, uint target_size, icon_pixels<unsigned long>& best)
+{
+    bool b_found = false;
+    size_t offset = 0;
+
+    while (offset + 2 <= icon_data.size())
+    {
+        const uint width = icon_data[offset];
+        const uint height = icon_data[offset + 1];
+        const size_t n_pixels = (size_t)width * height;
+
+        if (width == 0 || height == 0 || icon_data.size() - offset - 2 < n_pixels)
+            break;
+
+        const uint size = std::max(width, height);
+        const uint best_size = std::max(best.width, best.height);
+        const bool b_better = best_size < target_size ? size > best_size : (size >= target_size && size < best_size);
+
+        if (!b_found || b_better)
+        {
+            best = {width, height, std::span(icon_data.data() + offset + 2, n_pixels)};
+            b_found = true;
+        }
+
+        offset += 2 + n_pixels;
+    }
+
+    return b_found;
+}
+
+//The variant is composited over the background it is drawn on, so it is opaque and drawn without blending
+template <typename Pixel>
+static Imlib_Image create_variant(const icon_pixels<Pixel>& source, ulong background, uint width, uint height)
+{
+    std::vector<uint32_t> flattened(source.pixels.size());
+    PixelConvert::flatten_argb(source.pixels.data(), flattened.data(), flattened.size(), background);
+
+    Imlib_Image image = imlib_create_image_using_data(source.width, source.height, flattened.data());
+    if (!image)
+        return nullptr;
+
+    imlib_context_set_image(image);
+    imlib_image_set_has_alpha(0);
+    imlib_context_set_anti_alias(1);
+    Imlib_Image variant = imlib_create_cropped_scaled_image(0, 0, source.width, source.height, width, height);
+    imlib_free_image();
+
+    if (variant)
+    {
+        imlib_context_set_image(variant);
+        imlib_image_set_has_alpha(0);
+    }
+    return variant;
+}
+
+template <typename Pixel>
+static std::shared_ptr<CachedIcon> create_icon(const icon_pixels<Pixel>& titlebar_source, const icon_pixels<Pixel>& switcher_source)
+{
+    std::shared_ptr<CachedIcon> icon = std::make_shared<CachedIcon>();
+
+    const uint titlebar_size = IconCache::get_titlebar_icon_size();
+    icon->titlebar.image = create_variant(titlebar_source, EshyWMConfig::window_background_color, titlebar_size, titlebar_size);
+    icon->titlebar.b_this_owns_image = true;
+
+    const float scale = (float)EshyWMConfig::switcher_button_height / switcher_source.height;
+    const uint switcher_width = std::max((uint)std::round(switcher_source.width * scale), 1u);
+    icon->switcher.image = create_variant(switcher_source, EshyWMConfig::switcher_button_color, switcher_width, EshyWMConfig::switcher_button_height);
+    icon->switcher.b_this_owns_image = true;
+
+    return icon;
+}
+
+//Takes ownership of image
+static std::shared_ptr<CachedIcon> create_icon(Imlib_Image image)
+{
+    imlib_context_set_image(image);
+    const uint width = imlib_image_get_width();
+    const uint height = imlib_image_get_height();
+    const icon_pixels<uint32_t> source = {width, height, std::span((const uint32_t*)imlib_image_get_data_for_reading_only(), (size_t)width * height)};
+
+    std::shared_ptr<CachedIcon> icon = create_icon(source, source);
+
+    imlib_context_set_image(image);
+    imlib_free_image();
+    return icon;
+}
+
+static std::shared_ptr<CachedIcon> load_net_wm_icon(const X11::WindowPrefetch& prefetch)
+{
+    //Every variant is scaled from the closest size the client provides
+    icon_pixels<unsigned long> titlebar_source = {};
+    icon_pixels<unsigned long> switcher_source = {};
+    if (!select_net_wm_icon(prefetch.icon_data, IconCache::get_titlebar_icon_size(), titlebar_source)
+        || !select_net_wm_icon(prefetch.icon_data, EshyWMConfig::switcher_button_height, switcher_source))
+        return nullptr;
+
+    return create_icon(titlebar_source, switcher_source);
+}
+
+//Runs on the worker thread, only the pixels are decoded here. The Imlib2 images are made on the event thread.
+static bool load_disk_icon(const icon_job& job, decoded_image& image)
+{
+    std::string icon_path = IconIndex::find_icon_file(job.icon_name, job.size);
+    if (icon_path.empty())
+        icon_path = IconIndex::find_icon_file(IconIndex::find_desktop_icon(job.window_class), job.size);
+
+    return !icon_path.empty() && ImageDecoder::load_file(icon_path, image);
+}
+
+static void icon_worker()
+{
+    while (true)
+    {
+        icon_job job;
+        {
+            std::unique_lock<std::mutex> lock(job_mutex);
+            job_condition.wait(lock, [](){ return b_stop_worker || !jobs.empty(); });
+            if (b_stop_worker)
+                return;
+
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        std::shared_ptr<decoded_image> image = std::make_shared<decoded_image>();
+        if (!load_disk_icon(job, *image))
+            image.reset();
+
+        EventLoop::post([key = job.key, image, generation = job.generation]()
+        {
+            std::shared_ptr<CachedIcon> icon;
+            if (image && generation == cache_generation)
+            {
+                const icon_pixels<uint32_t> source = {image->width, image->height, std::span<const uint32_t>(image->pixels)};
+                icon = create_icon(source, source);
+            }
+
+            icon_resolved(key, icon, generation);
+        });
+    }
+}
+
+static std::shared_ptr<CachedIcon> get_default_icon()
+{
+    if (default_icon)
+        return default_icon;
+
+    Imlib_Image image = imlib_load_image(EshyWMConfig::default_application_image_path.c_str());
+    default_icon = image ? create_icon(image) : std::make_shared<CachedIcon>();
+    return default_icon;
+}
+
+static void icon_resolved(const std::string& key, std::shared_ptr<CachedIcon> icon, uint64_t generation)
+{
+    if (generation != cache_generation)
+        return;
+
+    std::vector<IconCache::IconLoaded> waiting;
+    auto pending = pending_icons.find(key);
+    if (pending != pending_icons.end())
+    {
+        waiting = std::move(pending->second);
+        pending_icons.erase(pending);
+    }
+
+    //Keys without an icon are remembered too so the filesystem is only searched once.
+    //A window of the same class may have brought its own _NET_WM_ICON in the meantime, that one is kept.
+    const std::shared_ptr<CachedIcon> cached_icon = icons.try_emplace(key, icon ? icon : get_default_icon()).first->second;
+    if (cached_icon == get_default_icon())
+        return;
+
+    for (const IconCache::IconLoaded& icon_loaded : waiting)
+        icon_loaded(cached_icon);
+}
+
+//Windows of the same class share their icon, windows without a class can only share an icon theme entry
+static std::string icon_key(const X11::WindowPrefetch& prefetch)
+{
+    if (!prefetch.window_class.empty())
+        return prefetch.window_class;
+
+    return prefetch.icon_name.empty() ? "" : "/" + prefetch.icon_name;
+}
+
+static void request_disk_icon(const std::string& key, const X11::WindowPrefetch& prefetch, IconCache::IconLoaded icon_loaded)
+{
+    const bool b_already_requested = pending_icons.contains(key);
+
+    std::vector<IconCache::IconLoaded>& waiting = pending_icons[key];
+    if (icon_loaded)
+        waiting.push_back(std::move(icon_loaded));
+
+    if (b_already_requested)
+        return;
+
+    {
+        const std::lock_guard<std::mutex> lock(job_mutex);
+        jobs.push_back({key, prefetch.window_class, prefetch.icon_name, EshyWMConfig::switcher_button_height, cache_generation});
+    }
+    job_condition.notify_one();
+}
+
+
+void IconCache::initialize()
+{
+    b_stop_worker = false;
+    worker = std::thread(&icon_worker);
+}
+
+void IconCache::shutdown()
+{
+    {
+        const std::lock_guard<std::mutex> lock(job_mutex);
+        b_stop_worker = true;
+        jobs.clear();
+    }
+    job_condition.notify_one();
+
+    if (worker.joinable())
+        worker.join();
+
+    pending_icons.clear();
+}
+
+void IconCache::clear()
+{
+    icons.clear();
+    pending_icons.clear();
+    default_icon.reset();
+    ++cache_generation;
+}
+
+std::shared_ptr<CachedIcon> IconCache::get_icon(const X11::WindowPrefetch& prefetch, IconLoaded icon_loaded)
+{
+    const std::string key = icon_key(prefetch);
+    auto cached = icons.find(key);
+
+    //Without a class there is nothing to share, the window's own _NET_WM_ICON comes first
+    if (cached != icons.end() && !prefetch.window_class.empty())
+        return cached->second;
+
+    if (std::shared_ptr<CachedIcon> icon = load_net_wm_icon(prefetch))
+    {
+        if (!prefetch.window_class.empty())
+            icons[key] = icon;
+        return icon;
+    }
+
+    if (cached != icons.end())
+        return cached->second;
+
+    if (!key.empty())
+        request_disk_icon(key, prefetch, std::move(icon_loaded));
+
+    return get_default_icon();
+}
+
+std::shared_ptr<CachedIcon> IconCache::reload_icon(const X11::WindowPrefetch& prefetch, IconLoaded icon_loaded)
+{
+    std::shared_ptr<CachedIcon> icon = load_net_wm_icon(prefetch);
+    if (!icon)
+        return get_icon(prefetch, std::move(icon_loaded));
+
+    if (!prefetch.window_class.empty())
+        icons[prefetch.window_class] = icon;
+
+    return icon;
+}
+
+uint IconCache::get_titlebar_icon_size()
+{
+    return EshyWMConfig::titlebar_height > 8 ? EshyWMConfig::titlebar_height - 8 : 1;
+}
@@ -0,0 +1,658 @@
+#include "icon_index.h"
+#include "event_loop.h"
+#include "util.h"
+
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace fs = std::filesystem;
+
+/**
+ * File layout, every offset is from the start of the file:
+ * index_header, then two open addressing hash tables of index_bucket and the strings they point to.
+ * Desktop buckets point to the Icon= string. Icon buckets point to a uint32_t count followed by that many
+ * index_icon_file sorted by size. Offset 0 is the header, so a bucket with key_offset 0 is empty.
+*/
+static const char INDEX_MAGIC[8] = {'E', 'S', 'H', 'Y', 'I', 'D', 'X', '1'};
+
+struct index_header
+{
+    char magic[8];
+    uint64_t stamp;
+    uint32_t desktop_buckets_offset;
+    uint32_t n_desktop_buckets;
+    uint32_t icon_buckets_offset;
+    uint32_t n_icon_buckets;
+};
+
+struct index_bucket
+{
+    uint32_t hash;
+    uint32_t key_offset;
+    uint32_t value_offset;
+};
+
+struct index_icon_file
+{
+    //0 for icons outside of a sized theme directory, like /usr/share/pixmaps
+    uint32_t size;
+    uint32_t path_offset;
+};
+
+//A loaded index, mapped from the cache file or kept in memory if the file could not be written
+struct MappedIndex
+{
+    ~MappedIndex()
+    {
+        if (mapping)
+            munmap(mapping, size);
+    }
+
+    const index_header& header() const {return *(const index_header*)data;}
+
+    std::string_view string_at(uint32_t offset) const
+    {
+        if (offset >= size)
+            return {};
+
+        return std::string_view(data + offset, strnlen(data + offset, size - offset));
+    }
+
+    const char* data = nullptr;
+    size_t size = 0;
+
+    void* mapping = nullptr;
+    std::vector<char> buffer;
+};
+
+//What the index is built from. Every directory is watched and its mtime is part of the stamp.
+struct index_sources
+{
+    std::vector<fs::path> application_directories;
+    std::vector<fs::path> icon_directories;
+    uint64_t stamp = 0;
+};
+
+static std::mutex index_mutex;
+static std::condition_variable index_available;
+static std::shared_ptr<const MappedIndex> current_index;
+static bool b_stopped = false;
+
+//Only touched on the event thread
+static std::thread builder;
+static bool b_building = false;
+static bool b_rebuild_queued = false;
+static std::atomic<bool> b_stop_builder = false;
+static int inotify_fd = -1;
+static EventLoop::TimerHandle rebuild_timer = 0;
+
+
+static uint32_t hash_string(std::string_view string)
+{
+    //FNV-1a
+    uint32_t hash = 2166136261u;
+    for (const char c : string)
+        hash = (hash ^ (unsigned char)c) * 16777619u;
+    return hash;
+}
+
+static uint64_t hash_bytes(uint64_t hash, const void* bytes, size_t length)
+{
+    for (size_t i = 0; i < length; ++i)
+        hash = (hash ^ ((const unsigned char*)bytes)[i]) * 1099511628211ull;
+    return hash;
+}
+
+static std::string to_lower(std::string string)
+{
+    std::transform(string.begin(), string.end(), string.begin(), [](unsigned char c){ return std::tolower(c); });
+    return string;
+}
+
+static fs::path get_index_path()
+{
+    const char* cache_home = getenv("XDG_CACHE_HOME");
+    const fs::path cache_directory = (cache_home && *cache_home) ? fs::path(cache_home) : fs::path(getenv("HOME")) / ".cache";
+    return cache_directory / "eshywm" / "icon_index";
+}
+
+static std::vector<fs::path> get_data_directories()
+{
+    std::vector<fs::path> directories;
+
+    const char* data_home = getenv("XDG_DATA_HOME");
+    directories.push_back((data_home && *data_home) ? fs::path(data_home) : fs::path(getenv("HOME")) / ".local/share");
+
+    const char* data_dirs = getenv("XDG_DATA_DIRS");
+    const std::string data_dirs_list = (data_dirs && *data_dirs) ? data_dirs : "/usr/local/share:/usr/share";
+    for (size_t start = 0; start <= data_dirs_list.size();)
+    {
+        const size_t end = std::min(data_dirs_list.find(':', start), data_dirs_list.size());
+        if (end > start)
+            directories.push_back(data_dirs_list.substr(start, end - start));
+        start = end + 1;
+    }
+
+    return directories;
+}
+
+//Adds directory and every directory below it in walk order
+static void add_directory_tree(const fs::path& directory, std::vector<fs::path>& directories)
+{
+    std::error_code error;
+    if (!fs::is_directory(directory, error))
+        return;
+
+    directories.push_back(directory);
+
+    std::vector<fs::path> children;
+    for (const fs::directory_entry& entry : fs::directory_iterator(directory, error))
+    {
+        if (entry.is_directory(error))
+            children.push_back(entry.path());
+    }
+
+    std::sort(children.begin(), children.end());
+    for (const fs::path& child : children)
+    {
+        if (b_stop_builder)
+            return;
+
+        add_directory_tree(child, directories);
+    }
+}
+
+static index_sources find_sources()
+{
+    index_sources sources;
+
+    for (const fs::path& data_directory : get_data_directories())
+    {
+        add_directory_tree(data_directory / "applications", sources.application_directories);
+
+        //hicolor holds what applications install themselves, so it is preferred over the generic themes
+        add_directory_tree(data_directory / "icons" / "hicolor", sources.icon_directories);
+
+        std::error_code error;
+        std::vector<fs::path> themes;
+        for (const fs::directory_entry& entry : fs::directory_iterator(data_directory / "icons", error))
+        {
+            if (entry.is_directory(error) && entry.path().filename() != "hicolor")
+                themes.push_back(entry.path());
+        }
+
+        std::sort(themes.begin(), themes.end());
+        for (const fs::path& theme : themes)
+            add_directory_tree(theme, sources.icon_directories);
+    }
+
+    add_directory_tree("/usr/share/pixmaps", sources.icon_directories);
+
+    uint64_t stamp = 14695981039346656037ull;
+    for (const std::vector<fs::path>* directories : {&sources.application_directories, &sources.icon_directories})
+    {
+        for (const fs::path& directory : *directories)
+        {
+            struct stat directory_stat;
+            if (stat(directory.c_str(), &directory_stat) != 0)
+                continue;
+
+            stamp = hash_bytes(stamp, directory.c_str(), strlen(directory.c_str()));
+            stamp = hash_bytes(stamp, &directory_stat.st_mtim, sizeof(directory_stat.st_mtim));
+        }
+    }
+
+    sources.stamp = stamp;
+    return sources;
+}
+
+//Entries in subdirectories are prefixed with the subdirectory, applications/kde/foo.desktop is kde-foo
+static std::string get_desktop_id(const fs::path& path)
+{
+    std::string desktop_id = path.stem().string();
+    for (fs::path parent = path.parent_path(); parent.has_relative_path() && parent.filename() != "applications"; parent = parent.parent_path())
+        desktop_id = parent.filename().string() + "-" + desktop_id;
+
+    return desktop_id;
+}
+
+static void read_desktop_entry(const fs::path& path, const std::string& desktop_id, std::unordered_map<std::string, std::string>& desktop_icons)
+{
+    std::ifstream desktop_file(path);
+
+    std::string line;
+    std::string icon;
+    std::string startup_wm_class;
+    bool b_in_desktop_entry = false;
+
+    while (getline(desktop_file, line))
+    {
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' '))
+            line.pop_back();
+
+        if (line.starts_with('['))
+            b_in_desktop_entry = line == "[Desktop Entry]";
+        else if (!b_in_desktop_entry)
+            continue;
+        else if (line.starts_with("Icon="))
+            icon = line.substr(5);
+        else if (line.starts_with("StartupWMClass="))
+            startup_wm_class = line.substr(15);
+    }
+
+    if (icon.empty())
+        return;
+
+    //Earlier data directories take precedence, like they do for desktop IDs
+    desktop_icons.try_emplace(to_lower(desktop_id), icon);
+    if (!startup_wm_class.empty())
+        desktop_icons.try_emplace(to_lower(startup_wm_class), icon);
+}
+
+//The size of the theme directory, 48 for .../48x48/apps or .../48x48@2/apps
+static uint32_t directory_icon_size(const fs::path& directory)
+{
+    for (fs::path path = directory; path.has_relative_path() && path.filename() != "icons"; path = path.parent_path())
+    {
+        const std::string name = path.filename().string();
+
+        size_t digits = 0;
+        while (digits < name.size() && std::isdigit((unsigned char)name[digits]))
+            digits++;
+
+        if (digits == 0 || (digits < name.size() && name[digits] != 'x' && name[digits] != '@'))
+            continue;
+
+        const uint32_t size = std::stoul(name.substr(0, digits));
+        const size_t scale_position = name.find('@');
+        const uint32_t scale = scale_position != std::string::npos ? std::max(std::atoi(name.c_str() + scale_position + 1), 1) : 1;
+        return size * scale;
+    }
+
+    return 0;
+}
+
+static uint32_t append_bytes(std::vector<char>& data, const void* bytes, size_t length)
+{
+    const uint32_t offset = data.size();
+    data.insert(data.end(), (const char*)bytes, (const char*)bytes + length);
+    return offset;
+}
+
+static uint32_t append_string(std::vector<char>& data, const std::string& string)
+{
+    return append_bytes(data, string.c_str(), string.size() + 1);
+}
+
+static void align_data(std::vector<char>& data)
+{
+    data.resize((data.size() + alignof(index_bucket) - 1) & ~(alignof(index_bucket) - 1));
+}
+
+template <typename Entries, typename AppendValue>
+static uint32_t append_table(std::vector<char>& data, const Entries& entries, AppendValue append_value, uint32_t& n_buckets)
+{
+    //Power of two and at most half full, so a miss ends after a few probes
+    n_buckets = 1;
+    while (n_buckets < entries.size() * 2)
+        n_buckets <<= 1;
+
+    std::vector<index_bucket> buckets(n_buckets, index_bucket{0, 0, 0});
+    for (const auto& [key, value] : entries)
+    {
+        const uint32_t hash = hash_string(key);
+        uint32_t slot = hash & (n_buckets - 1);
+        while (buckets[slot].key_offset != 0)
+            slot = (slot + 1) & (n_buckets - 1);
+
+        buckets[slot].hash = hash;
+        buckets[slot].key_offset = append_string(data, key);
+        buckets[slot].value_offset = append_value(value);
+    }
+
+    align_data(data);
+    return append_bytes(data, buckets.data(), buckets.size() * sizeof(index_bucket));
+}
+
+static std::vector<char> build_index(const index_sources& sources)
+{
+    std::unordered_map<std::string, std::string> desktop_icons;
+    for (const fs::path& directory : sources.application_directories)
+    {
+        std::error_code error;
+        for (const fs::directory_entry& entry : fs::directory_iterator(directory, error))
+        {
+            if (b_stop_builder)
+                return {};
+
+            if (entry.path().extension() != ".desktop" || !entry.is_regular_file(error))
+                continue;
+
+            read_desktop_entry(entry.path(), get_desktop_id(entry.path()), desktop_icons);
+        }
+    }
+
+    //Imlib2 cannot be relied on to load svg, so scalable icons are left out
+    std::unordered_map<std::string, std::map<uint32_t, std::string>> icon_files;
+    for (const fs::path& directory : sources.icon_directories)
+    {
+        const uint32_t size = directory_icon_size(directory);
+
+        std::error_code error;
+        for (const fs::directory_entry& entry : fs::directory_iterator(directory, error))
+        {
+            if (b_stop_builder)
+                return {};
+
+            const fs::path extension = entry.path().extension();
+            if ((extension != ".png" && extension != ".xpm") || !entry.is_regular_file(error))
+                continue;
+
+            //The first theme to provide a size wins
+            icon_files[entry.path().stem().string()].try_emplace(size, entry.path().string());
+        }
+    }
+
+    std::vector<char> data(sizeof(index_header), 0);
+    index_header header = {};
+    memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.stamp = sources.stamp;
+
+    header.desktop_buckets_offset = append_table(data, desktop_icons, [&data](const std::string& icon)
+    {
+        return append_string(data, icon);
+    }, header.n_desktop_buckets);
+
+    header.icon_buckets_offset = append_table(data, icon_files, [&data](const std::map<uint32_t, std::string>& files)
+    {
+        std::vector<index_icon_file> file_entries;
+        for (const auto& [size, path] : files)
+            file_entries.push_back({size, append_string(data, path)});
+
+        align_data(data);
+        const uint32_t count = file_entries.size();
+        const uint32_t offset = append_bytes(data, &count, sizeof(count));
+        append_bytes(data, file_entries.data(), file_entries.size() * sizeof(index_icon_file));
+        return offset;
+    }, header.n_icon_buckets);
+
+    memcpy(data.data(), &header, sizeof(header));
+    return data;
+}
+
+static bool is_valid_table(size_t size, uint32_t offset, uint32_t n_buckets)
+{
+    return n_buckets != 0 && (n_buckets & (n_buckets - 1)) == 0 && offset % alignof(index_bucket) == 0
+        && offset <= size && (size - offset) / sizeof(index_bucket) >= n_buckets;
+}
+
+static bool is_valid_index(const char* data, size_t size)
+{
+    if (size < sizeof(index_header) || memcmp(data, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0)
+        return false;
+
+    const index_header& header = *(const index_header*)data;
+    return is_valid_table(size, header.desktop_buckets_offset, header.n_desktop_buckets) && is_valid_table(size, header.icon_buckets_offset, header.n_icon_buckets);
+}
+
+static std::shared_ptr<MappedIndex> map_index_file(const fs::path& path)
+{
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return nullptr;
+
+    struct stat file_stat;
+    void* mapping = (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) ? mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+
+    if (mapping == MAP_FAILED)
+        return nullptr;
+
+    std::shared_ptr<MappedIndex> index = std::make_shared<MappedIndex>();
+    index->mapping = mapping;
+    index->data = (const char*)mapping;
+    index->size = file_stat.st_size;
+    return is_valid_index(index->data, index->size) ? index : nullptr;
+}
+
+//Writes the index next to the old one and renames it over, so a running instance never sees half a file
+static std::shared_ptr<MappedIndex> write_index_file(const fs::path& path, std::vector<char> data)
+{
+    std::error_code error;
+    fs::create_directories(path.parent_path(), error);
+
+    const fs::path temporary_path = path.string() + ".tmp";
+    {
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+        file.write(data.data(), data.size());
+    }
+
+    if (rename(temporary_path.c_str(), path.c_str()) == 0)
+    {
+        if (std::shared_ptr<MappedIndex> index = map_index_file(path))
+            return index;
+    }
+
+    LOGE("Failed to write the icon index, keeping it in memory");
+
+    std::shared_ptr<MappedIndex> index = std::make_shared<MappedIndex>();
+    index->buffer = std::move(data);
+    index->data = index->buffer.data();
+    index->size = index->buffer.size();
+    return index;
+}
+
+static void set_index(std::shared_ptr<const MappedIndex> index)
+{
+    {
+        const std::lock_guard<std::mutex> lock(index_mutex);
+        current_index = std::move(index);
+    }
+    index_available.notify_all();
+}
+
+static std::shared_ptr<const MappedIndex> wait_for_index()
+{
+    std::unique_lock<std::mutex> lock(index_mutex);
+    index_available.wait(lock, [](){ return current_index || b_stopped; });
+    return current_index;
+}
+
+static const index_bucket* find_bucket(const MappedIndex& index, uint32_t buckets_offset, uint32_t n_buckets, std::string_view key)
+{
+    const index_bucket* buckets = (const index_bucket*)(index.data + buckets_offset);
+    const uint32_t hash = hash_string(key);
+
+    for (uint32_t probe = 0; probe < n_buckets; ++probe)
+    {
+        const index_bucket& bucket = buckets[(hash + probe) & (n_buckets - 1)];
+        if (bucket.key_offset == 0)
+            return nullptr;
+
+        if (bucket.hash == hash && index.string_at(bucket.key_offset) == key)
+            return &bucket;
+    }
+
+    return nullptr;
+}
+
+
+static void watch_directories(const index_sources& sources)
+{
+    for (const std::vector<fs::path>* directories : {&sources.application_directories, &sources.icon_directories})
+    {
+        //Watching a directory again only updates the existing watch
+        for (const fs::path& directory : *directories)
+            inotify_add_watch(inotify_fd, directory.c_str(), IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_ONLYDIR);
+    }
+}
+
+static void start_rebuild(bool b_only_if_stale);
+
+static void rebuild_finished(std::shared_ptr<index_sources> sources, std::shared_ptr<MappedIndex> index)
+{
+    builder.join();
+    b_building = false;
+
+    if (index)
+        set_index(index);
+
+    watch_directories(*sources);
+
+    if (b_rebuild_queued)
+    {
+        b_rebuild_queued = false;
+        start_rebuild(false);
+    }
+}
+
+static void start_rebuild(bool b_only_if_stale)
+{
+    if (b_building)
+    {
+        b_rebuild_queued = true;
+        return;
+    }
+
+    b_building = true;
+
+    std::shared_ptr<const MappedIndex> index;
+    {
+        const std::lock_guard<std::mutex> lock(index_mutex);
+        index = current_index;
+    }
+    const uint64_t current_stamp = index ? index->header().stamp : 0;
+
+    builder = std::thread([b_only_if_stale, current_stamp]()
+    {
+        std::shared_ptr<index_sources> sources = std::make_shared<index_sources>(find_sources());
+
+        std::shared_ptr<MappedIndex> index;
+        if (!b_stop_builder && (!b_only_if_stale || sources->stamp != current_stamp))
+        {
+            std::vector<char> data = build_index(*sources);
+            if (!b_stop_builder)
+                index = write_index_file(get_index_path(), std::move(data));
+        }
+
+        EventLoop::post([sources, index]()
+        {
+            rebuild_finished(sources, index);
+        });
+    });
+}
+
+static void handle_inotify(uint32_t events)
+{
+    alignas(inotify_event) char buffer[4096];
+    while (read(inotify_fd, buffer, sizeof(buffer)) > 0) {}
+
+    //Package managers touch many files at once, rebuild once they are done
+    EventLoop::remove_timer(rebuild_timer);
+    rebuild_timer = EventLoop::add_timer(2s, 0ms, []()
+    {
+        rebuild_timer = 0;
+        start_rebuild(false);
+    });
+}
+
+
+void IconIndex::initialize()
+{
+    b_stopped = false;
+    b_stop_builder = false;
+
+    //A previous index is used right away, it is only replaced if something changed since it was written
+    if (std::shared_ptr<MappedIndex> index = map_index_file(get_index_path()))
+        set_index(index);
+
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd == -1 || !EventLoop::add_fd(inotify_fd, EPOLLIN, &handle_inotify))
+        LOGE("Failed to watch the icon directories, the icon index will not be refreshed");
+
+    start_rebuild(true);
+}
+
+void IconIndex::shutdown()
+{
+    {
+        const std::lock_guard<std::mutex> lock(index_mutex);
+        b_stopped = true;
+    }
+    index_available.notify_all();
+
+    b_stop_builder = true;
+    if (builder.joinable())
+        builder.join();
+    b_building = false;
+
+    if (inotify_fd != -1)
+    {
+        EventLoop::remove_fd(inotify_fd);
+        close(inotify_fd);
+        inotify_fd = -1;
+    }
+}
+
+std::string IconIndex::find_desktop_icon(const std::string& window_class)
+{
+    const std::shared_ptr<const MappedIndex> index = wait_for_index();
+    if (!index || window_class.empty())
+        return "";
+
+    const index_header& header = index->header();
+    const index_bucket* bucket = find_bucket(*index, header.desktop_buckets_offset, header.n_desktop_buckets, to_lower(window_class));
+    return bucket ? std::string(index->string_at(bucket->value_offset)) : "";
+}
+
+std::string IconIndex::find_icon_file(const std::string& icon, uint32_t size)
+{
+    if (icon.starts_with('/'))
+        return icon;
+
+    const std::shared_ptr<const MappedIndex> index = wait_for_index();
+    if (!index || icon.empty())
+        return "";
+
+    const index_header& header = index->header();
+    const index_bucket* bucket = find_bucket(*index, header.icon_buckets_offset, header.n_icon_buckets, icon);
+    if (!bucket || bucket->value_offset % alignof(uint32_t) != 0 || bucket->value_offset + sizeof(uint32_t) > index->size)
+        return "";
+
+    const uint32_t count = *(const uint32_t*)(index->data + bucket->value_offset);
+    if ((index->size - bucket->value_offset - sizeof(uint32_t)) / sizeof(index_icon_file) < count)
+        return "";
+
+    //Sorted by size, so this is the smallest one that is at least size, or the largest one.
+    //Unsized icons are only used when there is nothing else.
+    const index_icon_file* files = (const index_icon_file*)(index->data + bucket->value_offset + sizeof(uint32_t));
+    const index_icon_file* best = nullptr;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (!best || best->size < size)
+            best = &files[i];
+    }
+
+    return best ? std::string(index->string_at(best->path_offset)) : "";
+}
@@ -15,7 +15,7 @@ Image::Image(Imlib_Image _image)
 
 Image::~Image()
 {
-    if (b_this_owns_image)
+    if (b_this_owns_image && image)
     {
         imlib_context_set_image(image);
         imlib_free_image();
@@ -29,8 +29,7 @@ void Image::draw(Drawable drawable, int x, int y)
 
     imlib_context_set_drawable(drawable);
     imlib_context_set_image(image);
-    imlib_context_set_blend(1);
-    imlib_image_set_has_alpha(1);
+    imlib_context_set_blend(imlib_image_has_alpha());
     imlib_render_image_on_drawable(x, y);
 }
 
@@ -41,7 +40,6 @@ void Image::draw(Drawable drawable, int x, int y, int width, int height)
     
     imlib_context_set_drawable(drawable);
     imlib_context_set_image(image);
-    imlib_context_set_blend(1);
-    imlib_image_set_has_alpha(1);
+    imlib_context_set_blend(imlib_image_has_alpha());
     imlib_render_image_on_drawable_at_size(x, y, width, height);
 }
@@ -0,0 +1,255 @@
+#include "image_decoder.h"
+#include "event_loop.h"
+
+#include <Imlib2.h>
+#include <png.h>
+
+#include <csetjmp>
+#include <cstdio>
+#include <jpeglib.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+
+//Weights of the source pixels that make up each destination pixel along one axis
+struct filter_weights
+{
+    std::vector<int> first;
+    std::vector<int> count;
+    std::vector<size_t> offset;
+    std::vector<float> weights;
+    int max_count = 0;
+};
+
+struct jpeg_error_handler
+{
+    jpeg_error_mgr manager;
+    jmp_buf jump;
+};
+
+static bool load_png(const std::string& path, decoded_image& image)
+{
+    png_image png;
+    memset(&png, 0, sizeof(png));
+    png.version = PNG_IMAGE_VERSION;
+
+    //libpng frees the png_image itself when reading fails
+    if (!png_image_begin_read_from_file(&png, path.c_str()))
+        return false;
+
+    //ARGB as a native 32 bit value
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    png.format = PNG_FORMAT_ARGB;
+#else
+    png.format = PNG_FORMAT_BGRA;
+#endif
+
+    image.width = png.width;
+    image.height = png.height;
+    image.pixels.resize((size_t)png.width * png.height);
+    if (!png_image_finish_read(&png, nullptr, image.pixels.data(), 0, nullptr))
+    {
+        image.pixels.clear();
+        return false;
+    }
+
+    return true;
+}
+
+static bool load_jpeg(const std::string& path, decoded_image& image)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+
+    jpeg_decompress_struct jpeg;
+    jpeg_error_handler error;
+    jpeg.err = jpeg_std_error(&error.manager);
+    //The default handler exits the process
+    error.manager.error_exit = [](j_common_ptr info){ longjmp(((jpeg_error_handler*)info->err)->jump, 1); };
+    error.manager.output_message = [](j_common_ptr){};
+
+    if (setjmp(error.jump))
+    {
+        jpeg_destroy_decompress(&jpeg);
+        fclose(file);
+        image.pixels.clear();
+        return false;
+    }
+
+    jpeg_create_decompress(&jpeg);
+    jpeg_stdio_src(&jpeg, file);
+    jpeg_read_header(&jpeg, TRUE);
+    jpeg.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&jpeg);
+
+    image.width = jpeg.output_width;
+    image.height = jpeg.output_height;
+    image.pixels.resize((size_t)image.width * image.height);
+
+    //Freed along with the decompressor, nothing that needs a destructor may live past the setjmp
+    JSAMPARRAY row = (*jpeg.mem->alloc_sarray)((j_common_ptr)&jpeg, JPOOL_IMAGE, image.width * 3, 1);
+    while (jpeg.output_scanline < jpeg.output_height)
+    {
+        uint32_t* pixel = image.pixels.data() + (size_t)jpeg.output_scanline * image.width;
+        jpeg_read_scanlines(&jpeg, row, 1);
+
+        for (const JSAMPLE* rgb = row[0]; rgb != row[0] + image.width * 3; rgb += 3)
+            *pixel++ = 0xFF000000 | (uint32_t)rgb[0] << 16 | (uint32_t)rgb[1] << 8 | rgb[2];
+    }
+
+    jpeg_finish_decompress(&jpeg);
+    jpeg_destroy_decompress(&jpeg);
+    fclose(file);
+    return true;
+}
+
+static bool load_imlib(const std::string& path, decoded_image& image)
+{
+    //Imlib2 is not thread safe, the event thread does not use it while it is idle
+    const std::lock_guard<std::mutex> lock(EventLoop::get_idle_mutex());
+
+    Imlib_Image loaded = imlib_load_image(path.c_str());
+    if (!loaded)
+        return false;
+
+    imlib_context_set_image(loaded);
+    image.width = imlib_image_get_width();
+    image.height = imlib_image_get_height();
+
+    const uint32_t* data = imlib_image_get_data_for_reading_only();
+    image.pixels.assign(data, data + (size_t)image.width * image.height);
+
+    //Imlib2 leaves the alpha channel alone for images without one
+    if (!imlib_image_has_alpha())
+        std::for_each(image.pixels.begin(), image.pixels.end(), [](uint32_t& pixel){ pixel |= 0xFF000000; });
+
+    imlib_free_image();
+    return true;
+}
+
+//Tent filter from source positions [start, start + length) to n pixels, one pixel wide when enlarging and as wide as a destination pixel when shrinking
+static filter_weights make_weights(double start, double length, uint32_t n, uint32_t source_size)
+{
+    filter_weights filter;
+    const double step = length / n;
+    const double radius = std::max(step, 1.0);
+    const int last_pixel = (int)source_size - 1;
+
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        const double center = start + (i + 0.5) * step - 0.5;
+        const int low = (int)std::floor(center - radius) + 1;
+        const int high = (int)std::ceil(center + radius) - 1;
+        const int first = std::clamp(low, 0, last_pixel);
+        const int count = std::clamp(high, 0, last_pixel) - first + 1;
+
+        const size_t offset = filter.weights.size();
+        filter.weights.resize(offset + count, 0.0f);
+
+        float total = 0.0f;
+        for (int j = low; j <= high; ++j)
+        {
+            const float weight = std::max(0.0, 1.0 - std::abs(j - center) / radius);
+            filter.weights[offset + std::clamp(j, 0, last_pixel) - first] += weight;
+            total += weight;
+        }
+
+        if (total > 0.0f)
+        {
+            for (int k = 0; k < count; ++k)
+                filter.weights[offset + k] /= total;
+        }
+
+        filter.first.push_back(first);
+        filter.count.push_back(count);
+        filter.offset.push_back(offset);
+        filter.max_count = std::max(filter.max_count, count);
+    }
+
+    return filter;
+}
+
+
+bool ImageDecoder::load_file(const std::string& path, decoded_image& image)
+{
+    unsigned char magic[4] = {};
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.read((char*)magic, sizeof(magic)))
+            return false;
+    }
+
+    if (magic[0] == 0x89 && magic[1] == 'P' && magic[2] == 'N' && magic[3] == 'G' && load_png(path, image))
+        return true;
+
+    if (magic[0] == 0xFF && magic[1] == 0xD8 && magic[2] == 0xFF && load_jpeg(path, image))
+        return true;
+
+    //Other formats, and the odd file libpng or libjpeg cannot read, like CMYK JPEGs
+    return load_imlib(path, image);
+}
+
+void ImageDecoder::scale(const decoded_image& image, double source_x, double source_y, double source_width, double source_height,
+    uint32_t width, uint32_t height, uint32_t* destination, size_t stride)
+{
+    if (image.width == 0 || image.height == 0 || width == 0 || height == 0)
+        return;
+
+    const filter_weights horizontal = make_weights(source_x, source_width, width, image.width);
+    const filter_weights vertical = make_weights(source_y, source_height, height, image.height);
+
+    //Source rows are scaled horizontally once and kept while the destination rows that use them are made.
+    //The rows a destination row uses only move forward, so a ring as large as the widest filter holds all of them.
+    const size_t ring_size = vertical.max_count;
+    std::vector<float> rows(ring_size * width * 4);
+    int next_row = 0;
+
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const int first_row = vertical.first[y];
+        const int end_row = first_row + vertical.count[y];
+
+        for (next_row = std::max(next_row, first_row); next_row < end_row; ++next_row)
+        {
+            const uint32_t* source = image.pixels.data() + (size_t)next_row * image.width;
+            float* row = rows.data() + (next_row % ring_size) * width * 4;
+
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                float sum[4] = {};
+                const float* weights = horizontal.weights.data() + horizontal.offset[x];
+                for (int k = 0; k < horizontal.count[x]; ++k)
+                {
+                    const uint32_t pixel = source[horizontal.first[x] + k];
+                    for (int channel = 0; channel < 4; ++channel)
+                        sum[channel] += weights[k] * (pixel >> (channel * 8) & 0xFF);
+                }
+
+                std::copy(sum, sum + 4, row + x * 4);
+            }
+        }
+
+        const float* weights = vertical.weights.data() + vertical.offset[y];
+        uint32_t* output = destination + y * stride;
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            float sum[4] = {};
+            for (int k = 0; k < vertical.count[y]; ++k)
+            {
+                const float* pixel = rows.data() + ((first_row + k) % ring_size) * width * 4 + x * 4;
+                for (int channel = 0; channel < 4; ++channel)
+                    sum[channel] += weights[k] * pixel[channel];
+            }
+
+            uint32_t result = 0;
+            for (int channel = 0; channel < 4; ++channel)
+                result |= (uint32_t)std::clamp(std::lround(sum[channel]), 0l, 255l) << (channel * 8);
+
+            output[x] = result;
+        }
+    }
+}
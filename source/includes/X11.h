@@ -6,9 +6,10 @@
 #include <X11/Xlib.h>
 #include <X11/extensions/Xrandr.h>
 
+#include <future>
 #include <span>
-
-class Image;
+#include <string>
+#include <vector>
 
 namespace X11
 {
@@ -18,11 +19,13 @@ extern struct Atoms
 	Atom supported;
 	Atom active_window;
 	Atom window_name;
+	Atom net_wm_name;
 	Atom window_class;
 	Atom wm_protocols;
 	Atom wm_delete_window;
 	Atom window_type;
 	Atom window_type_dock;
+	Atom window_type_normal;
     Atom window_icon;
     Atom window_icon_name;
 	Atom state;
@@ -105,6 +108,26 @@ struct RRMonitorInfo
     std::span<XRRMonitorInfo> monitors;
 };
 
+/**
+ * Everything needed to manage a new window. All requests are sent at once and the replies are collected
+ * together, so preparing a window costs one round trip instead of one per property.
+*/
+struct WindowPrefetch
+{
+    Window window = None;
+    WindowAttributes attributes = {};
+    Pos cursor_position = {0, 0};
+    std::vector<Atom> window_type;
+    //_NET_WM_NAME if set, otherwise WM_NAME
+    std::string name;
+    //The instance part of WM_CLASS
+    std::string window_class;
+    std::string icon_name;
+    //_NET_WM_ICON as sent by the client: width, height and width * height ARGB pixels, repeated for each size.
+    //Kept as the longs Xlib hands out, only the icons that are used get packed to 32 bits.
+    std::vector<unsigned long> icon_data;
+};
+
 extern const RRMonitorInfo get_monitors();
 
 extern const std::string get_atom_name(Atom name);
@@ -112,6 +135,23 @@ extern const std::string get_atom_name(Atom name);
 extern void set_display(Display* display);
 extern Display* get_display();
 extern Window get_root_window();
+//Sends every buffered request without waiting for anything
+extern void flush();
+
+/**
+ * Requests that need a reply have an async variant. The request is sent when it is called and the reply
+ * is only waited for when the future is read, so many requests can be issued before waiting once.
+ * The synchronous functions below are the async variant followed by get().
+ *
+ * Which library implements them is chosen at build time (ESHYWM_XCB_BACKEND). The Xlib backend has the
+ * same interface but blocks when the future is read instead of pipelining.
+*/
+extern std::future<std::string> get_atom_name_async(Atom name);
+extern std::future<Pos> get_cursor_position_async();
+extern std::future<WindowAttributes> get_window_attributes_async(Window window);
+extern std::future<WindowProperty> get_window_property_async(Window window, Atom property, long max_length = 1024);
+extern std::future<std::string> get_window_name_async(Window window);
+extern std::future<WindowTree> query_window_tree_async(Window window);
 
 extern const bool grab_server();
 extern const bool ungrab_server();
@@ -127,6 +167,7 @@ extern void ungrab_button(int button, unsigned int main_modifier, Window window)
 
 extern const WindowAttributes get_window_attributes(Window window);
 extern const WindowProperty get_window_property(Window window, Atom property);
+extern const std::string get_window_name(Window window);
 extern const bool change_window_property(Window window, Atom property, Atom type, const int size, const unsigned char* new_property);
 
 extern const WindowTree query_window_tree(Window window);
@@ -148,6 +189,12 @@ extern const bool move_window(Window window, const Pos& pos);
 extern const bool move_window(Window window, const Rect& pos);
 extern const bool resize_window(Window window, const Size& size);
 extern const bool resize_window(Window window, const Rect& size);
-
-extern Image* retrieve_window_icon(Window window);
+extern const bool move_resize_window(Window window, const Rect& geometry);
+
+//With b_only_viewable, names and icons are fetched in a second round trip and only for the viewable windows
+//that are not override redirect. Without it everything is fetched for every window in one round trip.
+extern const std::vector<WindowPrefetch> prefetch_windows(std::span<const Window> windows, bool b_only_viewable);
+extern const WindowPrefetch prefetch_window(Window window);
+//Only WM_CLASS, WM_ICON_NAME and _NET_WM_ICON, for when the icon changes
+extern const WindowPrefetch prefetch_window_icon(Window window);
 };
\ No newline at end of file
@@ -1,9 +1,22 @@
-
 #pragma once
 
 #include <string>
 
+/**
+ * The wallpaper is a single root pixmap covering every RandR monitor. Each monitor gets the image scaled with
+ * its own mode: fill (cover the monitor, cropping the overflow), fit (letterboxed inside the monitor) or span
+ * (monitors in span mode share one image covering all of them).
+ *
+ * Decoding and scaling happen on a worker thread. The scaled part for each monitor is cached on disk, keyed by
+ * the source file, its modification time and the target geometry, so an output change that was seen before
+ * only reads the cache and puts the result on one pixmap.
+*/
 namespace EshyBg
 {
-void set_background(const std::string& file_path);
-}
\ No newline at end of file
+    void set_background(const std::string& file_path);
+
+    //Renders the current wallpaper again for the monitors as they are now
+    void update_outputs();
+
+    void shutdown();
+}
@@ -42,6 +42,7 @@ public:
     const bool check_hovered(int cursor_x, int cursor_y) const;
     void set_button_state(EButtonState new_button_state) {button_state = new_button_state; on_update_state();}
     const EButtonState& get_button_state() const {return button_state;}
+    void set_button_color(const button_color_data& new_button_color) {button_color = new_button_color; on_update_state();}
     const Rect get_button_geometry() const {return button_geometry;}
     button_clicked_data& get_data() {return data;}
 
@@ -103,6 +104,7 @@ public:
     
     virtual void draw() override;
     void set_image(const Imlib_Image& new_image);
+    void set_image(const char* image_path);
 
 protected:
 
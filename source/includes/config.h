@@ -1,5 +1,9 @@
 #pragma once
 
+#include <X11/X.h>
+
+#include <cstdint>
+#include <functional>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -37,28 +41,112 @@ namespace EshyWMConfig
     extern ulong switcher_button_color;
     extern ulong switcher_button_border_color;
     extern ulong switcher_color;
+    extern bool switcher_thumbnails;
+    extern ulong switcher_thumbnail_refresh_interval;
 
     /**General double click time*/
     extern ulong double_click_time;
 
     /**Background image path*/
     extern std::string background_path;
+    //fill, fit or span
+    extern std::string background_mode;
+    //Comma separated output=mode list overriding background_mode for single outputs
+    extern std::string background_output_modes;
     extern std::string default_application_image_path;
 
     extern std::vector<std::string> startup_commands;
+
+    /**Launched commands*/
+    //Empty for $HOME
+    extern std::string launcher_working_directory;
+    //NAME=value entries added to the environment of launched commands
+    extern std::vector<std::string> launcher_environment;
+    extern bool launcher_setsid;
+
+    /**Tiling*/
+    //floating, master_stack, bsp or monocle, the layout every workspace starts with
+    extern std::string tiling_layout;
+    //Space between tiles and around the workspace edge
+    extern uint tiling_gap;
+    //Share of the width the master window gets in master_stack
+    extern float tiling_master_ratio;
+
+    /**Status providers*/
+    //strftime format
+    extern std::string status_clock_format;
+    //Empty for every interface but loopback
+    extern std::string status_network_interface;
+    //name interval_seconds command, the provider shows the last line the command prints
+    extern std::vector<std::string> status_scripts;
+
+    /**Status bar*/
+    extern bool status_bar;
+    //top or bottom
+    extern std::string status_bar_position;
+    extern uint status_bar_height;
+    extern ulong status_bar_color;
+    extern ulong status_bar_text_color;
+    extern ulong status_bar_highlight_color;
+    //Space separated provider names shown on the right, from left to right
+    extern std::string status_bar_providers;
+
     extern std::unordered_map<std::string, std::string> window_close_data;
 
+    //keybind_key is a keysym name with optional modifiers, like Super+Shift+Return. A key on its own is bound with Super
     struct KeyBinding
     {
-        int key;
+        KeySym key_sym = NoSymbol;
+        uint modifiers = 0;
         std::string command;
+
+        bool operator==(const KeyBinding&) const = default;
     };
 
     extern std::vector<KeyBinding> key_bindings;
 
+    //What has to be updated for the options that changed on a reload
+    enum EConfigChange : uint32_t
+    {
+        CC_NONE = 0,
+        CC_Border = 1 << 0,
+        //Titlebar and button colors, sizes and images, applied to every frame without reframing it
+        CC_Titlebar = 1 << 1,
+        //Cached icons were scaled or flattened with the old values
+        CC_Icons = 1 << 2,
+        CC_Switcher = 1 << 3,
+        CC_Background = 1 << 4,
+        //The bars and the status providers are created again
+        CC_StatusBar = 1 << 5,
+        //Tiled windows are laid out again
+        CC_Tiling = 1 << 6,
+        //Every workspace switches to the configured layout
+        CC_Layout = 1 << 7
+    };
+
+    struct ConfigChanges
+    {
+        uint32_t changed = CC_NONE;
+        std::vector<KeyBinding> removed_key_bindings;
+        std::vector<KeyBinding> added_key_bindings;
+    };
+
+    typedef std::function<void(const ConfigChanges&)> ConfigReloaded;
+
     void update_config();
+
+    /**
+     * Watches the config file and parses it again on a worker thread whenever it is written.
+     * The changed values are set on the event thread, then config_reloaded is called with what changed.
+     * Options that are only read once, like switcher_thumbnails, apply to what is created afterwards. Key names are resolved on the event thread.
+    */
+    void watch_config(ConfigReloaded config_reloaded);
+    void stop_watching_config();
+    //Loads window_close_data and starts the thread that writes changes to it
     void update_data();
-    void update_data_file();
+    //Writes the changes that are still queued and stops the writer thread
+    void flush_data();
 
-    void add_window_close_state(std::string window, std::string new_state);
+    //Queues the change for the writer thread, nothing is written if the state is the same as before
+    void add_window_close_state(const std::string& window, const std::string& new_state);
 };
\ No newline at end of file
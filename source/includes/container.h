@@ -2,6 +2,7 @@
 #pragma once
 
 #include "util.h"
+#include "tiling_layout.h"
 
 #include <X11/Xlib.h>
 
@@ -32,6 +33,19 @@ struct Workspace
     bool b_is_active = false;
     //Space left after docks have been accounted for
     Rect geometry;
+    //nullptr while the windows float
+    std::shared_ptr<TilingLayout> layout = nullptr;
+
+    //Carries the tiled windows over to the new layout, or tiles every normal window of the workspace
+    void set_layout(ELayoutType layout_type);
+    ELayoutType get_layout_type() const {return layout ? layout->get_type() : LT_Floating;}
+
+    //Does nothing while the workspace floats. The window is placed after next_to
+    void add_tiled_window(std::shared_ptr<class EshyWMWindow> window, const class EshyWMWindow* next_to);
+    //The other windows are laid out again and window floats where it is. Does nothing if window is not tiled here
+    void remove_tiled_window(class EshyWMWindow* window);
+    //Called when geometry changed
+    void update_layout();
 };
 
 struct Output
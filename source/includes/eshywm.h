@@ -4,21 +4,30 @@
 #include "window_manager.h"
 
 #include <memory>
+#include <vector>
 
 #define SWITCHER              EshyWM::switcher
 
 class EshyWMSwitcher;
+class EshyWMStatusBar;
 
 namespace EshyWM
 {
     bool initialize();
     void on_screen_resolution_changed(uint new_width, uint new_height);
+    void on_config_reloaded(const EshyWMConfig::ConfigChanges& changes);
 
     void window_created_notify(std::shared_ptr<EshyWMWindow> window);
     void window_destroyed_notify(std::shared_ptr<EshyWMWindow> window);
+    void window_icon_changed_notify(std::shared_ptr<EshyWMWindow> window);
+    void window_title_changed_notify(std::shared_ptr<EshyWMWindow> window);
+    void focus_changed_notify();
+    void workspace_changed_notify();
 
     extern std::shared_ptr<WindowManager> window_manager;
     extern std::shared_ptr<EshyWMSwitcher> switcher;
+    //One per output while status_bar is on
+    extern std::vector<std::shared_ptr<EshyWMStatusBar>> status_bars;
 
     extern bool b_terminate;
 };
\ No newline at end of file
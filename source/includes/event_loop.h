@@ -0,0 +1,54 @@
+#pragma once
+
+#include <signal.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+/**
+ * The event loop is a single threaded reactor built on epoll.
+ * Everything the window manager waits on is registered here: the X connection, timers (one timerfd
+ * shared by every timer), signals (one signalfd) and any file descriptor owned by a subsystem.
+ *
+ * dispatch() blocks until at least one of those is ready, so when nothing happens the window manager
+ * does not wake up at all. Subsystems that need to wait on something should register it here instead
+ * of spinning up their own polling thread.
+*/
+namespace EventLoop
+{
+    typedef uint64_t TimerHandle;
+
+    //Must be called before any thread is created so every thread inherits the blocked signal mask
+    bool initialize();
+    void shutdown();
+
+    //Blocks until at least one source is ready and runs the callbacks of every ready source
+    void dispatch();
+
+    bool add_fd(int fd, uint32_t events, std::function<void(uint32_t)> callback);
+    bool modify_fd(int fd, uint32_t events);
+    void remove_fd(int fd);
+
+    //Runs callback once after delay, then every interval if interval is not zero
+    TimerHandle add_timer(std::chrono::milliseconds delay, std::chrono::milliseconds interval, std::function<void()> callback);
+    void remove_timer(TimerHandle handle);
+
+    bool add_signal_handler(int signal_number, std::function<void()> callback);
+
+    //Can be called from any thread. Runs callback on the event thread during the next dispatch()
+    void post(std::function<void()> callback);
+
+    /**
+     * Held by the event thread at all times except while dispatch() is waiting. A worker thread that has to use
+     * something that is not thread safe (Imlib2) locks it, so that work only runs while the event thread is idle.
+    */
+    std::mutex& get_idle_mutex();
+
+    /**
+     * Signals handled through the signalfd are blocked in every thread, and a blocked mask is inherited by
+     * child processes. Children have to be started with this mask, the one the process originally had.
+    */
+    const sigset_t& get_default_signal_mask();
+};
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+/**
+ * Open addressing hash map with linear probing and backward shift deletion.
+ * All entries live in one contiguous array, so a lookup is usually a single cache line and there are
+ * no tombstones to skip over no matter how many windows have come and gone.
+ *
+ * The capacity is always a power of two and the table is kept at most half full. Keys are mixed with
+ * Fibonacci hashing since XIDs and keycodes are close to sequential and would otherwise cluster.
+*/
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class FlatHashMap
+{
+public:
+
+    FlatHashMap() : slots(16), n_entries(0), shift(64 - 4) {}
+
+    Value* find(const Key& key)
+    {
+        for(size_t i = home_slot(key);; i = next_slot(i))
+        {
+            if(!slots[i].b_occupied)
+                return nullptr;
+
+            if(slots[i].key == key)
+                return &slots[i].value;
+        }
+    }
+
+    const Value* find(const Key& key) const
+    {
+        return const_cast<FlatHashMap*>(this)->find(key);
+    }
+
+    void insert_or_assign(const Key& key, Value value)
+    {
+        if((n_entries + 1) * 2 > slots.size())
+            grow();
+
+        size_t i = home_slot(key);
+        for(; slots[i].b_occupied; i = next_slot(i))
+        {
+            if(slots[i].key == key)
+            {
+                slots[i].value = std::move(value);
+                return;
+            }
+        }
+
+        slots[i] = {key, std::move(value), true};
+        n_entries++;
+    }
+
+    bool erase(const Key& key)
+    {
+        size_t i = home_slot(key);
+        for(;; i = next_slot(i))
+        {
+            if(!slots[i].b_occupied)
+                return false;
+
+            if(slots[i].key == key)
+                break;
+        }
+
+        //Shift following entries back into the hole as long as that does not move them before their home slot
+        for(size_t j = next_slot(i);; j = next_slot(j))
+        {
+            if(!slots[j].b_occupied)
+                break;
+
+            const size_t home = home_slot(slots[j].key);
+            const bool b_can_move = i <= j ? (home <= i || home > j) : (home <= i && home > j);
+            if(!b_can_move)
+                continue;
+
+            slots[i] = std::move(slots[j]);
+            i = j;
+        }
+
+        slots[i] = Slot();
+        n_entries--;
+        return true;
+    }
+
+    void clear()
+    {
+        for(Slot& slot : slots)
+            slot = Slot();
+
+        n_entries = 0;
+    }
+
+    template <typename Function>
+    void for_each(Function function) const
+    {
+        for(const Slot& slot : slots)
+        {
+            if(slot.b_occupied)
+                function(slot.key, slot.value);
+        }
+    }
+
+    size_t size() const {return n_entries;}
+    bool empty() const {return n_entries == 0;}
+
+private:
+
+    struct Slot
+    {
+        Key key = Key();
+        Value value = Value();
+        bool b_occupied = false;
+    };
+
+    std::vector<Slot> slots;
+    size_t n_entries;
+    int shift;
+
+    size_t home_slot(const Key& key) const
+    {
+        return (size_t)(((uint64_t)Hash()(key) * 11400714819323198485ull) >> shift);
+    }
+
+    size_t next_slot(size_t i) const
+    {
+        return (i + 1) & (slots.size() - 1);
+    }
+
+    void grow()
+    {
+        std::vector<Slot> old_slots(slots.size() * 2);
+        std::swap(slots, old_slots);
+        shift--;
+        n_entries = 0;
+
+        for(Slot& slot : old_slots)
+        {
+            if(slot.b_occupied)
+                insert_or_assign(slot.key, std::move(slot.value));
+        }
+    }
+};
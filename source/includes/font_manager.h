@@ -0,0 +1,29 @@
+#pragma once
+
+#include "flat_hash_map.h"
+
+#include <Imlib2.h>
+
+#include <string>
+
+struct CachedFont
+{
+    Imlib_Font font = nullptr;
+    //Horizontal advance of every codepoint measured so far
+    FlatHashMap<uint32_t, int> advances;
+};
+
+/**
+ * Process wide font cache. Every face and size is loaded once and shared by all windows, and glyph advances
+ * are remembered so text can be measured (and cut down to fit) without rasterizing it.
+*/
+namespace FontManager
+{
+    //Returns nullptr if the font could not be loaded
+    CachedFont* get_font(const std::string& face, int size);
+
+    int measure_text(CachedFont* font, const std::string& text);
+
+    //Returns text, or as much of it as fits in max_width followed by "..."
+    std::string ellipsize_text(CachedFont* font, const std::string& text, int max_width);
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Fuzzy matching of a query against a list of candidates, used to filter the switcher while typing.
+ * A candidate matches if every character of the query appears in it in order, ignoring ASCII case.
+ *
+ * Matches are kept for every prefix of the query along with where each match ended. Typing one more character
+ * only continues the candidates that matched the shorter query from where they left off, and deleting one
+ * goes back to the list that was already there.
+ *
+ * Every candidate has a bitmask of the characters in it, so most candidates are rejected without looking at
+ * the text. The first character scans the masks of every candidate, which is done with SSE2 on x86-64.
+*/
+class FuzzyMatcher
+{
+public:
+
+    void set_candidates(const std::vector<std::string>& new_candidates);
+
+    //Returns the indices of the matching candidates, best match first. Equal matches keep the candidate order
+    const std::vector<uint32_t>& set_query(const std::string& new_query);
+
+    const std::string& get_query() const {return query;}
+
+private:
+
+    struct partial_match
+    {
+        uint32_t candidate;
+        //One past the character that matched the last query character
+        uint32_t end;
+    };
+
+    std::vector<std::string> candidates;
+    std::vector<uint64_t> character_masks;
+
+    std::string query;
+    //matches[n] are the candidates matching the first n + 1 characters of query, in candidate order
+    std::vector<std::vector<partial_match>> matches;
+    std::vector<uint32_t> results;
+
+    void match_all(char c, std::vector<partial_match>& out) const;
+    void match_next(const std::vector<partial_match>& previous, char c, std::vector<partial_match>& out) const;
+    void rank_results();
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "X11.h"
+#include "image.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+
+//One decoded icon, shared by every window of the same class
+struct CachedIcon
+{
+    //Scaled to fit the titlebar
+    Image titlebar;
+    //Scaled to switcher_button_height, keeping the aspect ratio
+    Image switcher;
+};
+
+/**
+ * Window icons keyed by WM_CLASS. The best fitting size is taken from _NET_WM_ICON (or the icon theme) and
+ * scaled once for every place it is drawn, so instances of the same application share one decoded icon.
+ *
+ * _NET_WM_ICON is already in memory and is decoded right away. Icons that have to be looked up on disk are
+ * loaded on a worker thread, the window gets the default application image until the real one is posted back.
+*/
+namespace IconCache
+{
+    typedef std::function<void(std::shared_ptr<CachedIcon>)> IconLoaded;
+
+    void initialize();
+    void shutdown();
+
+    //Drops every icon so they are scaled again, for when the sizes or colors they were made with change.
+    //Windows keep the icon they have until they ask for it again.
+    void clear();
+
+    //Never returns nullptr. If the icon is loaded in the background, icon_loaded is called on the event thread once it is ready.
+    std::shared_ptr<CachedIcon> get_icon(const X11::WindowPrefetch& prefetch, IconLoaded icon_loaded);
+
+    //Decodes _NET_WM_ICON again and replaces the cached icon, for when the property changes
+    std::shared_ptr<CachedIcon> reload_icon(const X11::WindowPrefetch& prefetch, IconLoaded icon_loaded);
+
+    uint get_titlebar_icon_size();
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/**
+ * Index of the installed desktop entries and icon themes, so finding an application's icon is a couple of hash
+ * probes instead of guessing file names.
+ *
+ * The index is a flat file in ~/.cache/eshywm that is memory mapped as is. It is reused across restarts as long as
+ * none of the indexed directories changed, otherwise it is rebuilt on a background thread. inotify keeps it current
+ * while the window manager runs.
+*/
+namespace IconIndex
+{
+    void initialize();
+    void shutdown();
+
+    /**
+     * Both can be called from any thread. Until the first index is available they block, so they should
+     * only be called from worker threads.
+    */
+
+    //Returns the Icon= entry of the desktop entry whose StartupWMClass or desktop ID is window_class
+    std::string find_desktop_icon(const std::string& window_class);
+
+    //Returns the file of the named icon that fits size best. Absolute paths are returned as they are.
+    std::string find_icon_file(const std::string& icon, uint32_t size);
+};
@@ -17,6 +17,6 @@ public:
     void draw(Drawable drawable, int x, int y);
     void draw(Drawable drawable, int x, int y, int width, int height);
 
-    Imlib_Image image;
-    bool b_this_owns_image;
+    Imlib_Image image = nullptr;
+    bool b_this_owns_image = false;
 };
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//Straight alpha ARGB pixels, the layout Imlib2 uses
+struct decoded_image
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint32_t> pixels;
+};
+
+/**
+ * Decoding and scaling for worker threads, so they do not have to take the idle mutex to use Imlib2.
+ * PNG and JPEG are decoded with libpng and libjpeg, which keep no global state. Anything else still goes
+ * through Imlib2, with the idle mutex held only while the file is decoded.
+ *
+ * These are not for the event thread, it holds the idle mutex and can use Imlib2 directly.
+*/
+namespace ImageDecoder
+{
+    bool load_file(const std::string& path, decoded_image& image);
+
+    /**
+     * Scales the source_width x source_height region at source_x, source_y of image to width x height pixels,
+     * written to destination with rows stride pixels apart. Samples outside the image repeat its edge.
+     * The filter interpolates when enlarging and averages every covered pixel when shrinking.
+    */
+    void scale(const decoded_image& image, double source_x, double source_y, double source_width, double source_height,
+        uint32_t width, uint32_t height, uint32_t* destination, size_t stride);
+};
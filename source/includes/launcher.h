@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+
+/**
+ * Starts commands for key bindings and startup_command without waiting for them.
+ *
+ * Commands without shell syntax are split on whitespace and started directly with posix_spawnp, anything
+ * else goes through /bin/sh -c. glibc's posix_spawn shares the address space with the child until it execs,
+ * so the cost of starting a program does not grow with the size of the window manager.
+ *
+ * Children start with the signal mask the window manager had before the event loop blocked its signals, in
+ * their own session, in launcher_working_directory and with launcher_environment added to the environment.
+*/
+namespace Launcher
+{
+    //Returns false if the command could not be started. If output_fd is set, it becomes the command's stdout
+    bool spawn(const std::string& command, int output_fd = -1);
+
+    //Reaps every child that exited, the event loop calls this on SIGCHLD
+    void reap_children();
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Conversion of icon pixels into what the icon cache stores.
+ * Imlib2 works with straight alpha, so instead of premultiplied pixels that it would blend on every draw, the
+ * premultiplied pixel is composited over the opaque background the icon is drawn on. The result is opaque and
+ * can be drawn with blending off.
+ *
+ * AVX2 is picked at runtime when the CPU has it, SSE2 is the baseline on x86-64 and other targets use scalar code.
+*/
+namespace PixelConvert
+{
+    //CARDINAL arrays like _NET_WM_ICON are handed out as longs, only the low 32 bits are the ARGB pixel
+    void flatten_argb(const unsigned long* source, uint32_t* destination, size_t n_pixels, uint32_t background);
+
+    void flatten_argb(const uint32_t* source, uint32_t* destination, size_t n_pixels, uint32_t background);
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "X11.h"
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include <string>
+#include <vector>
+
+//Parts of the window manager that have to be told when a cached property changes
+enum EPropertyConsumer : uint8_t
+{
+    PC_NONE = 0,
+    PC_Titlebar = 1 << 0,
+    PC_Icon = 1 << 1,
+    PC_Dock = 1 << 2
+};
+
+/**
+ * Caches the properties of a client the window manager cares about.
+ * Every value is fetched the first time it is asked for and kept until the atom it was read from changes,
+ * so a PropertyNotify for an unrelated atom costs nothing and a related one costs one round trip.
+ *
+ * The icon itself is kept by the window since it has to be decoded, the cache only says when it is stale.
+*/
+class WindowPropertyCache
+{
+public:
+
+    WindowPropertyCache(Window _window) : window(_window) {}
+
+    //Fills the cache with values that were already fetched
+    void seed(const X11::WindowPrefetch& prefetch);
+
+    //Drops the value read from atom and returns the consumers that have to be updated (EPropertyConsumer flags)
+    uint8_t invalidate(Atom atom);
+
+    //_NET_WM_NAME if set, otherwise WM_NAME
+    const std::string& get_name();
+    //The instance part of WM_CLASS
+    const std::string& get_class();
+    const std::vector<Atom>& get_window_type();
+    const bool is_dock();
+    const XSizeHints& get_normal_hints();
+    const XWMHints& get_wm_hints();
+
+private:
+
+    template <typename T>
+    struct cached_property
+    {
+        T value = T();
+        bool b_valid = false;
+    };
+
+    Window window;
+
+    cached_property<std::string> name;
+    cached_property<std::string> window_class;
+    cached_property<std::vector<Atom>> window_type;
+    cached_property<XSizeHints> normal_hints;
+    cached_property<XWMHints> wm_hints;
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "menu_base.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * The built in bar, one per output, registered as the output's top or bottom dock like any external bar.
+ * Workspaces are on the left, the focused title in the middle and one segment per status provider on the right.
+ *
+ * Every segment keeps what it last drew. Updates only mark the segments whose content or position changed, and only
+ * those are rendered again into the back buffer pixmap, which is the window background so the server repaints the rest.
+*/
+class EshyWMStatusBar : public EshyWMMenuBase
+{
+public:
+
+    EshyWMStatusBar(std::shared_ptr<struct Output> _output);
+    ~EshyWMStatusBar();
+
+    virtual void show() override;
+    virtual void remove() override;
+    virtual void draw() override;
+
+    void update_workspaces();
+    void update_title();
+    //Takes the latest snapshot of every shown provider
+    void update_status();
+
+    //x and y are relative to the bar
+    void button_clicked(int x, int y);
+
+    std::shared_ptr<struct Output> get_output() const {return output;}
+
+private:
+
+    struct bar_segment
+    {
+        std::string text;
+        float level = -1.0f;
+        bool b_highlighted = false;
+        bool b_dimmed = false;
+
+        int x = 0;
+        uint width = 0;
+        bool b_damaged = true;
+    };
+
+    std::shared_ptr<struct Output> output;
+    std::shared_ptr<struct Dock> dock;
+
+    std::vector<bar_segment> workspace_segments;
+    bar_segment title_segment;
+    //The focused title before it was cut down to fit title_segment
+    std::string full_title;
+    std::vector<bar_segment> status_segments;
+    std::vector<std::shared_ptr<class StatusProvider>> providers;
+
+    Pixmap back_buffer;
+    struct CachedFont* font;
+    int text_y;
+
+    //Marks the segment damaged if anything it shows changed
+    static void set_segment(bar_segment& segment, const std::string& text, float level, bool b_highlighted, bool b_dimmed);
+    static void set_segment_position(bar_segment& segment, int x, uint width);
+
+    //Places the status segments from the right edge and gives the title what is left
+    void layout_segments();
+    void draw_segment(bar_segment& segment);
+    void draw_damaged();
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+//What a provider shows at one point in time. A new one is published for every change, published ones never change
+struct StatusSnapshot
+{
+    std::string text;
+    //0 to 1 for providers with a level like battery charge or CPU load, negative otherwise
+    float level = -1.0f;
+
+    bool operator==(const StatusSnapshot&) const = default;
+};
+
+/**
+ * A source of status information, like the battery, the clock or the output of a script.
+ * refresh() is called on the event thread every interval and publishes a new snapshot if anything changed.
+ * Readers on any thread get the latest snapshot through an atomic pointer swap, so they never see one half written.
+*/
+class StatusProvider
+{
+public:
+
+    StatusProvider(std::string _name, std::chrono::milliseconds _interval);
+    virtual ~StatusProvider() = default;
+
+    virtual void refresh() = 0;
+
+    const std::string& get_name() const {return name;}
+    std::chrono::milliseconds get_interval() const {return interval;}
+    std::shared_ptr<const StatusSnapshot> get_snapshot() const {return snapshot.load();}
+
+protected:
+
+    //Does nothing if new_snapshot is the same as the current one
+    void publish(StatusSnapshot new_snapshot);
+
+private:
+
+    std::string name;
+    std::chrono::milliseconds interval;
+    std::atomic<std::shared_ptr<const StatusSnapshot>> snapshot;
+};
+
+/**
+ * Every provider is driven by one timer wheel on the event loop, with one event loop timer for the next tick any
+ * provider is due on. Intervals are aligned to multiples of themselves, so providers with intervals of 1, 2 and 4
+ * seconds all refresh on the same wakeup instead of three separate ones.
+*/
+namespace StatusProviders
+{
+    typedef std::function<void()> SnapshotsChanged;
+
+    //Adds the battery, clock, cpu, memory and network providers and one for each status_script.
+    //snapshots_changed is called once for all the snapshots published during one event loop dispatch.
+    void initialize(SnapshotsChanged snapshots_changed);
+    void shutdown();
+
+    void add_provider(std::shared_ptr<StatusProvider> provider);
+    std::shared_ptr<StatusProvider> find_provider(std::string_view name);
+};
@@ -1,36 +1,89 @@
-
 #pragma once
 
 #include "util.h"
 #include "menu_base.h"
+#include "switcher_layout.h"
+#include "fuzzy_matcher.h"
 
 #include <Imlib2.h>
 #include <memory>
 #include <vector>
 
+struct switcher_option
+{
+    std::shared_ptr<class EshyWMWindow> window;
+    std::shared_ptr<struct CachedIcon> icon;
+};
+
+/**
+ * The switcher is a single window. Every option is drawn into one back buffer pixmap that is set as the window
+ * background, so the server repaints it on its own. The buffer is only rendered again when the options change,
+ * moving the selection redraws the two cells involved.
+ *
+ * With switcher_thumbnails on, an option shows a live thumbnail of its window instead of the icon once one exists.
+ *
+ * Typing while the switcher is open fuzzy matches the query against the class and title of every window, and
+ * only the matching options are laid out, best match first. Cells of the layout are then mapped to options.
+*/
 class EshyWMSwitcher : public EshyWMMenuBase
 {
 public:
 
     EshyWMSwitcher(Rect _menu_geometry, Color _menu_color);
     virtual void show() override;
-    virtual void raise(bool b_set_focus = false) override;
-    void update_button_positions();
+    virtual void draw() override;
     void update_switcher_window_options();
-    void button_clicked(int x_root, int y_root);
+    void button_clicked(int x, int y);
 
-    void add_window_option(std::shared_ptr<class EshyWMWindow> associated_window, class Image* icon);
+    void add_window_option(std::shared_ptr<class EshyWMWindow> associated_window, std::shared_ptr<struct CachedIcon> icon);
     void remove_window_option(std::shared_ptr<class EshyWMWindow> associated_window);
+    void update_window_option_icon(std::shared_ptr<class EshyWMWindow> associated_window, std::shared_ptr<struct CachedIcon> icon);
+    void update_window_option_thumbnail(Window frame);
     void next_option();
     void confirm_choice();
 
-    const std::vector<window_button_pair> get_switcher_window_options() const {return switcher_window_options;}
+    //Returns true if the key was used to filter the options
+    bool filter_key_pressed(const XKeyEvent& event);
+
+    //Takes the switcher settings again after the config was reloaded
+    void reload_config();
 
 private:
 
-    std::vector<window_button_pair> switcher_window_options;
+    std::vector<switcher_option> switcher_window_options;
+    SwitcherLayout layout;
+    //Index of a cell in the layout, not of an option
     int selected_option;
+    //Options that do not fit on the output are split into pages, only the page with the selection is shown
+    size_t displayed_page;
+
+    Pixmap back_buffer;
+    Size back_buffer_size;
+    bool b_needs_layout;
+
+    FuzzyMatcher matcher;
+    std::string filter_query;
+    bool b_filtering;
+    //Typing only filters while the switcher holds the keyboard
+    bool b_keyboard_grabbed;
+    //The option shown in each cell while filtering
+    std::vector<int> shown_options;
+
+    int option_at(int cell) const {return b_filtering ? shown_options[cell] : cell;}
+    //Returns -1 if option is filtered out
+    int cell_of(int option) const;
+    void set_filter(const std::string& query);
+    void update_filter_candidates();
+
+    void invalidate_layout();
+    void update_layout();
+    std::shared_ptr<struct Output> get_output() const;
+
+    //Called when the icon or thumbnail of option i changed
+    void update_option(int i);
+    void draw_option(int i);
+    void present_option(int i);
 
     void select_option(int i);
     void handle_option_chosen(const int i);
-};
\ No newline at end of file
+};
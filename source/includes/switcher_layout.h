@@ -0,0 +1,68 @@
+#pragma once
+
+#include "util.h"
+
+#include <vector>
+
+/**
+ * Positions of the switcher options. The options are kept as one long row of cumulative offsets that is updated
+ * in place when an option is added, removed, resized or moved to the front, so a cell is found without walking
+ * the options before it.
+ *
+ * The row is wrapped into rows that fit the bounds, and rows that do not fit vertically are split into pages.
+ * Row breaks are found with a binary search over the offsets and only recomputed when something changed.
+*/
+class SwitcherLayout
+{
+public:
+
+    SwitcherLayout();
+
+    void set_metrics(uint new_padding, uint new_cell_height);
+
+    //Returns true if the bounds changed
+    bool set_bounds(uint max_width, uint max_height);
+
+    void insert(size_t i, uint width);
+    void erase(size_t i);
+    void set_width(size_t i, uint width);
+    void move_to_front(size_t i);
+    void clear();
+
+    size_t size() const {return widths.size();}
+    uint get_width(size_t i) const {return widths[i];}
+
+    //Position of the cell inside the page it is on
+    Rect get_cell(size_t i) const;
+    size_t get_page(size_t i) const;
+    size_t get_page_count() const;
+
+    //First option and one past the last option on page
+    std::pair<size_t, size_t> get_page_range(size_t page) const;
+
+    //Every page has the same size so the switcher does not jump around when flipping pages
+    Size get_page_size() const;
+
+    //Returns the option at x, y on page or -1
+    int find_option(size_t page, int x, int y) const;
+
+private:
+
+    uint padding;
+    uint cell_height;
+    uint bounds_width;
+    uint bounds_height;
+
+    std::vector<uint> widths;
+    //offsets[i] is where option i starts if every option was in one row, offsets[size()] is the end of the row
+    std::vector<uint> offsets;
+
+    mutable std::vector<size_t> row_starts;
+    mutable uint widest_row;
+    mutable bool b_rows_dirty;
+
+    void shift_offsets(size_t first, long delta);
+    void update_rows() const;
+    size_t get_row(size_t i) const;
+    size_t get_rows_per_page() const;
+};
@@ -1,10 +1,12 @@
+#pragma once
 
-#include <chrono>
+#include <memory>
+#include <string>
 
 #define POWER_SUPPLY_STATUS_UNKNOWN_IDENTIFIER "Unknown"
 #define POWER_SUPPLY_STATUS_CHARGING_IDENTIFIER "Charging"
 #define POWER_SUPPLY_STATUS_DISCHARGING_IDENTIFIER "Discharging"
-#define POWER_SUPPLY_STATUS_NOT_CHARGING_IDENTIFIER "Not Charging"
+#define POWER_SUPPLY_STATUS_NOT_CHARGING_IDENTIFIER "Not charging"
 #define POWER_SUPPLY_STATUS_FULL_IDENTIFIER "Full"
 
 enum EPowerSupplyStatus
@@ -16,13 +18,30 @@ enum EPowerSupplyStatus
     POWER_SUPPLY_STATUS_FULL
 };
 
+//The power supply state at one point in time, never changed once it is published
+struct PowerSnapshot
+{
+    EPowerSupplyStatus status = POWER_SUPPLY_STATUS_UNKNOWN;
+    //-1 if there is no battery
+    int battery_percentage = -1;
+    bool b_on_ac = false;
+    std::string battery_name;
+};
+
+/**
+ * The System namespace is for managing pure system things like battery, time, etc.
+ *
+ * The first system battery and the first mains supply in /sys/class/power_supply are found at startup. Their
+ * attributes stay open and are read again with pread, which makes sysfs produce the current value.
+ * They are read when the kernel sends a power_supply uevent, supplies that come and go are found again then.
+ * Not every battery reports capacity changes, so the capacity is also read once a minute.
+*/
 namespace System
 {
-    void begin_polling();
-    void end_polling();
-    void poll_system_info();
+    //Registers with the event loop
+    void initialize();
+    void shutdown();
 
-    extern EPowerSupplyStatus power_supply_status;
-    extern int battery_percentage;
-    extern std::chrono::_V2::system_clock::time_point current_time;
-};
\ No newline at end of file
+    //Can be called from any thread
+    std::shared_ptr<const PowerSnapshot> get_power();
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "util.h"
+
+#include <X11/Xlib.h>
+
+#include <functional>
+
+//A scaled down copy of a frame, switcher_button_height tall and kept on the server
+struct Thumbnail
+{
+    Pixmap pixmap = None;
+    Size size = {0, 0};
+};
+
+/**
+ * Live window thumbnails for the switcher. Frames are redirected with XComposite so their contents stay in an
+ * offscreen pixmap, which is scaled down with XRender into a thumbnail pixmap of its own.
+ *
+ * XDamage only reports a frame once until the damage is subtracted, and it is only subtracted when the thumbnail
+ * is refreshed. While the switcher is hidden a frame that changes costs one event and nothing is rendered.
+ * While it is shown, damaged thumbnails are refreshed at most every switcher_thumbnail_refresh_interval.
+ * Frames that are not viewable (minimized or on a hidden workspace) keep their last thumbnail.
+*/
+namespace ThumbnailCache
+{
+    typedef std::function<void(Window)> ThumbnailChanged;
+
+    //Returns false if thumbnails are turned off or the server lacks Composite, Damage or Render
+    bool initialize(ThumbnailChanged thumbnail_changed);
+    void shutdown();
+    bool is_enabled();
+
+    //Has to be called while frame still exists
+    void add_window(Window frame);
+    void remove_window(Window frame);
+
+    //Returns true if event was a damage event
+    bool handle_event(const XEvent& event);
+
+    //Activating refreshes every damaged thumbnail right away, thumbnail_changed is called for each of them
+    void set_active(bool b_active);
+
+    //Returns nullptr if frame has no thumbnail yet
+    const Thumbnail* get_thumbnail(Window frame);
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "util.h"
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+enum ELayoutType : uint8_t
+{
+    LT_Floating,
+    LT_MasterStack,
+    LT_BSP,
+    LT_Monocle
+};
+
+struct window_tile
+{
+    std::shared_ptr<class EshyWMWindow> window;
+    Rect geometry;
+};
+
+/**
+ * Places the tiled windows of one workspace. Adding or removing a window only recomputes the part of the layout it
+ * affects, and only windows whose tile actually changed are queued. apply() then sends the whole batch of configure
+ * requests in one flush, so retiling many windows costs one round of redraws instead of one per window.
+*/
+class TilingLayout
+{
+public:
+
+    virtual ~TilingLayout() = default;
+
+    virtual ELayoutType get_type() const = 0;
+
+    //The new window is placed after next_to, or last if next_to is nullptr or not in the layout
+    virtual void add_window(std::shared_ptr<class EshyWMWindow> window, const class EshyWMWindow* next_to) = 0;
+    //Returns false if window is not in the layout
+    virtual bool remove_window(const class EshyWMWindow* window) = 0;
+    //In layout order, used to carry the windows over to another layout
+    virtual std::vector<std::shared_ptr<class EshyWMWindow>> get_windows() const = 0;
+
+    //Lays every window out again if the bounds changed
+    void set_bounds(const Rect& new_bounds);
+    //Lays every window out again, for changed gaps or ratios
+    void relayout();
+    //Sends every tile queued since the last call
+    void apply();
+
+protected:
+
+    Rect bounds = {0};
+
+    virtual void arrange_all() = 0;
+    //Queues the tile if the window is not already there
+    void set_tile(const std::shared_ptr<class EshyWMWindow>& window, const Rect& cell);
+
+private:
+
+    std::vector<window_tile> changed_tiles;
+};
+
+//The window side of the layouts, implemented in window.cpp so the layouts only hold placement logic
+Rect get_window_tile(const class EshyWMWindow* window);
+//Moves every window into its tile, the configure requests go out in one write
+void tile_windows(const std::vector<window_tile>& tiles);
+
+//Returns nullptr for LT_Floating
+std::shared_ptr<TilingLayout> create_tiling_layout(ELayoutType layout_type, const Rect& bounds);
+//floating, master_stack, bsp or monocle. Unknown names are floating
+ELayoutType parse_layout_type(std::string_view name);
+ELayoutType next_layout_type(ELayoutType layout_type);
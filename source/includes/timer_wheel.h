@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Hierarchical timer wheel for periodic timers, counted in ticks. Each level has 64 slots and every slot of
+ * a level spans all 64 slots of the level below it. A timer goes into the lowest level whose slot it can be
+ * told apart in, and moves down a level each time the wheel reaches its slot, so adding, removing and
+ * expiring a timer is constant time no matter how many there are.
+ *
+ * Timers are aligned to a multiple of their interval. Timers whose intervals divide each other expire on the
+ * same tick, so the wheel only has to be woken up once for all of them.
+*/
+class TimerWheel
+{
+public:
+
+    typedef uint64_t Handle;
+
+    //current_tick is the tick the wheel starts at, nothing expires before it
+    explicit TimerWheel(uint64_t current_tick);
+
+    //Runs callback on every tick that is a multiple of interval_ticks, starting with the first one after now
+    Handle add(uint64_t interval_ticks, std::function<void()> callback);
+    void remove(Handle handle);
+
+    //Runs every timer that expires up to and including tick
+    void advance(uint64_t tick);
+
+    //The tick the wheel has to be advanced to next, the real expiry or a tick where timers move down a level
+    std::optional<uint64_t> get_next_tick() const;
+
+    bool empty() const {return timers.empty();}
+
+private:
+
+    static constexpr uint SLOT_BITS = 6;
+    static constexpr uint SLOT_COUNT = 1 << SLOT_BITS;
+    static constexpr uint LEVEL_COUNT = 4;
+    //Timers further away than the wheel covers are parked in the last slot of the top level
+    static constexpr uint64_t MAX_DISTANCE = (1ull << (SLOT_BITS * LEVEL_COUNT)) - 1;
+
+    struct timer
+    {
+        uint64_t interval;
+        uint64_t expiry;
+        uint8_t level;
+        uint8_t slot;
+        std::function<void()> callback;
+    };
+
+    struct level
+    {
+        std::array<std::vector<Handle>, SLOT_COUNT> slots;
+        //Bit n is set if slot n holds any timer
+        uint64_t occupied = 0;
+    };
+
+    std::unordered_map<Handle, timer> timers;
+    std::array<level, LEVEL_COUNT> levels;
+    //The next tick to run, every tick before it has been run
+    uint64_t current_tick;
+    Handle next_handle;
+
+    void insert(Handle handle, timer& timer);
+    void unlink(Handle handle, const timer& timer);
+    void cascade(uint level_index);
+};
@@ -31,12 +31,12 @@
 	void __log_vector(LogSeverity severity, void* vector);
 
 	#define SET_GLOBAL_SEVERITY(severity)		__set_global_log_severity(severity);
-	#define LOG(severity, message, ...)			__log_message(severity, message);
-	#define LOGV(message, ...)					LOG(LogSeverity::LS_Verbose, message, ...)
-	#define LOGI(message, ...)					LOG(LogSeverity::LS_Info, message, ...)
-	#define LOGW(message, ...)					LOG(LogSeverity::LS_Warning, message, ...)
-	#define LOGE(message, ...)					LOG(LogSeverity::LS_Error, message, ...)
-	#define LOGF(message, ...)					LOG(LogSeverity::LS_Fatal, message, ...)
+	#define LOG(severity, message, ...)			__log_message(severity, message __VA_OPT__(,) __VA_ARGS__);
+	#define LOGV(message, ...)					LOG(LogSeverity::LS_Verbose, message __VA_OPT__(,) __VA_ARGS__)
+	#define LOGI(message, ...)					LOG(LogSeverity::LS_Info, message __VA_OPT__(,) __VA_ARGS__)
+	#define LOGW(message, ...)					LOG(LogSeverity::LS_Warning, message __VA_OPT__(,) __VA_ARGS__)
+	#define LOGE(message, ...)					LOG(LogSeverity::LS_Error, message __VA_OPT__(,) __VA_ARGS__)
+	#define LOGF(message, ...)					LOG(LogSeverity::LS_Fatal, message __VA_OPT__(,) __VA_ARGS__)
 	#define LOG_EVENT_INFO(severity, event)		__log_event_info(severity, event);
 	#define LOG_VECTOR(severity, vector)		std::cout << "(" << vector.x << ", " << vector.y << ")" << std::endl;
 #else
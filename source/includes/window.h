@@ -3,6 +3,7 @@
 #include "window_manager.h"
 #include "X11.h"
 #include "util.h"
+#include "property_cache.h"
 
 #include <Imlib2.h>
 #include <cairo/cairo.h>
@@ -16,6 +17,8 @@ enum EWindowState : uint16_t
     WS_MINIMIZED,
     WS_MAXIMIZED,
     WS_FULLSCREEN,
+    //Placed by the layout of its workspace
+    WS_TILED,
     WS_ANCHORED_LEFT,
     WS_ANCHORED_UP,
     WS_ANCHORED_RIGHT,
@@ -29,10 +32,10 @@ class EshyWMWindow
 {
 public:
 
-    EshyWMWindow(Window _window);
+    EshyWMWindow(const X11::WindowPrefetch& prefetch);
     ~EshyWMWindow();
 
-    void initialize(const X11::WindowAttributes& attributes);
+    void initialize(const X11::WindowPrefetch& prefetch);
 
     void frame_window();
     void unframe_window();
@@ -55,20 +58,37 @@ public:
     void move_window_absolute(int new_position_x, int new_position_y, bool b_skip_state_checks);
     void resize_window_absolute(uint new_size_x, uint new_size_y, bool b_skip_state_checks);
 
+    //Moves the frame into tile, border included. Nothing is flushed so a whole layout goes out at once.
+    //Maximized, fullscreen and minimized windows are placed when they are restored.
+    void tile_window(const Rect& tile);
+    //Called once the window left the layout of its workspace, it floats where it is
+    void untile_window();
+    //Only normal windows are tiled, dialogs, splash screens and the like float above them
+    bool is_tileable();
+
+    //Refetches the title, then redraws the titlebar if the title changed
+    void update_title();
     void update_titlebar();
+    void update_icon();
+    void set_icon(std::shared_ptr<struct CachedIcon> new_icon);
 
     void set_show_titlebar(bool b_new_show_titlebar);
     void set_show_border(bool b_show_border);
+    //Applies reloaded titlebar settings to the existing frame
+    void update_titlebar_layout();
 
     /**Getters*/
     inline const Window get_window() const {return window;}
     inline const Window get_frame() const {return frame;}
     inline const Window get_titlebar() const {return titlebar;}
     inline const Rect& get_frame_geometry() const {return frame_geometry;}
-    inline Image* get_window_icon() const {return window_icon;}
+    inline const Rect& get_tile_geometry() const {return tile_geometry;}
+    inline const std::string& get_title() const {return title;}
+    inline std::shared_ptr<struct CachedIcon> get_window_icon() const {return window_icon;}
     inline const EWindowState get_window_state() const {return window_state;}
+    inline WindowPropertyCache& get_properties() {return properties;}
 
-    inline class WindowButton* get_close_button() const {return close_button;}
+    inline class ImageButton* get_close_button() const {return close_button;}
 
     std::shared_ptr<class Workspace> parent_workspace;
 
@@ -80,14 +100,32 @@ private:
     Window frame;
     Window titlebar;
 
+    WindowPropertyCache properties;
+
     Rect frame_geometry;
     Rect pre_state_change_geometry;
+    //Where the layout last placed the window, empty while it floats
+    Rect tile_geometry;
     EWindowState previous_state;
 
     EWindowState window_state;
 
-    class Image* window_icon;
-    class WindowButton* close_button;
+    std::shared_ptr<struct CachedIcon> window_icon;
+    class ImageButton* close_button;
+
+    struct CachedFont* window_font;
+
+    std::string title;
+
+    //The rendered titlebar. It is only redrawn when one of the values it was rendered with changes,
+    //otherwise the titlebar is repainted by copying the pixmap.
+    struct titlebar_cache_data
+    {
+        Pixmap pixmap = None;
+        std::string title;
+        uint width = 0;
+    } titlebar_cache;
 
-    Imlib_Font window_font;
+    void render_titlebar(uint pixmap_width, const std::string& display_title);
+    void free_titlebar_cache();
 };
\ No newline at end of file
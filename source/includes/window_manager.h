@@ -4,9 +4,11 @@
 #include "util.h"
 #include "container.h"
 #include "config.h"
+#include "flat_hash_map.h"
 
 #include <Imlib2.h>
 
+#include <functional>
 #include <vector>
 
 /**
@@ -43,6 +45,33 @@
  * with some kind of settings menu. Perhaps a configuration retention feature will also be added so all
  * session changes will remain across startups.
 */
+
+//What an X window known to the window manager is to the EshyWMWindow it belongs to
+enum EWindowRole : uint8_t
+{
+    WR_NONE,
+    WR_Client,
+    WR_Frame,
+    WR_Titlebar,
+    WR_CloseButton
+};
+
+//A key the window manager grabs and what pressing it does
+struct key_action
+{
+    KeySym key_sym;
+    uint modifiers;
+    std::function<void()> callback;
+    //Acts on the focused window, the key press is passed on if there is none
+    bool b_window_action = false;
+};
+
+struct indexed_xwindow
+{
+    std::shared_ptr<EshyWMWindow> window;
+    EWindowRole role = WR_NONE;
+};
+
 class WindowManager
 {
 public:
@@ -66,6 +95,12 @@ public:
 
     void focus_window(std::shared_ptr<EshyWMWindow> window, bool b_raise);
 
+    //Ungrabs the keys of removed bindings and grabs the keys of added ones, every other grab is left alone
+    void update_key_bindings(const std::vector<EshyWMConfig::KeyBinding>& removed, const std::vector<EshyWMConfig::KeyBinding>& added);
+
+    //Returns the managed window whose client is window, or nullptr
+    std::shared_ptr<EshyWMWindow> contains_xwindow(Window window);
+
     std::vector<std::shared_ptr<Output>> outputs;
     std::vector<std::shared_ptr<Workspace>> workspaces;
     std::vector<std::shared_ptr<EshyWMWindow>> window_list;
@@ -91,8 +126,17 @@ private:
     class Button* currently_hovered_button;
     Rect manipulating_window_geometry;
 
+    //The built in actions followed by the configured key bindings, which win if both use the same keys
+    std::vector<key_action> key_actions;
+    //(keycode, modifiers) to the index in key_actions, made again whenever the keyboard mapping changes
+    FlatHashMap<uint32_t, uint32_t> key_action_table;
+    KeyCode switcher_confirm_keycode = 0;
+
+    void update_key_actions();
+    void build_key_action_table();
     void grab_keys();
     void ungrab_keys();
+    void grab_buttons();
 
     void OnDestroyNotify(const XDestroyWindowEvent& event);
     void OnMapNotify(const XMapEvent& event);
@@ -109,11 +153,18 @@ private:
     void OnKeyRelease(const XKeyEvent& event);
     void OnEnterNotify(const XCrossingEvent& event);
     void OnClientMessage(const XClientMessageEvent& event);
+    void OnMappingNotify(XMappingEvent& event);
 
-    std::shared_ptr<EshyWMWindow> register_window(Window window, bool b_was_created_before_window_manager);
+    std::shared_ptr<EshyWMWindow> register_window(const X11::WindowPrefetch& prefetch, bool b_was_created_before_window_manager);
     std::shared_ptr<Dock> register_dock(Window window, bool b_was_created_before_window_manager);
+    void unmanage_window(std::shared_ptr<EshyWMWindow> window);
 
     void handle_button_hovered(Window hovered_window, bool b_hovered, int mode);
 
-    std::shared_ptr<EshyWMWindow> contains_xwindow(Window window);
+    //Maps every XID owned or managed by the window manager to its window so event handlers never scan window_list
+    FlatHashMap<Window, indexed_xwindow> xwindow_index;
+
+    void index_window(std::shared_ptr<EshyWMWindow> window);
+    void unindex_window(std::shared_ptr<EshyWMWindow> window);
+    std::shared_ptr<EshyWMWindow> find_xwindow(Window xwindow, EWindowRole role) const;
 };
\ No newline at end of file
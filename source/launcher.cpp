@@ -0,0 +1,148 @@
+#include "launcher.h"
+#include "config.h"
+#include "event_loop.h"
+#include "util.h"
+
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+extern char** environ;
+
+//Commands of running children, kept to say which one failed
+static std::unordered_map<pid_t, std::string> children;
+
+//Quotes, variables, globs, redirections and the like need the shell
+static bool needs_shell(std::string_view command)
+{
+    return command.find_first_of("|&;<>()$`\\\"'*?[]{}#~=!\n") != std::string_view::npos;
+}
+
+static std::vector<std::string> split_arguments(std::string_view command)
+{
+    std::vector<std::string> arguments;
+
+    size_t start = 0;
+    while ((start = command.find_first_not_of(" \t", start)) != std::string_view::npos)
+    {
+        const size_t end = std::min(command.find_first_of(" \t", start), command.size());
+        arguments.emplace_back(command.substr(start, end - start));
+        start = end;
+    }
+
+    return arguments;
+}
+
+//The environment of the window manager with launcher_environment entries added or replaced
+static std::vector<std::string> build_environment()
+{
+    std::vector<std::string> environment;
+    for (char** variable = environ; *variable; ++variable)
+        environment.emplace_back(*variable);
+
+    for (const std::string& entry : EshyWMConfig::launcher_environment)
+    {
+        const size_t separator = entry.find('=');
+        if (separator == std::string::npos || separator == 0)
+            continue;
+
+        const std::string_view name(entry.data(), separator + 1);
+        std::erase_if(environment, [name](const std::string& variable){ return variable.starts_with(name); });
+        environment.push_back(entry);
+    }
+
+    return environment;
+}
+
+static std::string get_working_directory()
+{
+    const char* home = getenv("HOME");
+    const std::string& directory = EshyWMConfig::launcher_working_directory;
+
+    if (directory.empty())
+        return home ? home : "/";
+
+    if (directory.starts_with('~') && home)
+        return home + directory.substr(1);
+
+    return directory;
+}
+
+static std::vector<char*> to_pointers(std::vector<std::string>& strings)
+{
+    std::vector<char*> pointers;
+    pointers.reserve(strings.size() + 1);
+
+    for (std::string& string : strings)
+        pointers.push_back(string.data());
+
+    pointers.push_back(nullptr);
+    return pointers;
+}
+
+
+bool Launcher::spawn(const std::string& command, int output_fd)
+{
+    std::vector<std::string> arguments = needs_shell(command) ? std::vector<std::string>{"/bin/sh", "-c", command} : split_arguments(command);
+    if (arguments.empty())
+        return false;
+
+    std::vector<std::string> environment = build_environment();
+    std::vector<char*> argv = to_pointers(arguments);
+    std::vector<char*> envp = to_pointers(environment);
+    const std::string working_directory = get_working_directory();
+
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    posix_spawnattr_setsigmask(&attributes, &EventLoop::get_default_signal_mask());
+
+    short flags = POSIX_SPAWN_SETSIGMASK;
+    if (EshyWMConfig::launcher_setsid)
+        flags |= POSIX_SPAWN_SETSID;
+    posix_spawnattr_setflags(&attributes, flags);
+
+    posix_spawn_file_actions_t file_actions;
+    posix_spawn_file_actions_init(&file_actions);
+    posix_spawn_file_actions_addchdir_np(&file_actions, working_directory.c_str());
+    if (output_fd != -1)
+        posix_spawn_file_actions_adddup2(&file_actions, output_fd, STDOUT_FILENO);
+
+    pid_t pid;
+    const int result = posix_spawnp(&pid, argv[0], &file_actions, &attributes, argv.data(), envp.data());
+
+    posix_spawn_file_actions_destroy(&file_actions);
+    posix_spawnattr_destroy(&attributes);
+
+    if (result != 0)
+    {
+        LOGE("Failed to run '%s': %s", command.c_str(), strerror(result));
+        return false;
+    }
+
+    children.emplace(pid, command);
+    return true;
+}
+
+void Launcher::reap_children()
+{
+    //Signals coalesce, so one SIGCHLD can stand for several exited children
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+    {
+        auto child = children.find(pid);
+        if (child == children.end())
+            continue;
+
+        //The shell exits with 127 if it could not find the program
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 127)
+            LOGE("Failed to run '%s': command not found", child->second.c_str());
+
+        children.erase(child);
+    }
+}
@@ -6,7 +6,7 @@
 
 #include <X11/Xutil.h>
 
-EshyWMMenuBase::EshyWMMenuBase(Rect _menu_geometry, Color _menu_color) : menu_geometry(_menu_geometry), menu_color(_menu_color)
+EshyWMMenuBase::EshyWMMenuBase(Rect _menu_geometry, Color _menu_color) : menu_geometry(_menu_geometry), menu_color(_menu_color), b_menu_active(false)
 {
     menu_window = XCreateSimpleWindow(X11::get_display(), X11::get_root_window(), menu_geometry.x, menu_geometry.y, menu_geometry.width, menu_geometry.height, 0, 0, menu_color);
     XSelectInput(X11::get_display(), menu_window, KeyReleaseMask | SubstructureRedirectMask | SubstructureNotifyMask | VisibilityChangeMask);
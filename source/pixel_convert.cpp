@@ -0,0 +1,149 @@
+#include "pixel_convert.h"
+
+#if defined(__x86_64__) && !defined(__ILP32__)
+#include <immintrin.h>
+#endif
+
+//c * a + background * (255 - a), divided by 255 and rounded
+static inline uint32_t flatten_channel(uint32_t channel, uint32_t background, uint32_t alpha)
+{
+    const uint32_t value = channel * alpha + background * (255 - alpha) + 128;
+    return (value + (value >> 8)) >> 8;
+}
+
+template <typename Pixel>
+static void flatten_scalar(const Pixel* source, uint32_t* destination, size_t n_pixels, uint32_t background)
+{
+    for (size_t i = 0; i < n_pixels; ++i)
+    {
+        const uint32_t pixel = (uint32_t)source[i];
+        const uint32_t alpha = pixel >> 24;
+
+        uint32_t result = 0xFF000000;
+        for (int shift = 0; shift < 24; shift += 8)
+            result |= flatten_channel(pixel >> shift & 0xFF, background >> shift & 0xFF, alpha) << shift;
+
+        destination[i] = result;
+    }
+}
+
+#if defined(__x86_64__) && !defined(__ILP32__)
+
+static inline __m128i load_pixels_sse2(const uint32_t* source)
+{
+    return _mm_loadu_si128((const __m128i*)source);
+}
+
+//Packs the low halves of four 64 bit longs
+static inline __m128i load_pixels_sse2(const unsigned long* source)
+{
+    const __m128i first = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)source), _MM_SHUFFLE(3, 1, 2, 0));
+    const __m128i second = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(source + 2)), _MM_SHUFFLE(3, 1, 2, 0));
+    return _mm_unpacklo_epi64(first, second);
+}
+
+//Two pixels widened to 16 bits per channel
+static inline __m128i flatten_half_sse2(__m128i pixels, __m128i background)
+{
+    const __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    const __m128i inverse_alpha = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+
+    __m128i value = _mm_add_epi16(_mm_mullo_epi16(pixels, alpha), _mm_mullo_epi16(background, inverse_alpha));
+    value = _mm_add_epi16(value, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(value, _mm_srli_epi16(value, 8)), 8);
+}
+
+template <typename Pixel>
+static void flatten_sse2(const Pixel* source, uint32_t* destination, size_t n_pixels, uint32_t background)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i background_wide = _mm_unpacklo_epi8(_mm_set1_epi32(background), zero);
+    const __m128i opaque = _mm_set1_epi32(0xFF000000);
+
+    size_t i = 0;
+    for (; i + 4 <= n_pixels; i += 4)
+    {
+        const __m128i pixels = load_pixels_sse2(source + i);
+        const __m128i low = flatten_half_sse2(_mm_unpacklo_epi8(pixels, zero), background_wide);
+        const __m128i high = flatten_half_sse2(_mm_unpackhi_epi8(pixels, zero), background_wide);
+        _mm_storeu_si128((__m128i*)(destination + i), _mm_or_si128(_mm_packus_epi16(low, high), opaque));
+    }
+
+    flatten_scalar(source + i, destination + i, n_pixels - i, background);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i load_pixels_avx2(const uint32_t* source)
+{
+    return _mm256_loadu_si256((const __m256i*)source);
+}
+
+//Packs the low halves of eight 64 bit longs
+__attribute__((target("avx2")))
+static inline __m256i load_pixels_avx2(const unsigned long* source)
+{
+    const __m256i low_halves = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    const __m256i first = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i*)source), low_halves);
+    const __m256i second = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i*)(source + 4)), low_halves);
+    return _mm256_permute2x128_si256(first, second, 0x20);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i flatten_half_avx2(__m256i pixels, __m256i background)
+{
+    const __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    const __m256i inverse_alpha = _mm256_sub_epi16(_mm256_set1_epi16(255), alpha);
+
+    __m256i value = _mm256_add_epi16(_mm256_mullo_epi16(pixels, alpha), _mm256_mullo_epi16(background, inverse_alpha));
+    value = _mm256_add_epi16(value, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(value, _mm256_srli_epi16(value, 8)), 8);
+}
+
+template <typename Pixel>
+__attribute__((target("avx2")))
+static void flatten_avx2(const Pixel* source, uint32_t* destination, size_t n_pixels, uint32_t background)
+{
+    //Unpacking and packing both work within 128 bit lanes, so the pixel order comes out as it went in
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i background_wide = _mm256_unpacklo_epi8(_mm256_set1_epi32(background), zero);
+    const __m256i opaque = _mm256_set1_epi32(0xFF000000);
+
+    size_t i = 0;
+    for (; i + 8 <= n_pixels; i += 8)
+    {
+        const __m256i pixels = load_pixels_avx2(source + i);
+        const __m256i low = flatten_half_avx2(_mm256_unpacklo_epi8(pixels, zero), background_wide);
+        const __m256i high = flatten_half_avx2(_mm256_unpackhi_epi8(pixels, zero), background_wide);
+        _mm256_storeu_si256((__m256i*)(destination + i), _mm256_or_si256(_mm256_packus_epi16(low, high), opaque));
+    }
+
+    flatten_sse2(source + i, destination + i, n_pixels - i, background);
+}
+
+#endif
+
+template <typename Pixel>
+static void flatten(const Pixel* source, uint32_t* destination, size_t n_pixels, uint32_t background)
+{
+#if defined(__x86_64__) && !defined(__ILP32__)
+    static const bool b_has_avx2 = __builtin_cpu_supports("avx2");
+
+    if (b_has_avx2)
+        flatten_avx2(source, destination, n_pixels, background);
+    else
+        flatten_sse2(source, destination, n_pixels, background);
+#else
+    flatten_scalar(source, destination, n_pixels, background);
+#endif
+}
+
+
+void PixelConvert::flatten_argb(const unsigned long* source, uint32_t* destination, size_t n_pixels, uint32_t background)
+{
+    flatten(source, destination, n_pixels, background);
+}
+
+void PixelConvert::flatten_argb(const uint32_t* source, uint32_t* destination, size_t n_pixels, uint32_t background)
+{
+    flatten(source, destination, n_pixels, background);
+}
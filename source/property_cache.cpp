@@ -0,0 +1,122 @@
+#include "property_cache.h"
+
+#include <X11/Xatom.h>
+
+#include <algorithm>
+#include <span>
+
+uint8_t WindowPropertyCache::invalidate(Atom atom)
+{
+    if (atom == X11::atoms.window_name || atom == X11::atoms.net_wm_name)
+    {
+        name.b_valid = false;
+        return PC_Titlebar;
+    }
+    else if (atom == X11::atoms.window_class)
+    {
+        window_class.b_valid = false;
+        return PC_NONE;
+    }
+    else if (atom == X11::atoms.window_icon)
+    {
+        return PC_Icon;
+    }
+    else if (atom == X11::atoms.window_type)
+    {
+        window_type.b_valid = false;
+        return PC_Dock;
+    }
+    else if (atom == XA_WM_NORMAL_HINTS)
+    {
+        normal_hints.b_valid = false;
+        return PC_NONE;
+    }
+    else if (atom == XA_WM_HINTS)
+    {
+        wm_hints.b_valid = false;
+        return PC_NONE;
+    }
+
+    return PC_NONE;
+}
+
+void WindowPropertyCache::seed(const X11::WindowPrefetch& prefetch)
+{
+    name = {prefetch.name, true};
+    window_class = {prefetch.window_class, true};
+    window_type = {prefetch.window_type, true};
+}
+
+const std::string& WindowPropertyCache::get_name()
+{
+    if (name.b_valid)
+        return name.value;
+
+    const X11::WindowProperty net_name_property = X11::get_window_property(window, X11::atoms.net_wm_name);
+    if (net_name_property && net_name_property.n_items > 0)
+        name.value = std::string((const char*)net_name_property.property_value, net_name_property.n_items);
+    else
+        name.value = X11::get_window_name(window);
+
+    name.b_valid = true;
+    return name.value;
+}
+
+const std::string& WindowPropertyCache::get_class()
+{
+    if (window_class.b_valid)
+        return window_class.value;
+
+    const X11::WindowProperty class_property = X11::get_window_property(window, X11::atoms.window_class);
+    window_class.value = class_property ? std::string((const char*)class_property.property_value) : "";
+    window_class.b_valid = true;
+    return window_class.value;
+}
+
+const std::vector<Atom>& WindowPropertyCache::get_window_type()
+{
+    if (window_type.b_valid)
+        return window_type.value;
+
+    const X11::WindowProperty type_property = X11::get_window_property(window, X11::atoms.window_type);
+    if (type_property.status == Success && type_property.format == 32 && type_property.n_items > 0)
+        window_type.value.assign((Atom*)type_property.property_value, (Atom*)type_property.property_value + type_property.n_items);
+    else
+        window_type.value.clear();
+
+    window_type.b_valid = true;
+    return window_type.value;
+}
+
+const bool WindowPropertyCache::is_dock()
+{
+    return std::ranges::contains(get_window_type(), X11::atoms.window_type_dock);
+}
+
+const XSizeHints& WindowPropertyCache::get_normal_hints()
+{
+    if (normal_hints.b_valid)
+        return normal_hints.value;
+
+    long supplied_hints;
+    normal_hints.value = {};
+    XGetWMNormalHints(X11::get_display(), window, &normal_hints.value, &supplied_hints);
+    normal_hints.b_valid = true;
+    return normal_hints.value;
+}
+
+const XWMHints& WindowPropertyCache::get_wm_hints()
+{
+    if (wm_hints.b_valid)
+        return wm_hints.value;
+
+    wm_hints.value = {};
+    if (XWMHints* hints = XGetWMHints(X11::get_display(), window))
+    {
+        wm_hints.value = *hints;
+        XFree(hints);
+    }
+
+    wm_hints.b_valid = true;
+    return wm_hints.value;
+}
@@ -0,0 +1,284 @@
+#include "status_bar.h"
+#include "container.h"
+#include "eshywm.h"
+#include "font_manager.h"
+#include "status_provider.h"
+#include "window.h"
+#include "window_manager.h"
+#include "X11.h"
+
+#include <Imlib2.h>
+
+#include <algorithm>
+#include <ranges>
+#include <string_view>
+
+//Space on either side of the text of a status segment
+static constexpr int SEGMENT_PADDING = 8;
+//Height of the level meter along the bottom of segments that have a level
+static constexpr int LEVEL_METER_HEIGHT = 2;
+
+static void set_imlib_color(ulong color, int alpha)
+{
+    imlib_context_set_color(color >> 16 & 0xFF, color >> 8 & 0xFF, color & 0xFF, alpha);
+}
+
+static Rect get_bar_geometry(std::shared_ptr<Output> output)
+{
+    const int y = EshyWMConfig::status_bar_position == "bottom" ? output->geometry.y + (int)output->geometry.height - (int)EshyWMConfig::status_bar_height : output->geometry.y;
+    return {output->geometry.x, y, output->geometry.width, EshyWMConfig::status_bar_height};
+}
+
+
+EshyWMStatusBar::EshyWMStatusBar(std::shared_ptr<Output> _output)
+    : EshyWMMenuBase(get_bar_geometry(_output), EshyWMConfig::status_bar_color)
+    , output(_output)
+    , workspace_segments(EshyWM::window_manager->workspaces.size())
+    , back_buffer(None)
+{
+    Display* display = X11::get_display();
+    back_buffer = XCreatePixmap(display, menu_window, menu_geometry.width, menu_geometry.height, DefaultDepth(display, DefaultScreen(display)));
+    XSetWindowBackgroundPixmap(display, menu_window, back_buffer);
+
+    //Same proportion of text to height as the titlebar
+    font = FontManager::get_font("Lato-Regular", std::max(EshyWMConfig::status_bar_height * 14 / 26, 8u));
+    text_y = 0;
+    if (font)
+    {
+        int text_width;
+        int text_height;
+        imlib_context_set_font(font->font);
+        imlib_get_text_size("Ag", &text_width, &text_height);
+        text_y = ((int)menu_geometry.height - text_height) / 2;
+    }
+
+    //Workspace cells are square
+    for (size_t i = 0; i < workspace_segments.size(); ++i)
+        set_segment_position(workspace_segments[i], i * menu_geometry.height, menu_geometry.height);
+
+    for (const auto name : EshyWMConfig::status_bar_providers | std::views::split(' '))
+    {
+        const std::string_view provider_name(name.begin(), name.end());
+        if (provider_name.empty())
+            continue;
+
+        if (std::shared_ptr<StatusProvider> provider = StatusProviders::find_provider(provider_name))
+            providers.push_back(provider);
+        else
+            LOGE("Unknown status provider '%s' in status_bar_providers", std::string(provider_name).c_str());
+    }
+
+    status_segments.resize(providers.size());
+    layout_segments();
+
+    update_status();
+    update_workspaces();
+    draw();
+}
+
+EshyWMStatusBar::~EshyWMStatusBar()
+{
+    remove();
+
+    Display* display = X11::get_display();
+    XFreePixmap(display, back_buffer);
+    XFreeGC(display, graphics_context_internal);
+    XDestroyWindow(display, menu_window);
+}
+
+void EshyWMStatusBar::show()
+{
+    if (b_menu_active)
+        return;
+
+    //The bar takes space from the active workspace like an external dock does
+    dock = std::make_shared<Dock>(menu_window, output, menu_geometry, EshyWMConfig::status_bar_position == "bottom" ? DL_Bottom : DL_Top);
+    output->add_dock(dock, dock->dock_location);
+
+    EshyWMMenuBase::show();
+}
+
+void EshyWMStatusBar::remove()
+{
+    if (!b_menu_active)
+        return;
+
+    if (output->top_dock == dock || output->bottom_dock == dock)
+        output->remove_dock(dock);
+    dock = nullptr;
+
+    EshyWMMenuBase::remove();
+}
+
+void EshyWMStatusBar::draw()
+{
+    XSetForeground(X11::get_display(), graphics_context_internal, menu_color);
+    XFillRectangle(X11::get_display(), back_buffer, graphics_context_internal, 0, 0, menu_geometry.width, menu_geometry.height);
+
+    for (bar_segment& segment : workspace_segments)
+        segment.b_damaged = true;
+    for (bar_segment& segment : status_segments)
+        segment.b_damaged = true;
+    title_segment.b_damaged = true;
+
+    draw_damaged();
+}
+
+void EshyWMStatusBar::update_workspaces()
+{
+    const std::vector<std::shared_ptr<EshyWMWindow>>& window_list = EshyWM::window_manager->window_list;
+
+    for (const std::shared_ptr<Workspace>& workspace : EshyWM::window_manager->workspaces)
+    {
+        if (workspace->num < 0 || workspace->num >= (int)workspace_segments.size())
+            continue;
+
+        //Workspaces without windows are dimmed
+        const bool b_occupied = std::ranges::any_of(window_list, [&workspace](const auto& window){return window->parent_workspace == workspace;});
+        set_segment(workspace_segments[workspace->num], std::to_string(workspace->num + 1), -1.0f, workspace == output->active_workspace, !b_occupied);
+    }
+
+    //The focused window may have been on the workspace that was just left
+    update_title();
+}
+
+void EshyWMStatusBar::update_title()
+{
+    //Only the bar of the output showing the focused window has a title
+    const std::shared_ptr<EshyWMWindow> focused_window = EshyWM::window_manager->focused_window;
+    full_title = focused_window && focused_window->parent_workspace == output->active_workspace ? focused_window->get_title() : "";
+
+    set_segment(title_segment, font ? FontManager::ellipsize_text(font, full_title, (int)title_segment.width - SEGMENT_PADDING * 2) : "", -1.0f, false, false);
+    draw_damaged();
+}
+
+void EshyWMStatusBar::update_status()
+{
+    bool b_needs_layout = false;
+
+    for (size_t i = 0; i < providers.size(); ++i)
+    {
+        const std::shared_ptr<const StatusSnapshot> snapshot = providers[i]->get_snapshot();
+        if (status_segments[i].text.size() != snapshot->text.size() || status_segments[i].text != snapshot->text)
+            b_needs_layout = true;
+
+        set_segment(status_segments[i], snapshot->text, snapshot->level, false, false);
+    }
+
+    //Text of a different width moves the segments left of it
+    if (b_needs_layout)
+        layout_segments();
+
+    draw_damaged();
+}
+
+void EshyWMStatusBar::button_clicked(int x, int y)
+{
+    for (size_t i = 0; i < workspace_segments.size(); ++i)
+    {
+        const bar_segment& segment = workspace_segments[i];
+        if (x < segment.x || x >= segment.x + (int)segment.width)
+            continue;
+
+        for (auto workspace : EshyWM::window_manager->workspaces | std::views::filter([i](auto workspace) {return workspace->num == (int)i;}))
+            output->activate_workspace(workspace);
+        return;
+    }
+}
+
+void EshyWMStatusBar::set_segment(bar_segment& segment, const std::string& text, float level, bool b_highlighted, bool b_dimmed)
+{
+    if (segment.text == text && segment.level == level && segment.b_highlighted == b_highlighted && segment.b_dimmed == b_dimmed)
+        return;
+
+    segment.text = text;
+    segment.level = level;
+    segment.b_highlighted = b_highlighted;
+    segment.b_dimmed = b_dimmed;
+    segment.b_damaged = true;
+}
+
+void EshyWMStatusBar::set_segment_position(bar_segment& segment, int x, uint width)
+{
+    if (segment.x == x && segment.width == width)
+        return;
+
+    segment.x = x;
+    segment.width = width;
+    segment.b_damaged = true;
+}
+
+void EshyWMStatusBar::layout_segments()
+{
+    int right = menu_geometry.width;
+    for (bar_segment& segment : status_segments | std::views::reverse)
+    {
+        //Providers with nothing to show take no space
+        const uint width = segment.text.empty() || !font ? 0 : FontManager::measure_text(font, segment.text) + SEGMENT_PADDING * 2;
+        right -= width;
+        set_segment_position(segment, right, width);
+    }
+
+    const int title_x = workspace_segments.size() * menu_geometry.height;
+    const uint title_width = std::max(right - title_x, 0);
+    if (title_segment.x == title_x && title_segment.width == title_width)
+        return;
+
+    set_segment_position(title_segment, title_x, title_width);
+    set_segment(title_segment, font ? FontManager::ellipsize_text(font, full_title, (int)title_width - SEGMENT_PADDING * 2) : "", -1.0f, false, false);
+}
+
+void EshyWMStatusBar::draw_segment(bar_segment& segment)
+{
+    segment.b_damaged = false;
+    if (segment.width == 0)
+        return;
+
+    Imlib_Image buffer = imlib_create_image(segment.width, menu_geometry.height);
+    imlib_context_set_image(buffer);
+
+    set_imlib_color(segment.b_highlighted ? EshyWMConfig::status_bar_highlight_color : EshyWMConfig::status_bar_color, 255);
+    imlib_image_fill_rectangle(0, 0, segment.width, menu_geometry.height);
+
+    if (font && !segment.text.empty())
+    {
+        //The title is left aligned, every other segment is sized around its text or centers it
+        const int text_x = &segment == &title_segment ? SEGMENT_PADDING : std::max(((int)segment.width - FontManager::measure_text(font, segment.text)) / 2, 0);
+
+        imlib_context_set_font(font->font);
+        set_imlib_color(EshyWMConfig::status_bar_text_color, segment.b_dimmed ? 110 : 255);
+        imlib_text_draw(text_x, text_y, segment.text.c_str());
+    }
+
+    if (segment.level >= 0.0f)
+    {
+        const int level_width = std::min(segment.level, 1.0f) * (segment.width - SEGMENT_PADDING * 2);
+        set_imlib_color(EshyWMConfig::status_bar_text_color, 160);
+        imlib_image_fill_rectangle(SEGMENT_PADDING, menu_geometry.height - LEVEL_METER_HEIGHT, level_width, LEVEL_METER_HEIGHT);
+    }
+
+    imlib_context_set_drawable(back_buffer);
+    imlib_context_set_blend(0);
+    imlib_render_image_on_drawable(segment.x, 0);
+    imlib_free_image();
+
+    XClearArea(X11::get_display(), menu_window, segment.x, 0, segment.width, menu_geometry.height, False);
+}
+
+void EshyWMStatusBar::draw_damaged()
+{
+    for (bar_segment& segment : workspace_segments)
+    {
+        if (segment.b_damaged)
+            draw_segment(segment);
+    }
+
+    if (title_segment.b_damaged)
+        draw_segment(title_segment);
+
+    for (bar_segment& segment : status_segments)
+    {
+        if (segment.b_damaged)
+            draw_segment(segment);
+    }
+}
@@ -0,0 +1,503 @@
+#include "status_provider.h"
+#include "config.h"
+#include "event_loop.h"
+#include "launcher.h"
+#include "system.h"
+#include "timer_wheel.h"
+#include "util.h"
+
+#include <sys/epoll.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <charconv>
+#include <cmath>
+#include <ctime>
+#include <optional>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+//Every interval is rounded to a multiple of this
+static constexpr std::chrono::milliseconds TICK = 250ms;
+
+static std::vector<std::shared_ptr<StatusProvider>> providers;
+static std::optional<TimerWheel> timer_wheel;
+static EventLoop::TimerHandle wheel_timer = 0;
+
+static StatusProviders::SnapshotsChanged snapshots_changed;
+static bool b_change_notification_pending = false;
+
+static uint64_t get_current_tick()
+{
+    return std::chrono::steady_clock::now().time_since_epoch() / TICK;
+}
+
+static void schedule_wheel_timer()
+{
+    EventLoop::remove_timer(wheel_timer);
+    wheel_timer = 0;
+
+    const std::optional<uint64_t> next_tick = timer_wheel ? timer_wheel->get_next_tick() : std::nullopt;
+    if (!next_tick)
+        return;
+
+    const auto deadline = std::chrono::steady_clock::time_point(*next_tick * TICK);
+    const auto delay = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+
+    wheel_timer = EventLoop::add_timer(std::max(delay, 0ms), 0ms, []()
+    {
+        wheel_timer = 0;
+        timer_wheel->advance(get_current_tick());
+        schedule_wheel_timer();
+    });
+}
+
+//Reads the whole file from the start, /proc and /sys produce the current contents on every read from offset 0
+static bool read_whole_file(int fd, std::string& out)
+{
+    out.resize(16384);
+    const ssize_t length = pread(fd, out.data(), out.size(), 0);
+    if (length < 0)
+        return false;
+
+    out.resize(length);
+    return true;
+}
+
+static std::string_view next_line(std::string_view& text)
+{
+    const size_t end = std::min(text.find('\n'), text.size());
+    const std::string_view line = text.substr(0, end);
+    text.remove_prefix(std::min(end + 1, text.size()));
+    return line;
+}
+
+//Parses consecutive whitespace separated numbers
+static std::vector<uint64_t> parse_numbers(std::string_view text)
+{
+    std::vector<uint64_t> numbers;
+    const char* position = text.data();
+    const char* end = text.data() + text.size();
+
+    while (position < end)
+    {
+        while (position < end && (*position == ' ' || *position == '\t'))
+            position++;
+
+        uint64_t number;
+        const auto [number_end, error] = std::from_chars(position, end, number);
+        if (error != std::errc())
+            break;
+
+        numbers.push_back(number);
+        position = number_end;
+    }
+
+    return numbers;
+}
+
+static std::string format_bytes(double bytes)
+{
+    static constexpr const char* units[] = {"B", "K", "M", "G"};
+    size_t unit = 0;
+    while (bytes >= 1000.0 && unit + 1 < std::size(units))
+    {
+        bytes /= 1024.0;
+        unit++;
+    }
+
+    char text[16];
+    snprintf(text, sizeof(text), bytes < 10.0 && unit > 0 ? "%.1f%s" : "%.0f%s", bytes, units[unit]);
+    return text;
+}
+
+
+class BatteryProvider : public StatusProvider
+{
+public:
+
+    BatteryProvider() : StatusProvider("battery", 4s) {}
+
+    //System already follows the battery through uevents, this only turns its snapshot into text
+    virtual void refresh() override
+    {
+        const std::shared_ptr<const PowerSnapshot> power = System::get_power();
+        if (power->battery_percentage < 0)
+        {
+            publish({});
+            return;
+        }
+
+        const bool b_charging = power->status == POWER_SUPPLY_STATUS_CHARGING;
+        publish({"BAT " + std::to_string(power->battery_percentage) + "%" + (b_charging ? "+" : ""), power->battery_percentage / 100.0f});
+    }
+};
+
+class ClockProvider : public StatusProvider
+{
+public:
+
+    ClockProvider() : StatusProvider("clock", 1s) {}
+
+    virtual void refresh() override
+    {
+        const time_t now = time(nullptr);
+        tm local_time;
+        localtime_r(&now, &local_time);
+
+        char text[128];
+        const size_t length = strftime(text, sizeof(text), EshyWMConfig::status_clock_format.c_str(), &local_time);
+        publish({std::string(text, length)});
+    }
+};
+
+class CpuProvider : public StatusProvider
+{
+public:
+
+    CpuProvider() : StatusProvider("cpu", 2s), stat_fd(open("/proc/stat", O_RDONLY | O_CLOEXEC)) {}
+    virtual ~CpuProvider() override {if (stat_fd != -1) close(stat_fd);}
+
+    //Load is the share of time since the last refresh that was not spent idle or waiting for IO
+    virtual void refresh() override
+    {
+        if (stat_fd == -1 || !read_whole_file(stat_fd, buffer))
+            return;
+
+        std::string_view text = buffer;
+        const std::string_view line = next_line(text);
+        if (!line.starts_with("cpu "))
+            return;
+
+        const std::vector<uint64_t> times = parse_numbers(line.substr(4));
+        if (times.size() < 5)
+            return;
+
+        uint64_t total = 0;
+        for (const uint64_t time : times)
+            total += time;
+
+        const uint64_t idle = times[3] + times[4];
+        const uint64_t total_delta = total - previous_total;
+        const uint64_t idle_delta = idle - previous_idle;
+        const bool b_first = previous_total == 0;
+
+        previous_total = total;
+        previous_idle = idle;
+
+        if (b_first || total_delta == 0)
+            return;
+
+        const float load = 1.0f - (float)idle_delta / total_delta;
+        publish({"CPU " + std::to_string((int)std::lround(load * 100.0f)) + "%", load});
+    }
+
+private:
+
+    int stat_fd;
+    std::string buffer;
+    uint64_t previous_total = 0;
+    uint64_t previous_idle = 0;
+};
+
+class MemoryProvider : public StatusProvider
+{
+public:
+
+    MemoryProvider() : StatusProvider("memory", 4s), meminfo_fd(open("/proc/meminfo", O_RDONLY | O_CLOEXEC)) {}
+    virtual ~MemoryProvider() override {if (meminfo_fd != -1) close(meminfo_fd);}
+
+    virtual void refresh() override
+    {
+        if (meminfo_fd == -1 || !read_whole_file(meminfo_fd, buffer))
+            return;
+
+        uint64_t total = 0;
+        uint64_t available = 0;
+        bool b_has_available = false;
+
+        for (std::string_view text = buffer; !text.empty();)
+        {
+            const std::string_view line = next_line(text);
+            const bool b_total = line.starts_with("MemTotal:");
+            if (!b_total && !line.starts_with("MemAvailable:"))
+                continue;
+
+            //Lines without a number are skipped, the reading is not published without both values
+            const std::vector<uint64_t> numbers = parse_numbers(line.substr(line.find(':') + 1));
+            if (numbers.empty())
+                continue;
+
+            if (b_total)
+                total = numbers.front();
+            else
+            {
+                available = numbers.front();
+                b_has_available = true;
+            }
+        }
+
+        if (total == 0 || !b_has_available)
+            return;
+
+        const float used = 1.0f - (float)available / total;
+        publish({"MEM " + std::to_string((int)std::lround(used * 100.0f)) + "%", used});
+    }
+
+private:
+
+    int meminfo_fd;
+    std::string buffer;
+};
+
+class NetworkProvider : public StatusProvider
+{
+public:
+
+    NetworkProvider() : StatusProvider("network", 2s), dev_fd(open("/proc/net/dev", O_RDONLY | O_CLOEXEC)) {}
+    virtual ~NetworkProvider() override {if (dev_fd != -1) close(dev_fd);}
+
+    //Bytes per second received and sent, over status_network_interface or every interface but loopback
+    virtual void refresh() override
+    {
+        if (dev_fd == -1 || !read_whole_file(dev_fd, buffer))
+            return;
+
+        uint64_t received = 0;
+        uint64_t sent = 0;
+
+        std::string_view text = buffer;
+        next_line(text);
+        next_line(text);
+
+        while (!text.empty())
+        {
+            const std::string_view line = next_line(text);
+            const size_t separator = line.find(':');
+            if (separator == std::string_view::npos)
+                continue;
+
+            std::string_view interface = line.substr(0, separator);
+            interface.remove_prefix(std::min(interface.find_first_not_of(' '), interface.size()));
+
+            const std::string& wanted_interface = EshyWMConfig::status_network_interface;
+            if (wanted_interface.empty() ? interface == "lo" : interface != wanted_interface)
+                continue;
+
+            //Received bytes come first and sent bytes are the 9th column
+            const std::vector<uint64_t> counters = parse_numbers(line.substr(separator + 1));
+            if (counters.size() < 9)
+                continue;
+
+            received += counters[0];
+            sent += counters[8];
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        const double seconds = std::chrono::duration<double>(now - previous_time).count();
+        const bool b_first = previous_time == std::chrono::steady_clock::time_point();
+
+        //Counters restart when an interface goes away
+        const uint64_t received_delta = received >= previous_received ? received - previous_received : 0;
+        const uint64_t sent_delta = sent >= previous_sent ? sent - previous_sent : 0;
+
+        previous_time = now;
+        previous_received = received;
+        previous_sent = sent;
+
+        if (b_first || seconds <= 0.0)
+            return;
+
+        publish({"NET " + format_bytes(received_delta / seconds) + "/" + format_bytes(sent_delta / seconds)});
+    }
+
+private:
+
+    int dev_fd;
+    std::string buffer;
+    std::chrono::steady_clock::time_point previous_time;
+    uint64_t previous_received = 0;
+    uint64_t previous_sent = 0;
+};
+
+//Shows the last line a command printed. The command runs through the launcher and its output is read on the event loop
+class ScriptProvider : public StatusProvider
+{
+public:
+
+    ScriptProvider(std::string _name, std::chrono::milliseconds _interval, std::string _command)
+        : StatusProvider(std::move(_name), _interval)
+        , command(std::move(_command))
+        , output_fd(-1)
+    {}
+
+    virtual ~ScriptProvider() override
+    {
+        close_output();
+    }
+
+    virtual void refresh() override
+    {
+        //A run that takes longer than the interval is left to finish instead of starting another
+        if (output_fd != -1)
+            return;
+
+        int fds[2];
+        if (pipe2(fds, O_CLOEXEC) == -1)
+            return;
+
+        const bool b_started = Launcher::spawn(command, fds[1]);
+        close(fds[1]);
+
+        if (!b_started)
+        {
+            close(fds[0]);
+            return;
+        }
+
+        output_fd = fds[0];
+        output.clear();
+        fcntl(output_fd, F_SETFL, O_NONBLOCK);
+        EventLoop::add_fd(output_fd, EPOLLIN, [this](uint32_t events){ read_output(); });
+    }
+
+private:
+
+    static constexpr size_t MAX_OUTPUT = 65536;
+
+    std::string command;
+    std::string output;
+    int output_fd;
+
+    void read_output()
+    {
+        char buffer[4096];
+        ssize_t length;
+        while ((length = read(output_fd, buffer, sizeof(buffer))) > 0)
+        {
+            if (output.size() < MAX_OUTPUT)
+                output.append(buffer, length);
+        }
+
+        if (length == -1 && errno == EAGAIN)
+            return;
+
+        close_output();
+
+        std::string_view text = output;
+        while (!text.empty() && (text.back() == '\n' || text.back() == ' '))
+            text.remove_suffix(1);
+
+        publish({std::string(text.substr(text.rfind('\n') + 1))});
+    }
+
+    void close_output()
+    {
+        if (output_fd == -1)
+            return;
+
+        EventLoop::remove_fd(output_fd);
+        close(output_fd);
+        output_fd = -1;
+    }
+};
+
+//name interval_seconds command
+static std::shared_ptr<StatusProvider> create_script_provider(std::string_view script)
+{
+    const size_t name_end = script.find(' ');
+    const size_t interval_end = script.find(' ', name_end + 1);
+    if (name_end == std::string_view::npos || interval_end == std::string_view::npos)
+        return nullptr;
+
+    double interval_seconds;
+    const std::string_view interval = script.substr(name_end + 1, interval_end - name_end - 1);
+    if (std::from_chars(interval.data(), interval.data() + interval.size(), interval_seconds).ec != std::errc() || interval_seconds <= 0.0)
+        return nullptr;
+
+    const auto interval_ms = std::chrono::milliseconds((int64_t)(interval_seconds * 1000.0));
+    return std::make_shared<ScriptProvider>(std::string(script.substr(0, name_end)), interval_ms, std::string(script.substr(interval_end + 1)));
+}
+
+
+StatusProvider::StatusProvider(std::string _name, std::chrono::milliseconds _interval)
+    : name(std::move(_name))
+    , interval(_interval)
+    , snapshot(std::make_shared<const StatusSnapshot>())
+{
+}
+
+void StatusProvider::publish(StatusSnapshot new_snapshot)
+{
+    if (*snapshot.load() == new_snapshot)
+        return;
+
+    snapshot.store(std::make_shared<const StatusSnapshot>(std::move(new_snapshot)));
+
+    //Everything published until the posted callback runs is reported together
+    if (b_change_notification_pending || !snapshots_changed)
+        return;
+
+    b_change_notification_pending = true;
+    EventLoop::post([]()
+    {
+        b_change_notification_pending = false;
+        if (snapshots_changed)
+            snapshots_changed();
+    });
+}
+
+
+void StatusProviders::initialize(SnapshotsChanged _snapshots_changed)
+{
+    snapshots_changed = _snapshots_changed;
+    timer_wheel.emplace(get_current_tick());
+
+    add_provider(std::make_shared<BatteryProvider>());
+    add_provider(std::make_shared<ClockProvider>());
+    add_provider(std::make_shared<CpuProvider>());
+    add_provider(std::make_shared<MemoryProvider>());
+    add_provider(std::make_shared<NetworkProvider>());
+
+    for (const std::string& script : EshyWMConfig::status_scripts)
+    {
+        if (std::shared_ptr<StatusProvider> provider = create_script_provider(script))
+            add_provider(provider);
+        else
+            LOGE("Invalid status_script '%s', expected name interval_seconds command", script.c_str());
+    }
+}
+
+void StatusProviders::shutdown()
+{
+    EventLoop::remove_timer(wheel_timer);
+    wheel_timer = 0;
+
+    timer_wheel.reset();
+    providers.clear();
+    snapshots_changed = nullptr;
+}
+
+void StatusProviders::add_provider(std::shared_ptr<StatusProvider> provider)
+{
+    providers.push_back(provider);
+
+    //The first snapshot is there right away, after that the provider follows its interval
+    provider->refresh();
+
+    const uint64_t interval_ticks = std::max<uint64_t>(provider->get_interval() / TICK, 1);
+    timer_wheel->add(interval_ticks, [provider = provider.get()](){ provider->refresh(); });
+    schedule_wheel_timer();
+}
+
+std::shared_ptr<StatusProvider> StatusProviders::find_provider(std::string_view name)
+{
+    for (const std::shared_ptr<StatusProvider>& provider : providers)
+    {
+        if (provider->get_name() == name)
+            return provider;
+    }
+
+    return nullptr;
+}
@@ -1,8 +1,10 @@
 
 #include "switcher.h"
 #include "eshywm.h"
-#include "button.h"
 #include "window.h"
+#include "icon_cache.h"
+#include "container.h"
+#include "thumbnail_cache.h"
 #include "X11.h"
 
 #include <X11/Xutil.h>
@@ -12,19 +14,15 @@
 #include <string.h>
 #include <cmath>
 
-static const int get_button_x_position(const int i)
-{
-    int x = EshyWMConfig::switcher_button_padding;
-    for(int j = 0; j < i; ++j)
-    {
-        x += SWITCHER->get_switcher_window_options()[j].button->get_button_geometry().width;
-        x += EshyWMConfig::switcher_button_padding;
-    }
-    return x;
-}
-
-
-EshyWMSwitcher::EshyWMSwitcher(Rect _menu_geometry, Color _menu_color) : EshyWMMenuBase(_menu_geometry, _menu_color), selected_option(0)
+EshyWMSwitcher::EshyWMSwitcher(Rect _menu_geometry, Color _menu_color)
+    : EshyWMMenuBase(_menu_geometry, _menu_color)
+    , selected_option(0)
+    , displayed_page(0)
+    , back_buffer(None)
+    , back_buffer_size({0, 0})
+    , b_needs_layout(true)
+    , b_filtering(false)
+    , b_keyboard_grabbed(false)
 {
     const char* class_name = "eshywm_switcher\0switcher";
     X11::change_window_property(menu_window, X11::atoms.window_class, XA_STRING, 8, (const unsigned char*)class_name);
@@ -39,72 +37,170 @@ EshyWMSwitcher::EshyWMSwitcher(Rect _menu_geometry, Color _menu_color) : EshyWMM
      * I cannot grab alt with GrabModeAsync because then it is not passed into any windows. I have tried XAllowEvents and XSendEvent.
      * I cannot grab alt after a Alt-Tab press becase then a release event will not be triggered.
      * I have to grab these asynchronously and enable KeyReleaseMask in ROOT. The issue is I now get and have to handle the event for EVERY key release, not just Alt.
+     *
+     * Alt+Tab is grabbed with the other key actions of the WindowManager.
     */
-    X11::grab_key(XK_Tab, Mod1Mask | 0, X11::get_root_window());
 }
 
+static uint option_width(const switcher_option& option)
+{
+    //Thumbnails and the switcher variant of icons are already switcher_button_height tall
+    if(const Thumbnail* thumbnail = ThumbnailCache::get_thumbnail(option.window->get_frame()))
+        return thumbnail->size.width;
+
+    if(!option.icon->switcher.image)
+        return EshyWMConfig::switcher_button_height;
+
+    imlib_context_set_image(option.icon->switcher.image);
+    return imlib_image_get_width();
+}
+
+
 void EshyWMSwitcher::show()
 {
-    X11::map_window(menu_window);
+    //Alt+Tab calls this for every Tab press, only the first one has anything to do
+    if(!b_menu_active)
+    {
+        //Brings every thumbnail that changed while hidden up to date before the layout uses their sizes
+        ThumbnailCache::set_active(true);
+
+        //Options wrap to fit the output the switcher opens on
+        const std::shared_ptr<Output> output = get_output();
+        if(layout.set_bounds(output->geometry.width * 9 / 10, output->geometry.height * 9 / 10))
+            b_needs_layout = true;
+
+        if(b_needs_layout)
+            update_layout();
+
+        set_position(center_x(output, menu_geometry.width), center_y(output, menu_geometry.height));
+        X11::map_window(menu_window);
+        b_menu_active = true;
+
+        //Keys typed while the switcher is open filter it instead of going to the focused window
+        b_keyboard_grabbed = XGrabKeyboard(X11::get_display(), X11::get_root_window(), False, GrabModeAsync, GrabModeAsync, CurrentTime) == GrabSuccess;
+        if(!b_keyboard_grabbed)
+            LOGW("Failed to grab the keyboard, the switcher cannot be filtered by typing");
+    }
+
     raise(true);
-    b_menu_active = true;
 }
 
-void EshyWMSwitcher::raise(bool b_set_focus)
+void EshyWMSwitcher::draw()
 {
-    update_button_positions();
-    EshyWMMenuBase::raise(b_set_focus);
+    Display* display = X11::get_display();
+
+    XSetForeground(display, graphics_context_internal, menu_color);
+    XFillRectangle(display, back_buffer, graphics_context_internal, 0, 0, back_buffer_size.width, back_buffer_size.height);
+
+    const auto [first, last] = layout.get_page_range(displayed_page);
+    for(size_t i = first; i < last; i++)
+        draw_option(i);
+
+    XClearWindow(display, menu_window);
 }
 
-void EshyWMSwitcher::button_clicked(int x_root, int y_root)
+void EshyWMSwitcher::button_clicked(int x, int y)
 {
-    for(int i = 0; i < switcher_window_options.size(); i++)
+    const int i = layout.find_option(displayed_page, x, y);
+    if(i != -1)
     {
-        if(switcher_window_options[i].button->check_hovered(x_root, y_root))
-        {
-            selected_option = i;
-            confirm_choice();
-            break;
-        }
+        selected_option = i;
+        confirm_choice();
     }
 }
 
-void EshyWMSwitcher::update_button_positions()
+void EshyWMSwitcher::invalidate_layout()
 {
-    uint width = EshyWMConfig::switcher_button_padding;
-    for(window_button_pair pair : switcher_window_options)
+    if(!b_menu_active)
     {
-        if (!pair.button)
-            continue;
-        
-        width += pair.button->get_button_geometry().width;
-        width += EshyWMConfig::switcher_button_padding;
+        b_needs_layout = true;
+        return;
     }
 
-    const uint height = EshyWMConfig::switcher_button_height + (EshyWMConfig::switcher_button_padding * 2);
-    
-    set_size(width, height);
+    update_layout();
+
+    const std::shared_ptr<Output> output = get_output();
+    set_position(center_x(output, menu_geometry.width), center_y(output, menu_geometry.height));
+}
+
+void EshyWMSwitcher::update_layout()
+{
+    b_needs_layout = false;
+
+    layout.set_metrics(EshyWMConfig::switcher_button_padding, EshyWMConfig::switcher_button_height);
+
+    if(selected_option >= layout.size())
+        selected_option = 0;
+
+    displayed_page = layout.size() == 0 ? 0 : layout.get_page(selected_option);
+
+    const Size size = layout.get_page_size();
+    set_size(size.width, size.height);
 
+    Display* display = X11::get_display();
+    if(back_buffer_size.width != size.width || back_buffer_size.height != size.height)
+    {
+        if(back_buffer != None)
+            XFreePixmap(display, back_buffer);
+
+        back_buffer = XCreatePixmap(display, menu_window, size.width, size.height, DefaultDepth(display, DefaultScreen(display)));
+        back_buffer_size = size;
+        XSetWindowBackgroundPixmap(display, menu_window, back_buffer);
+    }
+
+    draw();
+}
+
+std::shared_ptr<Output> EshyWMSwitcher::get_output() const
+{
     const Pos cursor_position = X11::get_cursor_position();
 
     if(auto output = output_at_position(cursor_position.x, cursor_position.y))
-        set_position(center_x(output, width), center_y(output, height));
-    else
-        set_position(center_x(EshyWM::window_manager->outputs[0], width), center_y(EshyWM::window_manager->outputs[0], height));
+        return output;
 
-    for(int i = 0; i < switcher_window_options.size(); i++)
+    return EshyWM::window_manager->outputs[0];
+}
+
+void EshyWMSwitcher::draw_option(int i)
+{
+    Display* display = X11::get_display();
+    const Rect cell = layout.get_cell(i);
+    const switcher_option& option = switcher_window_options[option_at(i)];
+    const int border = 2;
+
+    //The selection border goes around the icon, inside the padding
+    XSetForeground(display, graphics_context_internal, i == selected_option ? EshyWMConfig::switcher_button_border_color : menu_color);
+    XFillRectangle(display, back_buffer, graphics_context_internal, cell.x - border, cell.y - border, cell.width + border * 2, cell.height + border * 2);
+
+    if(const Thumbnail* thumbnail = ThumbnailCache::get_thumbnail(option.window->get_frame()))
     {
-        if (!switcher_window_options[i].button)
-            continue;
-        
-        switcher_window_options[i].button->set_position(get_button_x_position(i), EshyWMConfig::switcher_button_padding);
-        switcher_window_options[i].button->draw();
+        XCopyArea(display, thumbnail->pixmap, back_buffer, graphics_context_internal, 0, 0, cell.width, cell.height, cell.x, cell.y);
+    }
+    else if(const Imlib_Image image = option.icon->switcher.image)
+    {
+        //Switcher icons are opaque, they are already composited over switcher_button_color
+        imlib_context_set_drawable(back_buffer);
+        imlib_context_set_image(image);
+        imlib_context_set_blend(0);
+        imlib_render_image_on_drawable(cell.x, cell.y);
+    }
+    else
+    {
+        XSetForeground(display, graphics_context_internal, EshyWMConfig::switcher_button_color);
+        XFillRectangle(display, back_buffer, graphics_context_internal, cell.x, cell.y, cell.width, cell.height);
     }
 }
 
+void EshyWMSwitcher::present_option(int i)
+{
+    const Rect cell = layout.get_cell(i);
+    const int border = 2;
+    XClearArea(X11::get_display(), menu_window, cell.x - border, cell.y - border, cell.width + border * 2, cell.height + border * 2, False);
+}
+
 void EshyWMSwitcher::update_switcher_window_options()
 {
-    std::vector<window_button_pair> old_switcher_window_options = switcher_window_options;
+    std::vector<switcher_option> old_switcher_window_options = switcher_window_options;
 
     // switcher_window_options.clear();
 
@@ -119,22 +215,19 @@ void EshyWMSwitcher::update_switcher_window_options()
 }
 
 
-void EshyWMSwitcher::add_window_option(std::shared_ptr<EshyWMWindow> associated_window, Image* icon)
+void EshyWMSwitcher::add_window_option(std::shared_ptr<EshyWMWindow> associated_window, std::shared_ptr<CachedIcon> icon)
 {
-    imlib_context_set_image(icon->image);
-    const int height = imlib_image_get_height();
-    const int width = imlib_image_get_width();
-
-    const float scale = 140.0f / height;
+    switcher_window_options.insert(switcher_window_options.begin(), {associated_window, icon});
 
-    const Rect size = {0, 0, (uint)std::round(width * scale), (uint)std::round(height * scale)};
-    const button_color_data color = {EshyWMConfig::switcher_button_color, EshyWMConfig::switcher_button_color, EshyWMConfig::switcher_button_color};
+    if(b_filtering)
+    {
+        update_filter_candidates();
+        set_filter(filter_query);
+        return;
+    }
 
-    std::shared_ptr<ImageButton> button = std::make_shared<ImageButton>(menu_window, size, color, icon->image);
-    button->set_border_color(EshyWMConfig::switcher_button_border_color);
-    
-    switcher_window_options.insert(switcher_window_options.begin(), {associated_window, button});
-    update_button_positions();
+    layout.insert(0, option_width(switcher_window_options[0]));
+    invalidate_layout();
 }
 
 void EshyWMSwitcher::remove_window_option(std::shared_ptr<EshyWMWindow> associated_window)
@@ -144,50 +237,107 @@ void EshyWMSwitcher::remove_window_option(std::shared_ptr<EshyWMWindow> associat
         if(switcher_window_options[i].window == associated_window)
         {
             switcher_window_options.erase(switcher_window_options.begin() + i);
-            update_button_positions();
+
+            if(b_filtering)
+            {
+                update_filter_candidates();
+                set_filter(filter_query);
+                break;
+            }
+
+            layout.erase(i);
+            invalidate_layout();
             break;
         }
     }
 }
 
-void EshyWMSwitcher::next_option()
+void EshyWMSwitcher::update_window_option_icon(std::shared_ptr<EshyWMWindow> associated_window, std::shared_ptr<CachedIcon> icon)
 {
-    selected_option = std::max(selected_option + 1, 0);
-    if(selected_option >= switcher_window_options.size())
+    for(int i = 0; i < switcher_window_options.size(); i++)
     {
-        selected_option = 0;
+        if(switcher_window_options[i].window != associated_window)
+            continue;
+
+        switcher_window_options[i].icon = icon;
+        update_option(i);
+        break;
     }
-    select_option(selected_option);
 }
 
-void EshyWMSwitcher::select_option(int i)
+void EshyWMSwitcher::update_window_option_thumbnail(Window frame)
+{
+    for(int i = 0; i < switcher_window_options.size(); i++)
+    {
+        if(switcher_window_options[i].window->get_frame() == frame)
+        {
+            update_option(i);
+            break;
+        }
+    }
+}
+
+void EshyWMSwitcher::update_option(int i)
 {
-    //Deselect previous
-    if(i == 0 && switcher_window_options[switcher_window_options.size() - 1].button)
+    const int cell = cell_of(i);
+    if(cell == -1)
+        return;
+
+    //An option of the same width only needs its own cell redrawn
+    const uint width = option_width(switcher_window_options[i]);
+    if(layout.get_width(cell) != width)
     {
-        if (!switcher_window_options[switcher_window_options.size() - 1].button)
-            return;
-        
-        X11::move_window(switcher_window_options[switcher_window_options.size() - 1].button->get_window(), Pos{get_button_x_position(switcher_window_options.size() - 1), (int)EshyWMConfig::switcher_button_padding});
-        X11::set_border_width(switcher_window_options[switcher_window_options.size() - 1].button->get_window(), 0);
+        layout.set_width(cell, width);
+        invalidate_layout();
     }
-    else if(i > 0 && switcher_window_options[i - 1].button)
+    else if(!b_needs_layout && layout.get_page(cell) == displayed_page)
     {
-        if (!switcher_window_options[i - 1].button)
-            return;
-        
-        X11::move_window(switcher_window_options[i - 1].button->get_window(), Pos{get_button_x_position(i - 1), (int)EshyWMConfig::switcher_button_padding});
-        X11::set_border_width(switcher_window_options[i - 1].button->get_window(), 0);
+        draw_option(cell);
+        present_option(cell);
     }
+}
 
-    if(switcher_window_options[i].button)
+int EshyWMSwitcher::cell_of(int option) const
+{
+    if(!b_filtering)
+        return option;
+
+    auto it = std::ranges::find(shown_options, option);
+    return it != shown_options.end() ? it - shown_options.begin() : -1;
+}
+
+void EshyWMSwitcher::next_option()
+{
+    if(layout.size() == 0)
+        return;
+
+    select_option((selected_option + 1) % layout.size());
+}
+
+void EshyWMSwitcher::select_option(int i)
+{
+    const int previous_option = selected_option;
+    selected_option = i;
+
+    if(b_needs_layout)
+        return;
+
+    //Flipping to another page redraws the page, otherwise only the two cells change
+    if(layout.get_page(selected_option) != displayed_page)
     {
-        if (!switcher_window_options[i].button)
-            return;
-        
-        X11::move_window(switcher_window_options[i].button->get_window(), Pos{get_button_x_position(i), (int)EshyWMConfig::switcher_button_padding});
-        X11::set_border_width(switcher_window_options[i].button->get_window(), 2);
+        displayed_page = layout.get_page(selected_option);
+        draw();
+        return;
     }
+
+    if(previous_option < layout.size() && layout.get_page(previous_option) == displayed_page)
+    {
+        draw_option(previous_option);
+        present_option(previous_option);
+    }
+
+    draw_option(selected_option);
+    present_option(selected_option);
 }
 
 void EshyWMSwitcher::handle_option_chosen(const int i)
@@ -205,12 +355,117 @@ void EshyWMSwitcher::handle_option_chosen(const int i)
 
     auto it = switcher_window_options.begin() + i;
     std::rotate(switcher_window_options.begin(), it, it + 1);
+
+    //A filtered layout is replaced with every option once the switcher closes
+    if(!b_filtering)
+        layout.move_to_front(i);
 }
 
 
 void EshyWMSwitcher::confirm_choice()
 {
-    handle_option_chosen(selected_option);
+    if(selected_option < layout.size())
+        handle_option_chosen(option_at(selected_option));
+
     remove();
+    if(b_keyboard_grabbed)
+        XUngrabKeyboard(X11::get_display(), CurrentTime);
+    b_keyboard_grabbed = false;
+    ThumbnailCache::set_active(false);
+
+    if(b_filtering)
+        set_filter("");
+
+    selected_option = 0;
+
+    //The chosen window moved to the front
+    b_needs_layout = true;
+}
+
+bool EshyWMSwitcher::filter_key_pressed(const XKeyEvent& event)
+{
+    if(!b_menu_active || !b_keyboard_grabbed)
+        return false;
+
+    char text[8];
+    KeySym key_sym;
+    const int length = XLookupString((XKeyEvent*)&event, text, sizeof(text), &key_sym, nullptr);
+
+    std::string query = filter_query;
+    if(key_sym == XK_BackSpace)
+    {
+        if(query.empty())
+            return true;
+
+        query.pop_back();
+    }
+    else if(key_sym == XK_Escape)
+    {
+        query.clear();
+    }
+    else if(length == 1 && text[0] >= ' ' && text[0] <= '~')
+    {
+        query += text[0];
+    }
+    else
+    {
+        return false;
+    }
+
+    if(query != filter_query)
+        set_filter(query);
+
+    return true;
+}
+
+void EshyWMSwitcher::set_filter(const std::string& query)
+{
+    //Candidates are taken when filtering starts, titles changing while typing do not move options around
+    if(!b_filtering && !query.empty())
+        update_filter_candidates();
+
+    filter_query = query;
+    b_filtering = !query.empty();
+    shown_options.clear();
+    layout.clear();
+
+    if(b_filtering)
+    {
+        for(const uint32_t i : matcher.set_query(query))
+        {
+            shown_options.push_back(i);
+            layout.insert(layout.size(), option_width(switcher_window_options[i]));
+        }
+    }
+    else
+    {
+        for(const switcher_option& option : switcher_window_options)
+            layout.insert(layout.size(), option_width(option));
+    }
+
+    //The best match is selected
     selected_option = 0;
-}
\ No newline at end of file
+    invalidate_layout();
+}
+
+void EshyWMSwitcher::reload_config()
+{
+    menu_color = EshyWMConfig::switcher_color;
+
+    //Option widths follow the button height, so every option is laid out again
+    set_filter(filter_query);
+}
+
+void EshyWMSwitcher::update_filter_candidates()
+{
+    std::vector<std::string> candidates;
+    candidates.reserve(switcher_window_options.size());
+
+    for(const switcher_option& option : switcher_window_options)
+    {
+        WindowPropertyCache& properties = option.window->get_properties();
+        candidates.push_back(properties.get_class() + " " + properties.get_name());
+    }
+
+    matcher.set_candidates(candidates);
+}
@@ -0,0 +1,200 @@
+#include "switcher_layout.h"
+
+#include <algorithm>
+
+SwitcherLayout::SwitcherLayout()
+    : padding(0)
+    , cell_height(0)
+    , bounds_width(0)
+    , bounds_height(0)
+    , offsets({0})
+    , widest_row(0)
+    , b_rows_dirty(true)
+{
+}
+
+void SwitcherLayout::set_metrics(uint new_padding, uint new_cell_height)
+{
+    if (padding == new_padding && cell_height == new_cell_height)
+        return;
+
+    padding = new_padding;
+    cell_height = new_cell_height;
+
+    for (size_t i = 0; i < widths.size(); ++i)
+        offsets[i + 1] = offsets[i] + widths[i] + padding;
+
+    b_rows_dirty = true;
+}
+
+bool SwitcherLayout::set_bounds(uint max_width, uint max_height)
+{
+    if (bounds_width == max_width && bounds_height == max_height)
+        return false;
+
+    bounds_width = max_width;
+    bounds_height = max_height;
+    b_rows_dirty = true;
+    return true;
+}
+
+void SwitcherLayout::shift_offsets(size_t first, long delta)
+{
+    for (size_t i = first; i < offsets.size(); ++i)
+        offsets[i] += delta;
+
+    b_rows_dirty = true;
+}
+
+void SwitcherLayout::insert(size_t i, uint width)
+{
+    widths.insert(widths.begin() + i, width);
+    offsets.insert(offsets.begin() + i, offsets[i]);
+    shift_offsets(i + 1, width + padding);
+}
+
+void SwitcherLayout::erase(size_t i)
+{
+    const long delta = offsets[i + 1] - offsets[i];
+    widths.erase(widths.begin() + i);
+    offsets.erase(offsets.begin() + i + 1);
+    shift_offsets(i + 1, -delta);
+}
+
+void SwitcherLayout::set_width(size_t i, uint width)
+{
+    const long delta = (long)width - widths[i];
+    widths[i] = width;
+    shift_offsets(i + 1, delta);
+}
+
+void SwitcherLayout::move_to_front(size_t i)
+{
+    if (i == 0 || i >= widths.size())
+        return;
+
+    //Only the options in front of it move
+    const uint delta = widths[i] + padding;
+    std::rotate(widths.begin(), widths.begin() + i, widths.begin() + i + 1);
+    for (size_t j = i; j > 0; --j)
+        offsets[j] = offsets[j - 1] + delta;
+
+    b_rows_dirty = true;
+}
+
+void SwitcherLayout::clear()
+{
+    widths.clear();
+    offsets.assign(1, 0);
+    b_rows_dirty = true;
+}
+
+void SwitcherLayout::update_rows() const
+{
+    if (!b_rows_dirty)
+        return;
+
+    b_rows_dirty = false;
+    row_starts.clear();
+    widest_row = 0;
+
+    const uint available_width = bounds_width > padding * 2 ? bounds_width - padding * 2 : 0;
+
+    for (size_t start = 0; start < widths.size();)
+    {
+        //A row from start to end fits if offsets[end] - padding - offsets[start] <= available_width
+        const uint limit = offsets[start] + available_width + padding;
+        size_t end = std::upper_bound(offsets.begin() + start + 1, offsets.end(), limit) - offsets.begin() - 1;
+
+        //An option wider than the bounds still gets a row of its own
+        end = std::max(end, start + 1);
+
+        row_starts.push_back(start);
+        widest_row = std::max(widest_row, offsets[end] - offsets[start] - padding);
+        start = end;
+    }
+}
+
+size_t SwitcherLayout::get_row(size_t i) const
+{
+    update_rows();
+    return std::upper_bound(row_starts.begin(), row_starts.end(), i) - row_starts.begin() - 1;
+}
+
+size_t SwitcherLayout::get_rows_per_page() const
+{
+    const uint row_height = cell_height + padding;
+    return std::max<size_t>(bounds_height > padding ? (bounds_height - padding) / row_height : 0, 1);
+}
+
+Rect SwitcherLayout::get_cell(size_t i) const
+{
+    const size_t row = get_row(i);
+    const size_t row_on_page = row % get_rows_per_page();
+
+    const int x = padding + offsets[i] - offsets[row_starts[row]];
+    const int y = padding + row_on_page * (cell_height + padding);
+    return {x, y, widths[i], cell_height};
+}
+
+size_t SwitcherLayout::get_page(size_t i) const
+{
+    return get_row(i) / get_rows_per_page();
+}
+
+size_t SwitcherLayout::get_page_count() const
+{
+    update_rows();
+    const size_t rows_per_page = get_rows_per_page();
+    return (row_starts.size() + rows_per_page - 1) / rows_per_page;
+}
+
+std::pair<size_t, size_t> SwitcherLayout::get_page_range(size_t page) const
+{
+    update_rows();
+    const size_t rows_per_page = get_rows_per_page();
+    const size_t first_row = page * rows_per_page;
+    const size_t end_row = first_row + rows_per_page;
+
+    if (first_row >= row_starts.size())
+        return {widths.size(), widths.size()};
+
+    return {row_starts[first_row], end_row < row_starts.size() ? row_starts[end_row] : widths.size()};
+}
+
+Size SwitcherLayout::get_page_size() const
+{
+    update_rows();
+    const size_t rows = std::min(row_starts.size(), get_rows_per_page());
+
+    const uint width = widest_row + padding * 2;
+    const uint height = std::max<size_t>(rows, 1) * (cell_height + padding) + padding;
+    return {width, height};
+}
+
+int SwitcherLayout::find_option(size_t page, int x, int y) const
+{
+    const auto [first, last] = get_page_range(page);
+    if (first == last)
+        return -1;
+
+    const size_t rows_per_page = get_rows_per_page();
+    const int row_on_page = (y - (int)padding) / (int)(cell_height + padding);
+    if (y < (int)padding || row_on_page >= (int)rows_per_page)
+        return -1;
+
+    const size_t row = page * rows_per_page + row_on_page;
+    if (row >= row_starts.size())
+        return -1;
+
+    //Same search as the row breaks, the last option starting at or before x
+    const size_t row_start = row_starts[row];
+    const size_t row_end = row + 1 < row_starts.size() ? row_starts[row + 1] : widths.size();
+    const long row_x = (long)x - padding + offsets[row_start];
+    if (row_x < (long)offsets[row_start])
+        return -1;
+
+    const size_t i = std::upper_bound(offsets.begin() + row_start, offsets.begin() + row_end, (uint)row_x) - offsets.begin() - 1;
+    const Rect cell = get_cell(i);
+    return (x < cell.x + (int)cell.width && y < cell.y + (int)cell.height) ? i : -1;
+}
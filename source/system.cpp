@@ -1,70 +1,213 @@
-
 #include "system.h"
-#include "window_manager.h"
-#include "eshywm.h"
+#include "event_loop.h"
+#include "util.h"
 
-#include <iostream>
+#include <linux/netlink.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <fcntl.h>
 #include <unistd.h>
-#include <memory>
-#include <array>
-#include <string.h>
-#include <thread>
+
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <string_view>
 
 using namespace std::chrono_literals;
 
-EPowerSupplyStatus System::power_supply_status = POWER_SUPPLY_STATUS_UNKNOWN;
-int System::battery_percentage = 100;
-std::chrono::_V2::system_clock::time_point System::current_time;
+namespace fs = std::filesystem;
+
+static const fs::path POWER_SUPPLY_PATH = "/sys/class/power_supply";
+
+//Attribute files of the supplies in use, -1 if there is none
+static int battery_status_fd = -1;
+static int battery_capacity_fd = -1;
+static int ac_online_fd = -1;
+static std::string battery_name;
+
+static int uevent_fd = -1;
+static EventLoop::TimerHandle capacity_timer = 0;
+
+static std::atomic<std::shared_ptr<const PowerSnapshot>> power = std::make_shared<const PowerSnapshot>();
+
+static void close_fd(int& fd)
+{
+    if (fd != -1)
+        close(fd);
+
+    fd = -1;
+}
+
+//The whole attribute without the trailing newline, empty if it cannot be read
+static std::string read_attribute(int fd)
+{
+    if (fd == -1)
+        return "";
+
+    char buffer[64];
+    const ssize_t length = pread(fd, buffer, sizeof(buffer), 0);
+    if (length <= 0)
+        return "";
+
+    std::string_view value(buffer, length);
+    while (!value.empty() && (value.back() == '\n' || value.back() == ' '))
+        value.remove_suffix(1);
+
+    return std::string(value);
+}
+
+static std::string read_attribute(const fs::path& path)
+{
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    const std::string value = read_attribute(fd);
+    if (fd != -1)
+        close(fd);
 
-std::thread poll_thread;
-bool b_poll = false;
+    return value;
+}
 
-static char* exec(const char* command)
+static EPowerSupplyStatus parse_status(std::string_view status)
 {
-    char buffer[128];
-    char* result = (char*)calloc(sizeof(buffer), sizeof(char));
-    FILE* pipe(popen(command, "r"));
+    if (status == POWER_SUPPLY_STATUS_CHARGING_IDENTIFIER)
+        return POWER_SUPPLY_STATUS_CHARGING;
+    else if (status == POWER_SUPPLY_STATUS_DISCHARGING_IDENTIFIER)
+        return POWER_SUPPLY_STATUS_DISCHARGING;
+    else if (status == POWER_SUPPLY_STATUS_NOT_CHARGING_IDENTIFIER)
+        return POWER_SUPPLY_STATUS_NOT_CHARGING;
+    else if (status == POWER_SUPPLY_STATUS_FULL_IDENTIFIER)
+        return POWER_SUPPLY_STATUS_FULL;
 
-    if(!pipe)
-        throw std::runtime_error("popen() failed!");
+    return POWER_SUPPLY_STATUS_UNKNOWN;
+}
 
-    while (fgets(buffer, sizeof(buffer), pipe))
-        strcat(result, buffer);
+//Peripherals like mice report their battery here too, only the ones powering the system are used
+static void find_power_supplies()
+{
+    close_fd(battery_status_fd);
+    close_fd(battery_capacity_fd);
+    close_fd(ac_online_fd);
+    battery_name.clear();
 
-    pclose(pipe);
+    std::error_code error;
+    for (const fs::directory_entry& supply : fs::directory_iterator(POWER_SUPPLY_PATH, error))
+    {
+        const std::string type = read_attribute(supply.path() / "type");
+        const std::string scope = read_attribute(supply.path() / "scope");
+        if (scope == "Device")
+            continue;
 
-    return result;
+        if (type == "Battery" && battery_status_fd == -1)
+        {
+            battery_status_fd = open((supply.path() / "status").c_str(), O_RDONLY | O_CLOEXEC);
+            battery_capacity_fd = open((supply.path() / "capacity").c_str(), O_RDONLY | O_CLOEXEC);
+            battery_name = supply.path().filename();
+        }
+        else if (type == "Mains" && ac_online_fd == -1)
+        {
+            ac_online_fd = open((supply.path() / "online").c_str(), O_RDONLY | O_CLOEXEC);
+        }
+    }
 }
 
-void System::begin_polling()
+static void update_power()
 {
-    b_poll = true;
-    poll_thread = std::thread(&System::poll_system_info);
+    std::shared_ptr<PowerSnapshot> snapshot = std::make_shared<PowerSnapshot>();
+    snapshot->battery_name = battery_name;
+    snapshot->status = parse_status(read_attribute(battery_status_fd));
+    snapshot->b_on_ac = read_attribute(ac_online_fd) == "1";
+
+    const std::string capacity = read_attribute(battery_capacity_fd);
+    int percentage;
+    if (std::from_chars(capacity.data(), capacity.data() + capacity.size(), percentage).ec == std::errc() && !capacity.empty())
+        snapshot->battery_percentage = percentage;
+
+    const std::shared_ptr<const PowerSnapshot> current = power.load();
+    if (current->status == snapshot->status && current->battery_percentage == snapshot->battery_percentage
+        && current->b_on_ac == snapshot->b_on_ac && current->battery_name == snapshot->battery_name)
+        return;
+
+    power.store(std::move(snapshot));
 }
 
-void System::end_polling()
+/**
+ * A uevent is a header like change@/devices/.../power_supply/BAT0 followed by KEY=value pairs, all null terminated.
+ * Only the power_supply subsystem is of interest, added or removed supplies mean the files have to be found again.
+*/
+static void handle_uevents(uint32_t events)
 {
-    b_poll = false;
+    bool b_changed = false;
+    bool b_supplies_changed = false;
+
+    char buffer[8192];
+    ssize_t length;
+    while ((length = recv(uevent_fd, buffer, sizeof(buffer), 0)) > 0)
+    {
+        std::string_view action;
+        bool b_power_supply = false;
+
+        for (std::string_view message(buffer, length); !message.empty();)
+        {
+            const std::string_view field = message.substr(0, message.find('\0'));
+            message.remove_prefix(std::min(field.size() + 1, message.size()));
+
+            if (field.starts_with("ACTION="))
+                action = field.substr(7);
+            else if (field == "SUBSYSTEM=power_supply")
+                b_power_supply = true;
+        }
+
+        if (!b_power_supply)
+            continue;
+
+        b_changed = true;
+        b_supplies_changed |= action == "add" || action == "remove";
+    }
+
+    if (b_supplies_changed)
+        find_power_supplies();
+
+    if (b_changed)
+        update_power();
 }
 
-void System::poll_system_info()
+
+void System::initialize()
 {
-    while(b_poll)
+    find_power_supplies();
+    update_power();
+
+    sockaddr_nl address = {};
+    address.nl_family = AF_NETLINK;
+    address.nl_pid = 0;
+    //The kernel's own uevents, udev rebroadcasts them on other groups
+    address.nl_groups = 1;
+
+    uevent_fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+    if (uevent_fd == -1 || bind(uevent_fd, (sockaddr*)&address, sizeof(address)) == -1 || !EventLoop::add_fd(uevent_fd, EPOLLIN, &handle_uevents))
     {
-        const char* charging_status = exec("cat /sys/class/power_supply/BAT0/status");
-        if(charging_status == POWER_SUPPLY_STATUS_NOT_CHARGING_IDENTIFIER)
-            power_supply_status = POWER_SUPPLY_STATUS_NOT_CHARGING;
-        else if(charging_status == POWER_SUPPLY_STATUS_CHARGING_IDENTIFIER)
-            power_supply_status = POWER_SUPPLY_STATUS_CHARGING;
-        else if(charging_status == POWER_SUPPLY_STATUS_DISCHARGING_IDENTIFIER)
-            power_supply_status = POWER_SUPPLY_STATUS_DISCHARGING;
-        else if(charging_status == POWER_SUPPLY_STATUS_FULL_IDENTIFIER)
-            power_supply_status = POWER_SUPPLY_STATUS_FULL;
-        else
-            power_supply_status = POWER_SUPPLY_STATUS_UNKNOWN;
-
-        battery_percentage = std::stoi(exec("cat /sys/class/power_supply/BAT0/capacity"));
-        current_time = std::chrono::system_clock::now();
-        std::this_thread::sleep_for(500ms);
+        LOGE("Failed to listen for power supply uevents, only the capacity will be updated");
+        close_fd(uevent_fd);
     }
-}
\ No newline at end of file
+
+    capacity_timer = EventLoop::add_timer(60s, 60s, &update_power);
+}
+
+void System::shutdown()
+{
+    EventLoop::remove_timer(capacity_timer);
+    capacity_timer = 0;
+
+    if (uevent_fd != -1)
+        EventLoop::remove_fd(uevent_fd);
+
+    close_fd(uevent_fd);
+    close_fd(battery_status_fd);
+    close_fd(battery_capacity_fd);
+    close_fd(ac_online_fd);
+}
+
+std::shared_ptr<const PowerSnapshot> System::get_power()
+{
+    return power.load();
+}
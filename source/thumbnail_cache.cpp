@@ -0,0 +1,278 @@
+#include "thumbnail_cache.h"
+#include "config.h"
+#include "event_loop.h"
+#include "X11.h"
+
+#include <X11/extensions/Xcomposite.h>
+#include <X11/extensions/Xdamage.h>
+#include <X11/extensions/Xrender.h>
+
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+struct thumbnail_entry
+{
+    Thumbnail thumbnail;
+    Picture picture = None;
+    Damage damage = None;
+    bool b_damaged = true;
+};
+
+static std::unordered_map<Window, thumbnail_entry> thumbnails;
+static ThumbnailCache::ThumbnailChanged thumbnail_changed;
+
+static bool b_enabled = false;
+static bool b_active = false;
+static int damage_event_base = 0;
+
+static EventLoop::TimerHandle refresh_timer = 0;
+static std::chrono::steady_clock::time_point last_refresh;
+
+static int ignore_error(Display* display, XErrorEvent* event)
+{
+    return 0;
+}
+
+static void free_thumbnail(thumbnail_entry& entry)
+{
+    Display* display = X11::get_display();
+
+    if (entry.picture != None)
+        XRenderFreePicture(display, entry.picture);
+
+    if (entry.thumbnail.pixmap != None)
+        XFreePixmap(display, entry.thumbnail.pixmap);
+
+    entry.picture = None;
+    entry.thumbnail = {};
+}
+
+//Returns true if the thumbnail was redrawn
+static bool render_thumbnail(Window frame, thumbnail_entry& entry)
+{
+    Display* display = X11::get_display();
+
+    XWindowAttributes attributes;
+    if (!XGetWindowAttributes(display, frame, &attributes) || attributes.map_state != IsViewable)
+        return false;
+
+    XRenderPictFormat* format = XRenderFindVisualFormat(display, attributes.visual);
+    if (!format)
+        return false;
+
+    //The named pixmap includes the border
+    const uint frame_width = attributes.width + attributes.border_width * 2;
+    const uint frame_height = attributes.height + attributes.border_width * 2;
+    if (frame_width == 0 || frame_height == 0)
+        return false;
+
+    const uint height = EshyWMConfig::switcher_button_height;
+    const uint width = std::clamp<uint>((uint64_t)frame_width * height / frame_height, height / 2, height * 2);
+
+    if (entry.thumbnail.size.width != width || entry.thumbnail.size.height != height)
+    {
+        free_thumbnail(entry);
+
+        const int screen = DefaultScreen(display);
+        entry.thumbnail.pixmap = XCreatePixmap(display, X11::get_root_window(), width, height, DefaultDepth(display, screen));
+        entry.thumbnail.size = {width, height};
+        entry.picture = XRenderCreatePicture(display, entry.thumbnail.pixmap, XRenderFindVisualFormat(display, DefaultVisual(display, screen)), 0, nullptr);
+    }
+
+    const Pixmap frame_pixmap = XCompositeNameWindowPixmap(display, frame);
+
+    XRenderPictureAttributes picture_attributes;
+    picture_attributes.subwindow_mode = IncludeInferiors;
+    const Picture source = XRenderCreatePicture(display, frame_pixmap, format, CPSubwindowMode, &picture_attributes);
+
+    //Scaling happens on the server, the transform maps thumbnail coordinates back onto the frame
+    XTransform transform = {{
+        {XDoubleToFixed((double)frame_width / width), 0, 0},
+        {0, XDoubleToFixed((double)frame_height / height), 0},
+        {0, 0, XDoubleToFixed(1.0)}
+    }};
+    XRenderSetPictureTransform(display, source, &transform);
+    XRenderSetPictureFilter(display, source, FilterBilinear, nullptr, 0);
+
+    //Frames with an alpha channel are composited over the switcher button color like icons are
+    const ulong background = EshyWMConfig::switcher_button_color;
+    const XRenderColor background_color = {(unsigned short)((background >> 16 & 0xFF) * 0x101), (unsigned short)((background >> 8 & 0xFF) * 0x101), (unsigned short)((background & 0xFF) * 0x101), 0xFFFF};
+    const bool b_has_alpha = format->type == PictTypeDirect && format->direct.alphaMask;
+
+    if (b_has_alpha)
+        XRenderFillRectangle(display, PictOpSrc, entry.picture, &background_color, 0, 0, width, height);
+
+    XRenderComposite(display, b_has_alpha ? PictOpOver : PictOpSrc, source, None, entry.picture, 0, 0, 0, 0, 0, 0, width, height);
+
+    XRenderFreePicture(display, source);
+    XFreePixmap(display, frame_pixmap);
+    return true;
+}
+
+static void refresh_damaged()
+{
+    refresh_timer = 0;
+    last_refresh = std::chrono::steady_clock::now();
+
+    Display* display = X11::get_display();
+    std::vector<Window> changed;
+
+    /**
+     * A frame can be unmapped or destroyed between the damage event and the refresh, which would make the requests
+     * below fail. Those errors are expected and are kept away from the regular handler.
+    */
+    XSync(display, False);
+    const XErrorHandler previous_handler = XSetErrorHandler(ignore_error);
+
+    for (auto& [frame, entry] : thumbnails)
+    {
+        if (!entry.b_damaged)
+            continue;
+
+        //Damage is reported again once the frame changes after this
+        entry.b_damaged = false;
+        XDamageSubtract(display, entry.damage, None, None);
+
+        if (render_thumbnail(frame, entry))
+            changed.push_back(frame);
+    }
+
+    XSync(display, False);
+    XSetErrorHandler(previous_handler);
+
+    for (const Window frame : changed)
+        thumbnail_changed(frame);
+}
+
+static void schedule_refresh()
+{
+    if (refresh_timer != 0)
+        return;
+
+    const std::chrono::milliseconds interval(EshyWMConfig::switcher_thumbnail_refresh_interval);
+    const auto since_last_refresh = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - last_refresh);
+    refresh_timer = EventLoop::add_timer(std::max(interval - since_last_refresh, 0ms), 0ms, refresh_damaged);
+}
+
+
+bool ThumbnailCache::initialize(ThumbnailChanged _thumbnail_changed)
+{
+    if (!EshyWMConfig::switcher_thumbnails)
+        return false;
+
+    Display* display = X11::get_display();
+    int event_base;
+    int error_base;
+    int major = 0;
+    int minor = 2;
+
+    //NameWindowPixmap needs Composite 0.2
+    if (!XCompositeQueryExtension(display, &event_base, &error_base) || !XCompositeQueryVersion(display, &major, &minor) || (major == 0 && minor < 2))
+    {
+        LOGE("Window thumbnails need the Composite extension");
+        return false;
+    }
+
+    if (!XDamageQueryExtension(display, &damage_event_base, &error_base) || !XRenderQueryExtension(display, &event_base, &error_base))
+    {
+        LOGE("Window thumbnails need the Damage and Render extensions");
+        return false;
+    }
+
+    thumbnail_changed = _thumbnail_changed;
+    b_enabled = true;
+    return true;
+}
+
+void ThumbnailCache::shutdown()
+{
+    if (!b_enabled)
+        return;
+
+    EventLoop::remove_timer(refresh_timer);
+    refresh_timer = 0;
+
+    for (auto& [frame, entry] : thumbnails)
+        free_thumbnail(entry);
+
+    thumbnails.clear();
+    b_enabled = false;
+}
+
+bool ThumbnailCache::is_enabled()
+{
+    return b_enabled;
+}
+
+void ThumbnailCache::add_window(Window frame)
+{
+    if (!b_enabled)
+        return;
+
+    //Automatic redirection keeps the server painting the frame to the screen as before
+    Display* display = X11::get_display();
+    XCompositeRedirectWindow(display, frame, CompositeRedirectAutomatic);
+
+    thumbnail_entry& entry = thumbnails[frame];
+    entry.damage = XDamageCreate(display, frame, XDamageReportNonEmpty);
+}
+
+void ThumbnailCache::remove_window(Window frame)
+{
+    auto it = thumbnails.find(frame);
+    if (it == thumbnails.end())
+        return;
+
+    //The frame is destroyed right after this, which ends the redirection
+    XDamageDestroy(X11::get_display(), it->second.damage);
+
+    free_thumbnail(it->second);
+    thumbnails.erase(it);
+}
+
+bool ThumbnailCache::handle_event(const XEvent& event)
+{
+    if (!b_enabled || event.type != damage_event_base + XDamageNotify)
+        return false;
+
+    const XDamageNotifyEvent& damage_event = (const XDamageNotifyEvent&)event;
+
+    auto it = thumbnails.find(damage_event.drawable);
+    if (it == thumbnails.end())
+        return true;
+
+    it->second.b_damaged = true;
+
+    if (b_active)
+        schedule_refresh();
+
+    return true;
+}
+
+void ThumbnailCache::set_active(bool _b_active)
+{
+    if (!b_enabled || b_active == _b_active)
+        return;
+
+    b_active = _b_active;
+
+    if (b_active)
+    {
+        refresh_damaged();
+    }
+    else
+    {
+        EventLoop::remove_timer(refresh_timer);
+        refresh_timer = 0;
+    }
+}
+
+const Thumbnail* ThumbnailCache::get_thumbnail(Window frame)
+{
+    auto it = thumbnails.find(frame);
+    return (it != thumbnails.end() && it->second.thumbnail.pixmap != None) ? &it->second.thumbnail : nullptr;
+}
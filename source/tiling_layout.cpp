@@ -0,0 +1,367 @@
+#include "tiling_layout.h"
+#include "config.h"
+#include "flat_hash_map.h"
+
+#include <algorithm>
+
+static bool is_same_rect(const Rect& a, const Rect& b)
+{
+    return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+}
+
+//Splits rect in two along its longer side, first gets ratio of it
+static std::pair<Rect, Rect> split_rect(const Rect& rect, float ratio)
+{
+    if (rect.width >= rect.height)
+    {
+        const uint first_width = rect.width * ratio;
+        return {{rect.x, rect.y, first_width, rect.height}, {rect.x + (int)first_width, rect.y, rect.width - first_width, rect.height}};
+    }
+
+    const uint first_height = rect.height * ratio;
+    return {{rect.x, rect.y, rect.width, first_height}, {rect.x, rect.y + (int)first_height, rect.width, rect.height - first_height}};
+}
+
+
+/**
+ * The first window takes tiling_master_ratio of the width, the rest share the column on the right.
+ * Adding or removing a window below the master only lays out the stack column again.
+*/
+class MasterStackLayout : public TilingLayout
+{
+public:
+
+    virtual ELayoutType get_type() const override {return LT_MasterStack;}
+
+    virtual void add_window(std::shared_ptr<EshyWMWindow> window, const EshyWMWindow* next_to) override
+    {
+        const auto it = std::ranges::find_if(windows, [next_to](const auto& tiled_window){return tiled_window.get() == next_to;});
+        const size_t i = it == windows.end() ? windows.size() : it - windows.begin() + 1;
+        windows.insert(windows.begin() + i, window);
+
+        //The second window splits the master's space
+        if (windows.size() <= 2)
+            arrange_all();
+        else
+            arrange_stack();
+    }
+
+    virtual bool remove_window(const EshyWMWindow* window) override
+    {
+        const auto it = std::ranges::find_if(windows, [window](const auto& tiled_window){return tiled_window.get() == window;});
+        if (it == windows.end())
+            return false;
+
+        const bool b_was_master = it == windows.begin();
+        windows.erase(it);
+
+        //The first window of the stack is the new master, the last one takes the whole width
+        if (b_was_master || windows.size() <= 1)
+            arrange_all();
+        else
+            arrange_stack();
+
+        return true;
+    }
+
+    virtual std::vector<std::shared_ptr<EshyWMWindow>> get_windows() const override {return windows;}
+
+protected:
+
+    virtual void arrange_all() override
+    {
+        if (windows.empty())
+            return;
+
+        set_tile(windows[0], windows.size() == 1 ? bounds : get_master_cell());
+        arrange_stack();
+    }
+
+private:
+
+    std::vector<std::shared_ptr<EshyWMWindow>> windows;
+
+    Rect get_master_cell() const
+    {
+        const float ratio = std::clamp(EshyWMConfig::tiling_master_ratio, 0.1f, 0.9f);
+        return {bounds.x, bounds.y, (uint)(bounds.width * ratio), bounds.height};
+    }
+
+    void arrange_stack()
+    {
+        if (windows.size() < 2)
+            return;
+
+        const Rect master = get_master_cell();
+        const int stack_x = bounds.x + master.width;
+        const uint stack_width = bounds.width - master.width;
+        const uint n_stacked = windows.size() - 1;
+
+        //The last window takes what the division leaves over
+        for (uint i = 0; i < n_stacked; ++i)
+        {
+            const int y = bounds.y + bounds.height * i / n_stacked;
+            const int next_y = bounds.y + bounds.height * (i + 1) / n_stacked;
+            set_tile(windows[i + 1], {stack_x, y, stack_width, (uint)(next_y - y)});
+        }
+    }
+};
+
+/**
+ * Every window is a leaf of a binary tree and every inner node splits its space in half along the longer side.
+ * A new window splits the leaf of the window it is placed after, and a removed window's sibling takes over the
+ * parent's space, so only that subtree is laid out again.
+*/
+class BspLayout : public TilingLayout
+{
+public:
+
+    virtual ELayoutType get_type() const override {return LT_BSP;}
+
+    virtual void add_window(std::shared_ptr<EshyWMWindow> window, const EshyWMWindow* next_to) override
+    {
+        if (!root)
+        {
+            root = std::make_unique<bsp_node>();
+            root->window = window;
+            root->geometry = bounds;
+            leaves.insert_or_assign(window.get(), root.get());
+            arrange(root.get());
+            return;
+        }
+
+        bsp_node* const* next_to_leaf = next_to ? leaves.find(next_to) : nullptr;
+        bsp_node* split = next_to_leaf ? *next_to_leaf : get_last_leaf();
+
+        //The split leaf becomes an inner node with its window first and the new one second
+        split->children[0] = std::make_unique<bsp_node>(bsp_node{split->window, {}, split});
+        split->children[1] = std::make_unique<bsp_node>(bsp_node{window, {}, split});
+        split->window = nullptr;
+
+        leaves.insert_or_assign(split->children[0]->window.get(), split->children[0].get());
+        leaves.insert_or_assign(window.get(), split->children[1].get());
+        arrange(split);
+    }
+
+    virtual bool remove_window(const EshyWMWindow* window) override
+    {
+        bsp_node* const* found_leaf = leaves.find(window);
+        if (!found_leaf)
+            return false;
+
+        bsp_node* leaf = *found_leaf;
+        leaves.erase(window);
+
+        bsp_node* parent = leaf->parent;
+        if (!parent)
+        {
+            root.reset();
+            return true;
+        }
+
+        //The sibling is pulled up into the parent, which keeps its geometry
+        std::unique_ptr<bsp_node> sibling = std::move(parent->children[parent->children[0].get() == leaf ? 1 : 0]);
+        parent->window = std::move(sibling->window);
+        parent->children[0] = std::move(sibling->children[0]);
+        parent->children[1] = std::move(sibling->children[1]);
+
+        if (parent->window)
+            leaves.insert_or_assign(parent->window.get(), parent);
+
+        for (std::unique_ptr<bsp_node>& child : parent->children)
+        {
+            if (child)
+                child->parent = parent;
+        }
+
+        arrange(parent);
+        return true;
+    }
+
+    virtual std::vector<std::shared_ptr<EshyWMWindow>> get_windows() const override
+    {
+        std::vector<std::shared_ptr<EshyWMWindow>> windows;
+        collect_windows(root.get(), windows);
+        return windows;
+    }
+
+protected:
+
+    virtual void arrange_all() override
+    {
+        if (!root)
+            return;
+
+        root->geometry = bounds;
+        arrange(root.get());
+    }
+
+private:
+
+    struct bsp_node
+    {
+        //Only set on leaves
+        std::shared_ptr<EshyWMWindow> window;
+        std::unique_ptr<bsp_node> children[2];
+        bsp_node* parent = nullptr;
+        Rect geometry = {0};
+    };
+
+    std::unique_ptr<bsp_node> root;
+    FlatHashMap<const EshyWMWindow*, bsp_node*> leaves;
+
+    bsp_node* get_last_leaf() const
+    {
+        bsp_node* node = root.get();
+        while (!node->window)
+            node = node->children[1].get();
+
+        return node;
+    }
+
+    void arrange(bsp_node* node)
+    {
+        if (node->window)
+        {
+            set_tile(node->window, node->geometry);
+            return;
+        }
+
+        std::tie(node->children[0]->geometry, node->children[1]->geometry) = split_rect(node->geometry, 0.5f);
+        arrange(node->children[0].get());
+        arrange(node->children[1].get());
+    }
+
+    static void collect_windows(const bsp_node* node, std::vector<std::shared_ptr<EshyWMWindow>>& windows)
+    {
+        if (!node)
+            return;
+
+        if (node->window)
+            windows.push_back(node->window);
+
+        collect_windows(node->children[0].get(), windows);
+        collect_windows(node->children[1].get(), windows);
+    }
+};
+
+//Every window takes the whole workspace, focusing one raises it above the others
+class MonocleLayout : public TilingLayout
+{
+public:
+
+    virtual ELayoutType get_type() const override {return LT_Monocle;}
+
+    virtual void add_window(std::shared_ptr<EshyWMWindow> window, const EshyWMWindow* next_to) override
+    {
+        const auto it = std::ranges::find_if(windows, [next_to](const auto& tiled_window){return tiled_window.get() == next_to;});
+        windows.insert(it == windows.end() ? it : it + 1, window);
+        set_tile(window, bounds);
+    }
+
+    virtual bool remove_window(const EshyWMWindow* window) override
+    {
+        const auto it = std::ranges::find_if(windows, [window](const auto& tiled_window){return tiled_window.get() == window;});
+        if (it == windows.end())
+            return false;
+
+        windows.erase(it);
+        return true;
+    }
+
+    virtual std::vector<std::shared_ptr<EshyWMWindow>> get_windows() const override {return windows;}
+
+protected:
+
+    virtual void arrange_all() override
+    {
+        for (const std::shared_ptr<EshyWMWindow>& window : windows)
+            set_tile(window, bounds);
+    }
+
+private:
+
+    std::vector<std::shared_ptr<EshyWMWindow>> windows;
+};
+
+
+void TilingLayout::set_bounds(const Rect& new_bounds)
+{
+    if (is_same_rect(bounds, new_bounds))
+        return;
+
+    bounds = new_bounds;
+    arrange_all();
+}
+
+void TilingLayout::relayout()
+{
+    arrange_all();
+}
+
+void TilingLayout::apply()
+{
+    if (changed_tiles.empty())
+        return;
+
+    tile_windows(changed_tiles);
+    changed_tiles.clear();
+}
+
+void TilingLayout::set_tile(const std::shared_ptr<EshyWMWindow>& window, const Rect& cell)
+{
+    //Inner edges take half the gap each and workspace edges the whole gap, so tiles are one gap apart and one gap from the edge
+    const uint gap = std::min<uint>(EshyWMConfig::tiling_gap, std::min(cell.width, cell.height) / 4);
+    const uint left = cell.x == bounds.x ? gap : gap / 2;
+    const uint top = cell.y == bounds.y ? gap : gap / 2;
+    const uint right = cell.x + cell.width == bounds.x + bounds.width ? gap : gap - gap / 2;
+    const uint bottom = cell.y + cell.height == bounds.y + bounds.height ? gap : gap - gap / 2;
+    const Rect tile = {cell.x + (int)left, cell.y + (int)top, cell.width - left - right, cell.height - top - bottom};
+
+    //A window moved twice before apply() keeps only its last tile
+    const auto queued = std::ranges::find_if(changed_tiles, [&window](const window_tile& changed_tile){return changed_tile.window == window;});
+    if (queued != changed_tiles.end())
+    {
+        queued->geometry = tile;
+        return;
+    }
+
+    if (!is_same_rect(get_window_tile(window.get()), tile))
+        changed_tiles.push_back({window, tile});
+}
+
+
+std::shared_ptr<TilingLayout> create_tiling_layout(ELayoutType layout_type, const Rect& bounds)
+{
+    std::shared_ptr<TilingLayout> layout;
+    switch (layout_type)
+    {
+    case LT_MasterStack:
+        layout = std::make_shared<MasterStackLayout>();
+        break;
+    case LT_BSP:
+        layout = std::make_shared<BspLayout>();
+        break;
+    case LT_Monocle:
+        layout = std::make_shared<MonocleLayout>();
+        break;
+    default:
+        return nullptr;
+    }
+
+    layout->set_bounds(bounds);
+    return layout;
+}
+
+ELayoutType parse_layout_type(std::string_view name)
+{
+    return name == "master_stack" ? LT_MasterStack
+        : name == "bsp" ? LT_BSP
+        : name == "monocle" ? LT_Monocle
+        : LT_Floating;
+}
+
+ELayoutType next_layout_type(ELayoutType layout_type)
+{
+    return (ELayoutType)((layout_type + 1) % (LT_Monocle + 1));
+}
@@ -0,0 +1,159 @@
+#include "timer_wheel.h"
+
+#include <algorithm>
+#include <bit>
+
+TimerWheel::TimerWheel(uint64_t _current_tick)
+    : current_tick(_current_tick)
+    , next_handle(1)
+{
+}
+
+TimerWheel::Handle TimerWheel::add(uint64_t interval_ticks, std::function<void()> callback)
+{
+    interval_ticks = std::max<uint64_t>(interval_ticks, 1);
+
+    const Handle handle = next_handle++;
+    timer& new_timer = timers[handle];
+    new_timer.interval = interval_ticks;
+    new_timer.expiry = (current_tick / interval_ticks + 1) * interval_ticks;
+    new_timer.callback = std::move(callback);
+
+    insert(handle, new_timer);
+    return handle;
+}
+
+void TimerWheel::remove(Handle handle)
+{
+    auto it = timers.find(handle);
+    if (it == timers.end())
+        return;
+
+    unlink(handle, it->second);
+    timers.erase(it);
+}
+
+void TimerWheel::insert(Handle handle, timer& timer)
+{
+    const uint64_t expiry = std::clamp(timer.expiry, current_tick, current_tick + MAX_DISTANCE);
+
+    //The lowest level where the expiry and the current tick share every higher slot
+    uint level_index = 0;
+    while (level_index + 1 < LEVEL_COUNT && (expiry >> (SLOT_BITS * (level_index + 1))) != (current_tick >> (SLOT_BITS * (level_index + 1))))
+        level_index++;
+
+    timer.level = level_index;
+    timer.slot = (expiry >> (SLOT_BITS * level_index)) & (SLOT_COUNT - 1);
+
+    level& level = levels[timer.level];
+    level.slots[timer.slot].push_back(handle);
+    level.occupied |= 1ull << timer.slot;
+}
+
+void TimerWheel::unlink(Handle handle, const timer& timer)
+{
+    level& level = levels[timer.level];
+    std::vector<Handle>& slot = level.slots[timer.slot];
+
+    std::erase(slot, handle);
+    if (slot.empty())
+        level.occupied &= ~(1ull << timer.slot);
+}
+
+//Moves the timers in the slot the current tick just entered down to the levels below
+void TimerWheel::cascade(uint level_index)
+{
+    level& level = levels[level_index];
+    const uint slot_index = (current_tick >> (SLOT_BITS * level_index)) & (SLOT_COUNT - 1);
+
+    std::vector<Handle> handles = std::move(level.slots[slot_index]);
+    level.slots[slot_index].clear();
+    level.occupied &= ~(1ull << slot_index);
+
+    for (const Handle handle : handles)
+        insert(handle, timers[handle]);
+}
+
+void TimerWheel::advance(uint64_t tick)
+{
+    for (; current_tick <= tick; current_tick++)
+    {
+        //Nothing can expire before the next occupied tick, so idle stretches are skipped
+        const std::optional<uint64_t> next_tick = get_next_tick();
+        if (!next_tick || *next_tick > tick)
+        {
+            current_tick = tick + 1;
+            break;
+        }
+
+        current_tick = *next_tick;
+
+        for (uint level_index = LEVEL_COUNT - 1; level_index > 0; level_index--)
+        {
+            if ((current_tick & ((1ull << (SLOT_BITS * level_index)) - 1)) == 0)
+                cascade(level_index);
+        }
+
+        const uint slot_index = current_tick & (SLOT_COUNT - 1);
+        std::vector<Handle> due = std::move(levels[0].slots[slot_index]);
+        levels[0].slots[slot_index].clear();
+        levels[0].occupied &= ~(1ull << slot_index);
+
+        //Rescheduled before running so callbacks can remove their own timer. A timer runs once per advance, the
+        //intervals it missed if the wheel is advanced late are skipped
+        std::vector<Handle> expired;
+        for (const Handle handle : due)
+        {
+            timer& due_timer = timers[handle];
+            if (due_timer.expiry <= current_tick)
+            {
+                expired.push_back(handle);
+                do due_timer.expiry += due_timer.interval;
+                while (due_timer.expiry <= tick);
+            }
+
+            insert(handle, due_timer);
+        }
+
+        for (const Handle handle : expired)
+        {
+            auto it = timers.find(handle);
+            if (it != timers.end())
+                it->second.callback();
+        }
+    }
+}
+
+std::optional<uint64_t> TimerWheel::get_next_tick() const
+{
+    std::optional<uint64_t> next_tick;
+
+    for (uint level_index = 0; level_index < LEVEL_COUNT; level_index++)
+    {
+        const uint shift = SLOT_BITS * level_index;
+        const uint current_slot = (current_tick >> shift) & (SLOT_COUNT - 1);
+
+        //Higher levels only hold slots after the current one, unless the wheel is at the start of the current
+        //slot and its timers have not been moved down yet. That makes the current tick the next one for them.
+        const bool b_current_slot_pending = (current_tick & ((1ull << shift) - 1)) == 0;
+        const uint first_slot = b_current_slot_pending ? current_slot : current_slot + 1;
+        const uint64_t later_slots = first_slot < SLOT_COUNT ? ~0ull << first_slot : 0;
+        const uint64_t rotation = current_tick >> (shift + SLOT_BITS) << (shift + SLOT_BITS);
+
+        if (const uint64_t candidates = levels[level_index].occupied & later_slots)
+            next_tick = std::min(next_tick.value_or(UINT64_MAX), rotation | (uint64_t)std::countr_zero(candidates) << shift);
+
+        //Expiries past the end of the top level's rotation wrap around to the slots before the current one.
+        //Lower levels never wrap, a timer only goes into them once it shares the slot above with the current tick.
+        if (level_index + 1 == LEVEL_COUNT)
+        {
+            if (const uint64_t wrapped = levels[level_index].occupied & ~later_slots)
+            {
+                const uint64_t next_rotation = rotation + (1ull << (shift + SLOT_BITS));
+                next_tick = std::min(next_tick.value_or(UINT64_MAX), next_rotation | (uint64_t)std::countr_zero(wrapped) << shift);
+            }
+        }
+    }
+
+    return next_tick;
+}
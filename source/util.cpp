@@ -27,14 +27,15 @@ void __log_message(LogSeverity severity, const char* message, ...)
 
 	if (FILE* file = fopen("/home/eshy/log.txt", "a"))
 	{
+		//Formatted once, the result is written as is. Long messages are cut off instead of overflowing.
 		char _message[4096];
 		va_list ap;
 		va_start(ap, message);
-		vsprintf(_message, message, ap);
+		vsnprintf(_message, sizeof(_message), message, ap);
 		va_end(ap);
 
-		fprintf(file, _message);
-		fprintf(file, "\n");
+		fputs(_message, file);
+		fputs("\n", file);
 		fclose(file);
 	}
 	
@@ -9,7 +9,10 @@
 #include "switcher.h"
 #include "util.h"
 #include "X11.h"
-#include "image.h"
+#include "icon_cache.h"
+#include "font_manager.h"
+#include "thumbnail_cache.h"
+#include "tiling_layout.h"
 
 #include <algorithm>
 #include <cstring>
@@ -22,35 +25,54 @@ constexpr int half_of(const int x)
     return x / 2;
 }
 
-EshyWMWindow::EshyWMWindow(Window _window)
-    : window(_window)
+//Icons loaded in the background are handed over by client XID since the window may be gone by then
+static IconCache::IconLoaded icon_loaded_callback(Window client)
+{
+    return [client](std::shared_ptr<CachedIcon> icon)
+    {
+        if (std::shared_ptr<EshyWMWindow> window = EshyWM::window_manager->contains_xwindow(client))
+        {
+            window->set_icon(icon);
+            EshyWM::window_icon_changed_notify(window);
+        }
+    };
+}
+
+static button_color_data get_close_button_color()
+{
+    return button_color_data{ EshyWMConfig::titlebar_button_normal_color, EshyWMConfig::close_button_color, EshyWMConfig::titlebar_button_pressed_color };
+}
+
+EshyWMWindow::EshyWMWindow(const X11::WindowPrefetch& prefetch)
+    : window(prefetch.window)
+    , properties(prefetch.window)
     , parent_workspace(nullptr)
     , b_show_titlebar(false)
-    , window_icon(nullptr)
     , window_font(nullptr)
     , frame_geometry({})
     , pre_state_change_geometry({})
+    , tile_geometry({})
     , window_state(WS_NONE)
     , close_button(nullptr)
 {
-    window_icon = X11::retrieve_window_icon(window);
-    if (!window_icon)
-        window_icon = new Image(EshyWMConfig::default_application_image_path.c_str());
-    
-    imlib_add_path_to_font_path("/usr/share/fonts/TTF");
-    window_font = imlib_load_font("Lato-Regular/14");
+    properties.seed(prefetch);
+
+    window_icon = IconCache::get_icon(prefetch, icon_loaded_callback(window));
+    window_font = FontManager::get_font("Lato-Regular", 14);
 }
 
 EshyWMWindow::~EshyWMWindow()
 {
+    free_titlebar_cache();
     delete close_button;
-    delete window_icon;
 }
 
-void EshyWMWindow::initialize(const X11::WindowAttributes& attributes)
+void EshyWMWindow::initialize(const X11::WindowPrefetch& prefetch)
 {
+    const X11::WindowAttributes& attributes = prefetch.attributes;
+
     //Center window on the output the cursor is in
-    const auto [cursor_x, cursor_y] = X11::get_cursor_position();
+    const auto [cursor_x, cursor_y] = prefetch.cursor_position;
     auto output = output_at_position(cursor_x, cursor_y);
     assert(output && output->active_workspace);
     parent_workspace = output->active_workspace;
@@ -69,8 +91,7 @@ void EshyWMWindow::initialize(const X11::WindowAttributes& attributes)
     X11::set_input_masks(window, PointerMotionMask | StructureNotifyMask | PropertyChangeMask);
 
     //If window was previously maximized when it was closed, then maximize again. Otherwise center and clamp size
-    const X11::WindowProperty class_property = X11::get_window_property(window, X11::atoms.window_class);
-    const std::string window_name = class_property.property_value == nullptr ? "NONE" : std::string((const char*)class_property.property_value);
+    const std::string window_name = properties.get_class().empty() ? "NONE" : properties.get_class();
     const bool b_begin_maximized = EshyWMConfig::window_close_data.contains(window_name) && EshyWMConfig::window_close_data[window_name] == "maximized";
     maximize_window(b_begin_maximized);
 }
@@ -83,9 +104,10 @@ void EshyWMWindow::frame_window()
     X11::reparent_window(window, frame, offset);
 
     //In EshyWM, we set frame class to match the window to support compositors
-    if (const X11::WindowProperty class_property = X11::get_window_property(window, X11::atoms.window_class))
-        X11::change_window_property(frame, X11::atoms.window_class, XA_STRING, 8, (unsigned char*)class_property.property_value);
+    if (!properties.get_class().empty())
+        X11::change_window_property(frame, X11::atoms.window_class, XA_STRING, 8, (const unsigned char*)properties.get_class().c_str());
 
+    ThumbnailCache::add_window(frame);
     X11::map_window(frame);
 
     const auto titlebar_geometry = Rect{ 0, 0, frame_geometry.width, EshyWMConfig::titlebar_height };
@@ -93,10 +115,10 @@ void EshyWMWindow::frame_window()
     X11::reparent_window(titlebar, frame, { 0 });
 
     const auto initial_size = Rect{ 0, 0, EshyWMConfig::titlebar_button_size, EshyWMConfig::titlebar_button_size };
-    const auto close_button_color = button_color_data{ EshyWMConfig::titlebar_button_normal_color, EshyWMConfig::close_button_color, EshyWMConfig::titlebar_button_pressed_color };
-    close_button = new ImageButton(titlebar, initial_size, close_button_color, EshyWMConfig::close_button_image_path.c_str());
+    close_button = new ImageButton(titlebar, initial_size, get_close_button_color(), EshyWMConfig::close_button_image_path.c_str());
     close_button->click_callback = std::bind(std::mem_fn(&EshyWMWindow::close_window), this);
 
+    title = properties.get_name();
     set_show_titlebar(EshyWMConfig::titlebar);
 
     XFlush(X11::get_display());
@@ -106,8 +128,13 @@ void EshyWMWindow::frame_window()
 void EshyWMWindow::unframe_window()
 {
     X11::reparent_window(window, X11::get_root_window(), { 0 });
+    ThumbnailCache::remove_window(frame);
     X11::destroy_window(frame);
     X11::destroy_window(titlebar);
+
+    //The titlebar is gone, so nothing may draw to it anymore
+    b_show_titlebar = false;
+    free_titlebar_cache();
 }
 
 
@@ -119,6 +146,7 @@ void EshyWMWindow::set_window_state(EWindowState new_window_state)
         {WS_MINIMIZED, "minimized"},
         {WS_MAXIMIZED, "maximized"},
         {WS_FULLSCREEN, "fullscreen"},
+        {WS_TILED, "tiled"},
         {WS_ANCHORED_LEFT, "anchored_left"},
         {WS_ANCHORED_UP, "anchored_up"},
         {WS_ANCHORED_RIGHT, "anchored_right"},
@@ -153,6 +181,8 @@ void EshyWMWindow::minimize_window(bool b_minimize)
             maximize_window(true);
         else if (window_state == WS_FULLSCREEN)
             fullscreen_window(true);
+        else if (window_state == WS_TILED)
+            tile_window(tile_geometry);
         else if (window_state >= WS_ANCHORED_LEFT)
             anchor_window(window_state);
     }
@@ -164,7 +194,7 @@ void EshyWMWindow::maximize_window(bool b_maximize)
     {
         fullscreen_window(false);
 
-        if (window_state == WS_NORMAL)
+        if (window_state == WS_NORMAL || window_state == WS_TILED)
             pre_state_change_geometry = frame_geometry;
 
         move_window_absolute(parent_workspace->geometry.x, parent_workspace->geometry.y, true);
@@ -178,6 +208,10 @@ void EshyWMWindow::maximize_window(bool b_maximize)
         move_window_absolute(pre_state_change_geometry.x, pre_state_change_geometry.y, true);
         resize_window_absolute(pre_state_change_geometry.width, pre_state_change_geometry.height, true);
         set_window_state(previous_state);
+
+        //The layout may have moved the tile while the window was maximized
+        if (window_state == WS_TILED)
+            tile_window(tile_geometry);
     }
 }
 
@@ -185,7 +219,7 @@ void EshyWMWindow::fullscreen_window(bool b_fullscreen)
 {
     if (b_fullscreen && window_state != WS_FULLSCREEN)
     {
-        if (window_state == WS_NORMAL)
+        if (window_state == WS_NORMAL || window_state == WS_TILED)
             pre_state_change_geometry = frame_geometry;
 
         set_show_titlebar(false);
@@ -211,6 +245,8 @@ void EshyWMWindow::fullscreen_window(bool b_fullscreen)
             window_state = WS_NONE;
             fullscreen_window(true);
         }
+        else if (window_state == WS_TILED)
+            tile_window(tile_geometry);
         else if (window_state >= WS_ANCHORED_LEFT)
             anchor_window(window_state);
     }
@@ -218,6 +254,9 @@ void EshyWMWindow::fullscreen_window(bool b_fullscreen)
 
 void EshyWMWindow::close_window()
 {
+    //While the frame still exists
+    parent_workspace->remove_tiled_window(this);
+
     X11::unmap_window(window);
     unframe_window();
 
@@ -226,9 +265,9 @@ void EshyWMWindow::close_window()
         X11::kill_window(window);
     }
 
-    if (const X11::WindowProperty property = X11::get_window_property(window, X11::atoms.window_class))
+    if (!properties.get_class().empty())
     {
-        EshyWMConfig::add_window_close_state((const char*)property.property_value, get_window_state() == EWindowState::WS_MAXIMIZED ? "maximized" : "normal");
+        EshyWMConfig::add_window_close_state(properties.get_class(), get_window_state() == EWindowState::WS_MAXIMIZED ? "maximized" : "normal");
     }
 }
 
@@ -241,6 +280,10 @@ void EshyWMWindow::anchor_window(EWindowState anchor, std::shared_ptr<Output> ou
         return;
     }
 
+    //Anchoring takes the window out of the layout
+    if (window_state == WS_TILED)
+        parent_workspace->remove_tiled_window(this);
+
     if (window_state == WS_NORMAL)
         pre_state_change_geometry = frame_geometry;
 
@@ -397,6 +440,10 @@ void EshyWMWindow::move_window_absolute(int new_position_x, int new_position_y,
             fullscreen_window(false);
         else if (window_state >= WS_ANCHORED_LEFT)
             anchor_window(WS_NORMAL);
+
+        //Moving a tiled window by hand makes it float
+        if (window_state == WS_TILED)
+            parent_workspace->remove_tiled_window(this);
     }
 
     frame_geometry.x = new_position_x;
@@ -418,6 +465,9 @@ void EshyWMWindow::resize_window_absolute(uint new_size_x, uint new_size_y, bool
             maximize_window(false);
         else if (window_state == WS_FULLSCREEN)
             fullscreen_window(false);
+
+        if (window_state == WS_TILED)
+            parent_workspace->remove_tiled_window(this);
     }
 
     frame_geometry.width = new_size_x;
@@ -438,6 +488,73 @@ void EshyWMWindow::resize_window_absolute(uint new_size_x, uint new_size_y, bool
 }
 
 
+void EshyWMWindow::tile_window(const Rect& tile)
+{
+    tile_geometry = tile;
+
+    //The window takes its tile once it leaves the state, which restores previous_state. A minimized window that was maximized or fullscreen comes back as it was
+    if (window_state == WS_MINIMIZED || window_state == WS_MAXIMIZED || window_state == WS_FULLSCREEN)
+    {
+        if (window_state != WS_MINIMIZED || (previous_state != WS_MAXIMIZED && previous_state != WS_FULLSCREEN))
+            previous_state = WS_TILED;
+        return;
+    }
+
+    if (window_state != WS_TILED)
+        set_window_state(WS_TILED);
+
+    //The border is drawn outside the frame
+    const uint border_width = EshyWM::window_manager->b_show_window_borders ? EshyWMConfig::window_frame_border_width : 0;
+    const uint titlebar_height = b_show_titlebar ? EshyWMConfig::titlebar_height : 0;
+    const Rect new_frame_geometry = {tile.x, tile.y, std::max(tile.width, border_width * 2 + 1) - border_width * 2, std::max(tile.height, border_width * 2 + titlebar_height + 1) - border_width * 2};
+
+    const bool b_resized = new_frame_geometry.width != frame_geometry.width || new_frame_geometry.height != frame_geometry.height;
+    frame_geometry = new_frame_geometry;
+
+    //One request for the frame instead of a move and a resize
+    X11::move_resize_window(frame, frame_geometry);
+    if (!b_resized)
+        return;
+
+    X11::resize_window(window, Size{ frame_geometry.width, frame_geometry.height - titlebar_height });
+    if (b_show_titlebar)
+    {
+        X11::resize_window(titlebar, Size{ frame_geometry.width, titlebar_height });
+        update_titlebar();
+    }
+}
+
+void EshyWMWindow::untile_window()
+{
+    tile_geometry = {};
+
+    if (window_state == WS_TILED)
+        set_window_state(WS_NORMAL);
+    else if (previous_state == WS_TILED)
+        previous_state = WS_NORMAL;
+}
+
+bool EshyWMWindow::is_tileable()
+{
+    const std::vector<Atom>& window_type = properties.get_window_type();
+    return window_type.empty() || std::ranges::contains(window_type, X11::atoms.window_type_normal);
+}
+
+Rect get_window_tile(const EshyWMWindow* window)
+{
+    return window->get_tile_geometry();
+}
+
+void tile_windows(const std::vector<window_tile>& tiles)
+{
+    for (const window_tile& tile : tiles)
+        tile.window->tile_window(tile.geometry);
+
+    //Every configure request of the relayout goes out in one write
+    X11::flush();
+}
+
+
 void EshyWMWindow::set_show_border(bool b_show_border)
 {
     if (b_show_border)
@@ -449,6 +566,10 @@ void EshyWMWindow::set_show_border(bool b_show_border)
     {
         X11::set_border_width(frame, 0);
     }
+
+    //The tile stays the same, the frame inside it changes
+    if (window_state == WS_TILED)
+        tile_window(tile_geometry);
 }
 
 void EshyWMWindow::set_show_titlebar(bool b_new_show_titlebar)
@@ -470,6 +591,53 @@ void EshyWMWindow::set_show_titlebar(bool b_new_show_titlebar)
         X11::move_window(window, Pos{ 0 });
         resize_window_absolute(frame_geometry.width, frame_geometry.height, true);
     }
+
+    if (window_state == WS_TILED)
+        tile_window(tile_geometry);
+}
+
+void EshyWMWindow::update_titlebar_layout()
+{
+    //Fullscreen windows get the titlebar back when they leave fullscreen
+    if (window_state != WS_FULLSCREEN)
+        set_show_titlebar(EshyWMConfig::titlebar);
+
+    free_titlebar_cache();
+    close_button->set_size(EshyWMConfig::titlebar_button_size, EshyWMConfig::titlebar_button_size);
+    close_button->set_button_color(get_close_button_color());
+    close_button->set_image(EshyWMConfig::close_button_image_path.c_str());
+
+    //The frame keeps its size, the client gets what the titlebar leaves of it
+    const uint titlebar_height = b_show_titlebar ? EshyWMConfig::titlebar_height : 0;
+    X11::move_window(window, Pos{ 0, (int)titlebar_height });
+    resize_window_absolute(frame_geometry.width, std::max(frame_geometry.height, titlebar_height + 1) - titlebar_height, true);
+}
+
+void EshyWMWindow::update_title()
+{
+    const std::string& new_title = properties.get_name();
+    if (new_title == title)
+        return;
+
+    title = new_title;
+    update_titlebar();
+}
+
+void EshyWMWindow::update_icon()
+{
+    set_icon(IconCache::reload_icon(X11::prefetch_window_icon(window), icon_loaded_callback(window)));
+}
+
+void EshyWMWindow::set_icon(std::shared_ptr<CachedIcon> new_icon)
+{
+    if (window_icon == new_icon)
+        return;
+
+    window_icon = new_icon;
+
+    //The icon is part of the cached titlebar
+    free_titlebar_cache();
+    update_titlebar();
 }
 
 void EshyWMWindow::update_titlebar()
@@ -477,40 +645,76 @@ void EshyWMWindow::update_titlebar()
     if (!EshyWMConfig::titlebar || !b_show_titlebar)
         return;
 
-    XClearWindow(X11::get_display(), titlebar);
+    //The content is left aligned on a flat background, so a wider pixmap looks the same once cropped.
+    //Rounding the width up means an interactive resize only rerenders every few hundred pixels.
+    const uint pixmap_width = (frame_geometry.width + 255) & ~255u;
 
-    if (window_font)
-    {
-        XTextProperty name;
-        XGetWMName(X11::get_display(), window, &name);
-        const auto display_name = (char*)name.value;
+    //The title gets everything between the icon and the close button, long titles are cut down to fit.
+    //The space is rounded down so the cut, and with it the cached titlebar, only changes every 32 pixels of a resize.
+    const int button_y_offset = (EshyWMConfig::titlebar_height - EshyWMConfig::titlebar_button_size) / 2;
+    const int close_button_x = (frame_geometry.width - EshyWMConfig::titlebar_button_size) - button_y_offset;
+    const int title_x = EshyWMConfig::titlebar_height + 8;
+    const int title_width = std::max(close_button_x - title_x - 8, 0) & ~31;
+    const std::string display_title = FontManager::ellipsize_text(window_font, title, title_width);
+
+    if (titlebar_cache.pixmap == None || titlebar_cache.width != pixmap_width || titlebar_cache.title != display_title)
+        render_titlebar(pixmap_width, display_title);
+
+    Display* display = X11::get_display();
+    XCopyArea(display, titlebar_cache.pixmap, titlebar, DefaultGC(display, DefaultScreen(display)), 0, 0, frame_geometry.width, EshyWMConfig::titlebar_height, 0, 0);
+
+    close_button->set_position(close_button_x, button_y_offset);
+    close_button->draw();
+}
+
+void EshyWMWindow::render_titlebar(uint pixmap_width, const std::string& display_title)
+{
+    Display* display = X11::get_display();
+
+    if (titlebar_cache.width != pixmap_width)
+        free_titlebar_cache();
 
-        Imlib_Image buffer = imlib_create_image(frame_geometry.width, EshyWMConfig::titlebar_height);
+    if (titlebar_cache.pixmap == None)
+        titlebar_cache.pixmap = XCreatePixmap(display, titlebar, pixmap_width, EshyWMConfig::titlebar_height, DefaultDepth(display, DefaultScreen(display)));
 
-        imlib_context_set_image(buffer);
-        imlib_context_set_font(window_font);
+    titlebar_cache.width = pixmap_width;
+    titlebar_cache.title = display_title;
 
-        const ulong backgound_color = EshyWMConfig::window_background_color;
-        const int r = backgound_color >> 16 & 0xFF;
-        const int g = backgound_color >> 8 & 0xFF;
-        const int b = backgound_color & 0xFF;
-        imlib_context_set_color(r, g, b, 255);
-        imlib_image_fill_rectangle(0, 0, frame_geometry.width, EshyWMConfig::titlebar_height);
+    Imlib_Image buffer = imlib_create_image(pixmap_width, EshyWMConfig::titlebar_height);
+    imlib_context_set_image(buffer);
 
+    const ulong backgound_color = EshyWMConfig::window_background_color;
+    const int r = backgound_color >> 16 & 0xFF;
+    const int g = backgound_color >> 8 & 0xFF;
+    const int b = backgound_color & 0xFF;
+    imlib_context_set_color(r, g, b, 255);
+    imlib_image_fill_rectangle(0, 0, pixmap_width, EshyWMConfig::titlebar_height);
+
+    if (window_font)
+    {
+        imlib_context_set_font(window_font->font);
         imlib_context_set_color(255, 255, 255, 255);
-        imlib_text_draw(EshyWMConfig::titlebar_height + 8, 0, display_name);
+        imlib_text_draw(EshyWMConfig::titlebar_height + 8, 0, display_title.c_str());
+    }
 
-        imlib_context_set_drawable(titlebar);
+    //The icon is already scaled to fit and opaque
+    if (window_icon->titlebar.image)
+    {
+        const int icon_size = IconCache::get_titlebar_icon_size();
         imlib_context_set_blend(0);
-        imlib_render_image_on_drawable(0, 0);
-
-        XFree(name.value);
+        imlib_blend_image_onto_image(window_icon->titlebar.image, 0, 0, 0, icon_size, icon_size, 8, 4, icon_size, icon_size);
     }
 
-    if (window_icon)
-        window_icon->draw(titlebar, 8, 4, EshyWMConfig::titlebar_height - 8, EshyWMConfig::titlebar_height - 8);
+    imlib_context_set_drawable(titlebar_cache.pixmap);
+    imlib_context_set_blend(0);
+    imlib_render_image_on_drawable(0, 0);
+    imlib_free_image();
+}
 
-    const int button_y_offset = (EshyWMConfig::titlebar_height - EshyWMConfig::titlebar_button_size) / 2;
-    close_button->set_position((frame_geometry.width - EshyWMConfig::titlebar_button_size) - button_y_offset, button_y_offset);
-    close_button->draw();
+void EshyWMWindow::free_titlebar_cache()
+{
+    if (titlebar_cache.pixmap != None)
+        XFreePixmap(X11::get_display(), titlebar_cache.pixmap);
+
+    titlebar_cache = {};
 }
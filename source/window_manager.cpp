@@ -2,8 +2,11 @@
 #include "eshywm.h"
 #include "window.h"
 #include "switcher.h"
+#include "status_bar.h"
 #include "button.h"
 #include "X11.h"
+#include "launcher.h"
+#include "thumbnail_cache.h"
 
 #include <X11/Xutil.h>
 #include <X11/Xatom.h>
@@ -33,11 +36,13 @@ void WindowManager::initialize()
     X11::atoms.supported = XInternAtom(display, "_NET_SUPPORTED", False);
     X11::atoms.active_window = XInternAtom(display, "_NET_ACTIVE_WINDOW", False);
     X11::atoms.window_name = XInternAtom(display, "WM_NAME", False);
+    X11::atoms.net_wm_name = XInternAtom(display, "_NET_WM_NAME", False);
     X11::atoms.window_class = XInternAtom(display, "WM_CLASS", False);
     X11::atoms.wm_protocols = XInternAtom(display, "WM_PROTOCOLS", False);
     X11::atoms.wm_delete_window = XInternAtom(display, "WM_DELETE_WINDOW", False);
     X11::atoms.window_type = XInternAtom(display, "_NET_WM_WINDOW_TYPE", False);
     X11::atoms.window_type_dock = XInternAtom(display, "_NET_WM_WINDOW_TYPE_DOCK", False);
+    X11::atoms.window_type_normal = XInternAtom(display, "_NET_WM_WINDOW_TYPE_NORMAL", False);
     X11::atoms.window_icon = XInternAtom(display, "_NET_WM_ICON", False);
     X11::atoms.window_icon_name = XInternAtom(display, "WM_ICON_NAME", False);
     X11::atoms.state = XInternAtom(display, "_NET_WM_STATE", False);
@@ -50,7 +55,10 @@ void WindowManager::initialize()
     X11::set_input_masks(DefaultRootWindow(display), PointerMotionMask | SubstructureRedirectMask | StructureNotifyMask | SubstructureNotifyMask);
     XSync(display, false);
 
+    update_key_actions();
+    build_key_action_table();
     grab_keys();
+    grab_buttons();
     scan_outputs();
 
     const int XC_left_ptr_code = 68;
@@ -68,6 +76,9 @@ void WindowManager::initialize()
     {
         workspaces.emplace_back(std::make_shared<Workspace>( i + (int)outputs.size(), nullptr ));
     }
+
+    for (auto workspace : workspaces)
+        workspace->set_layout(parse_layout_type(EshyWMConfig::tiling_layout));
 }
 
 void WindowManager::handle_events()
@@ -131,6 +142,12 @@ void WindowManager::handle_events()
         case ClientMessage:
             OnClientMessage(event.xclient);
             break;
+        case MappingNotify:
+            OnMappingNotify(event.xmapping);
+            break;
+        default:
+            ThumbnailCache::handle_event(event);
+            break;
         };
     }
 }
@@ -150,84 +167,185 @@ void WindowManager::handle_preexisting_windows()
 
     const X11::WindowTree top_level_windows = X11::query_window_tree(X11::get_root_window());
     assert(top_level_windows.status);
-    for(Window window : top_level_windows.windows)
+    for(const X11::WindowPrefetch& prefetch : X11::prefetch_windows(top_level_windows.windows, true))
     {
-        if (window == SWITCHER->get_menu_window())
+        if (prefetch.window == SWITCHER->get_menu_window())
             continue;
 
-        register_window(window, true);
-        X11::map_window(window);
+        register_window(prefetch, true);
+        X11::map_window(prefetch.window);
     }
 
     X11::ungrab_server();
 }
 
+//Lock and NumLock are grabbed with every combination, so they are left out of the table
+static constexpr uint KEY_ACTION_MODIFIERS = ShiftMask | ControlMask | Mod1Mask | Mod3Mask | Mod4Mask | Mod5Mask;
+
+static inline uint32_t key_action_key(uint keycode, uint modifiers)
+{
+    return keycode << 8 | (modifiers & KEY_ACTION_MODIFIERS);
+}
+
+void WindowManager::update_key_actions()
+{
+    key_actions.clear();
+
+    const auto add_action = [this](KeySym key_sym, uint modifiers, std::function<void()> callback, bool b_window_action = false)
+    {
+        key_actions.push_back({key_sym, modifiers, std::move(callback), b_window_action});
+    };
+
+    //The switcher is confirmed when Alt is released, see EshyWMSwitcher
+    add_action(XK_Tab, Mod1Mask, []()
+    {
+        SWITCHER->show();
+        SWITCHER->next_option();
+    });
+
+    add_action(XK_e, Mod4Mask, [](){ EshyWM::b_terminate = true; });
+    add_action(XK_space, Mod4Mask, [this]()
+    {
+        //Cycles floating, master and stack, bsp and monocle on the workspace under the cursor
+        const Pos cursor_position = X11::get_cursor_position();
+        if (auto output = output_at_position(cursor_position.x, cursor_position.y); output && output->active_workspace)
+            output->active_workspace->set_layout(next_layout_type(output->active_workspace->get_layout_type()));
+    });
+    add_action(XK_t, Mod4Mask, [this]()
+    {
+        EshyWMConfig::titlebar = !EshyWMConfig::titlebar;
+        for(auto window : window_list)
+            window->set_show_titlebar(EshyWMConfig::titlebar);
+    });
+    add_action(XK_b, Mod4Mask, [this]()
+    {
+        b_show_window_borders = !b_show_window_borders;
+        for(auto window : window_list)
+            window->set_show_border(b_show_window_borders);
+    });
+
+    //Workspace controls
+    for(int i = 0; i < 9; ++i)
+    {
+        add_action(XK_1 + i, Mod4Mask, [this, i]()
+        {
+            const Pos cursor_position = X11::get_cursor_position();
+            if (auto output = output_at_position(cursor_position.x, cursor_position.y))
+            {
+                for (auto workspace : workspaces | std::views::filter([i](auto workspace) {return workspace->num == i;}))
+                    output->activate_workspace(workspace);
+            }
+        });
+    }
+
+    /**WINDOW MANAGEMENT*/
+
+    //Basic functions
+    add_action(XK_c, Mod4Mask, [this](){ focused_window->close_window(); }, true);
+    add_action(XK_d, Mod4Mask, [this](){ focused_window->toggle_maximize(); }, true);
+    add_action(XK_f, Mod4Mask, [this](){ focused_window->toggle_fullscreen(); }, true);
+    add_action(XK_a, Mod4Mask, [this](){ focused_window->toggle_minimize(); }, true);
+
+    //Anchors, moving monitors, moving and resizing with the arrow keys
+    struct arrow_key
+    {
+        KeySym key_sym;
+        EWindowState direction;
+        int x;
+        int y;
+    };
+
+    static constexpr arrow_key arrow_keys[] = {
+        {XK_Left, WS_ANCHORED_LEFT, -1, 0},
+        {XK_Up, WS_ANCHORED_UP, 0, -1},
+        {XK_Right, WS_ANCHORED_RIGHT, 1, 0},
+        {XK_Down, WS_ANCHORED_DOWN, 0, 1}
+    };
+
+    for(const arrow_key& arrow : arrow_keys)
+    {
+        add_action(arrow.key_sym, Mod4Mask, [this, arrow](){ focused_window->anchor_window(arrow.direction); }, true);
+        add_action(arrow.key_sym, Mod4Mask | ShiftMask, [this, arrow](){ focused_window->attempt_shift_monitor(arrow.direction); }, true);
+        add_action(arrow.key_sym, Mod4Mask | ControlMask, [this, arrow]()
+        {
+            const int x = manipulating_window_geometry.x + arrow.x * EshyWMConfig::window_x_movement_step;
+            const int y = manipulating_window_geometry.y + arrow.y * EshyWMConfig::window_y_movement_step;
+            focused_window->move_window_absolute(x, y, false);
+        }, true);
+        add_action(arrow.key_sym, Mod4Mask | ShiftMask | ControlMask, [this, arrow]()
+        {
+            const int width = std::max((int)manipulating_window_geometry.width + arrow.x * EshyWMConfig::window_width_resize_step, 10);
+            const int height = std::max((int)manipulating_window_geometry.height + arrow.y * EshyWMConfig::window_height_resize_step, 10);
+            focused_window->resize_window_absolute(width, height, false);
+        }, true);
+    }
+
+    for(const EshyWMConfig::KeyBinding& key_binding : EshyWMConfig::key_bindings)
+    {
+        add_action(key_binding.key_sym, key_binding.modifiers, [command = key_binding.command](){ Launcher::spawn(command); });
+    }
+}
+
+void WindowManager::build_key_action_table()
+{
+    Display* display = X11::get_display();
+    key_action_table.clear();
+
+    for(uint32_t i = 0; i < key_actions.size(); i++)
+    {
+        const KeyCode keycode = XKeysymToKeycode(display, key_actions[i].key_sym);
+        if(keycode != 0)
+            key_action_table.insert_or_assign(key_action_key(keycode, key_actions[i].modifiers), i);
+    }
+
+    switcher_confirm_keycode = XKeysymToKeycode(display, XK_Alt_L);
+}
+
 void WindowManager::grab_keys()
 {
     const Window root = X11::get_root_window();
 
-    for(EshyWMConfig::KeyBinding key_binding : EshyWMConfig::key_bindings)
+    for(const key_action& action : key_actions)
+    {
+        X11::grab_key(action.key_sym, action.modifiers, root);
+    }
+}
+
+void WindowManager::update_key_bindings(const std::vector<EshyWMConfig::KeyBinding>& removed, const std::vector<EshyWMConfig::KeyBinding>& added)
+{
+    const Window root = X11::get_root_window();
+    update_key_actions();
+
+    //Keys that are still used by another action keep their grab
+    for(const EshyWMConfig::KeyBinding& key_binding : removed)
     {
-        X11::grab_key(key_binding.key, Mod4Mask, root);
+        const bool b_still_grabbed = std::ranges::any_of(key_actions, [&](const key_action& action){ return action.key_sym == key_binding.key_sym && action.modifiers == key_binding.modifiers; });
+        if(!b_still_grabbed)
+            X11::ungrab_key(key_binding.key_sym, key_binding.modifiers, root);
     }
 
-    X11::grab_key(XK_e | XK_E, Mod4Mask, root);
-    X11::grab_key(XK_t | XK_T, Mod4Mask, root);
-    X11::grab_key(XK_b | XK_B, Mod4Mask, root);
+    for(const EshyWMConfig::KeyBinding& key_binding : added)
+    {
+        X11::grab_key(key_binding.key_sym, key_binding.modifiers, root);
+    }
 
-    //Workspace controls
-    X11::grab_key(XK_1, Mod4Mask, root);
-    X11::grab_key(XK_2, Mod4Mask, root);
-    X11::grab_key(XK_3, Mod4Mask, root);
-    X11::grab_key(XK_4, Mod4Mask, root);
-    X11::grab_key(XK_5, Mod4Mask, root);
-    X11::grab_key(XK_6, Mod4Mask, root);
-    X11::grab_key(XK_7, Mod4Mask, root);
-    X11::grab_key(XK_8, Mod4Mask, root);
-    X11::grab_key(XK_9, Mod4Mask, root);
+    build_key_action_table();
+}
 
-    /**WINDOW MANAGEMENT*/
+void WindowManager::ungrab_keys()
+{
+    XUngrabKey(X11::get_display(), AnyKey, AnyModifier, X11::get_root_window());
+}
+
+void WindowManager::grab_buttons()
+{
+    const Window root = X11::get_root_window();
 
     //Basic movement and resizing
     XGrabButton(X11::get_display(), Button1, AnyModifier, root, false, ButtonPressMask | ButtonReleaseMask, GrabModeSync, GrabModeAsync, None, None);
     XGrabButton(X11::get_display(), Button3, AnyModifier, root, false, ButtonPressMask, GrabModeSync, GrabModeAsync, None, None);
     X11::grab_button(Button1, Mod4Mask, root, ButtonMotionMask);
     X11::grab_button(Button3, Mod4Mask, root, ButtonMotionMask);
-
-    //Basic functions
-    X11::grab_key(XK_c | XK_C, Mod4Mask, root);
-    X11::grab_key(XK_d | XK_D, Mod4Mask, root);
-    X11::grab_key(XK_f | XK_F, Mod4Mask, root);
-    X11::grab_key(XK_a | XK_A, Mod4Mask, root);
-
-    //Anchors
-    X11::grab_key(XK_Left, Mod4Mask, root);
-    X11::grab_key(XK_Up, Mod4Mask, root);
-    X11::grab_key(XK_Right, Mod4Mask, root);
-    X11::grab_key(XK_Down, Mod4Mask, root);
-
-    //Move monitors
-    X11::grab_key(XK_Left, Mod4Mask | ShiftMask, root);
-    X11::grab_key(XK_Up, Mod4Mask | ShiftMask, root);
-    X11::grab_key(XK_Right, Mod4Mask | ShiftMask, root);
-    X11::grab_key(XK_Down, Mod4Mask | ShiftMask, root);
-
-    //Move window
-    X11::grab_key(XK_Left, Mod4Mask | ControlMask, root);
-    X11::grab_key(XK_Up, Mod4Mask | ControlMask, root);
-    X11::grab_key(XK_Right, Mod4Mask | ControlMask, root);
-    X11::grab_key(XK_Down, Mod4Mask | ControlMask, root);
-
-    //Resize window
-    X11::grab_key(XK_Left, Mod4Mask | ShiftMask | ControlMask, root);
-    X11::grab_key(XK_Up, Mod4Mask | ShiftMask | ControlMask, root);
-    X11::grab_key(XK_Right, Mod4Mask | ShiftMask | ControlMask, root);
-    X11::grab_key(XK_Down, Mod4Mask | ShiftMask | ControlMask, root);
-}
-
-void WindowManager::ungrab_keys()
-{
-    X11::ungrab_key(AnyKey, AnyModifier, X11::get_root_window());
 }
 
 void WindowManager::scan_outputs()
@@ -247,12 +365,13 @@ void WindowManager::scan_outputs()
 }
 
 
-std::shared_ptr<EshyWMWindow> WindowManager::register_window(Window window, bool b_was_created_before_window_manager)
+std::shared_ptr<EshyWMWindow> WindowManager::register_window(const X11::WindowPrefetch& prefetch, bool b_was_created_before_window_manager)
 {
+    const Window window = prefetch.window;
     if(contains_xwindow(window))
         return nullptr;
 
-    const X11::WindowAttributes window_attributes = X11::get_window_attributes(window);
+    const X11::WindowAttributes& window_attributes = prefetch.attributes;
 
     //If window was created before window manager started, we should frame it only if it is visible and does not set override_redirect
     if (b_was_created_before_window_manager && (window_attributes.override_redirect || window_attributes.map_state != IsViewable))
@@ -260,10 +379,14 @@ std::shared_ptr<EshyWMWindow> WindowManager::register_window(Window window, bool
 
     XAddToSaveSet(X11::get_display(), window);
 
-    auto new_window = std::make_shared<EshyWMWindow>(window);
-    new_window->initialize(window_attributes);
+    auto new_window = std::make_shared<EshyWMWindow>(prefetch);
+    new_window->initialize(prefetch);
     new_window->frame_window();
     window_list.push_back(new_window);
+    index_window(new_window);
+
+    //Tiled next to the focused window, which is focused before the new one is
+    new_window->parent_workspace->add_tiled_window(new_window, focused_window && focused_window->parent_workspace == new_window->parent_workspace ? focused_window.get() : nullptr);
 
     EshyWM::window_created_notify(new_window);
     return new_window;
@@ -306,6 +429,7 @@ void WindowManager::focus_window(std::shared_ptr<EshyWMWindow> window, bool b_ra
     {
         focused_window = nullptr;
         X11::focus_window(X11::get_root_window());
+        EshyWM::focus_changed_notify();
         return;
     }
 
@@ -314,6 +438,7 @@ void WindowManager::focus_window(std::shared_ptr<EshyWMWindow> window, bool b_ra
     X11::focus_window(window->get_window());
 
     focused_window = window;
+    EshyWM::focus_changed_notify();
 
     if(b_raise)
     {
@@ -356,14 +481,8 @@ void WindowManager::handle_button_hovered(Window hovered_window, bool b_hovered,
 
         if(!currently_hovered_button)
         {
-            for(auto window : window_list)
-            {
-                if(window->get_close_button() && window->get_close_button()->get_window() == hovered_window)
-                {
-                    currently_hovered_button = window->get_close_button();
-                    break;
-                }
-            }
+            if(auto window = find_xwindow(hovered_window, WR_CloseButton))
+                currently_hovered_button = window->get_close_button();
         }
 
         if(currently_hovered_button)
@@ -405,38 +524,46 @@ void WindowManager::OnUnmapNotify(const XUnmapEvent& event)
      * Destroy notify is not run for popups so I cannot place this logic there.
     */
     if (auto window = contains_xwindow(event.window))
+        unmanage_window(window);
+}
+
+//Takes the window out of everything that tracks it and unframes it, the client window itself is left alone
+void WindowManager::unmanage_window(std::shared_ptr<EshyWMWindow> window)
+{
+    if(currently_hovered_button == window->get_close_button())
     {
-        if(currently_hovered_button == window->get_close_button())
-        {
-            currently_hovered_button = nullptr;
-        }
-        
-        window->unframe_window();
-        EshyWM::window_destroyed_notify(window);
-        window_list.erase(std::ranges::find(window_list, window));
+        currently_hovered_button = nullptr;
+    }
+    
+    unindex_window(window);
+    window->parent_workspace->remove_tiled_window(window.get());
+    window->unframe_window();
+    EshyWM::window_destroyed_notify(window);
+    window_list.erase(std::ranges::find(window_list, window));
 
-        if(focused_window == window)
-        {
-            auto new_window = window_list.size() > 0 ? window_list[0] : nullptr;
-            const bool b_raise_window = window_list.size() > 0 && focused_window == window_list[0];
-            focus_window(new_window, b_raise_window);
-        }
+    if(focused_window == window)
+    {
+        auto new_window = window_list.size() > 0 ? window_list[0] : nullptr;
+        const bool b_raise_window = window_list.size() > 0 && focused_window == window_list[0];
+
+        //The window is already unframed, so it must not be told it lost focus
+        focused_window = nullptr;
+        focus_window(new_window, b_raise_window);
     }
 }
 
 void WindowManager::OnMapRequest(const XMapRequestEvent& event)
 {
-    //Check if this is a dock
-    const X11::WindowProperty type_property = X11::get_window_property(event.window, X11::atoms.window_type);
-    const bool b_is_dock = type_property.status == Success && type_property.format == 32 && type_property.n_items > 0 &&
-        std::ranges::contains(std::span((Atom*)type_property.property_value, type_property.n_items), X11::atoms.window_type_dock);
+    //Everything needed to frame the window is requested at once
+    const X11::WindowPrefetch prefetch = X11::prefetch_window(event.window);
 
-    if(b_is_dock)
+    //Check if this is a dock
+    if(std::ranges::contains(prefetch.window_type, X11::atoms.window_type_dock))
     {
         register_dock(event.window, false);
         X11::map_window(event.window);
     }
-    else if(auto window = register_window(event.window, false))
+    else if(auto window = register_window(prefetch, false))
     {
         X11::map_window(event.window);
         focus_window(window, true);
@@ -445,22 +572,33 @@ void WindowManager::OnMapRequest(const XMapRequestEvent& event)
 
 void WindowManager::OnPropertyNotify(const XPropertyEvent& event)
 {
-    //@TEMP: hashmap
-    if (auto window = contains_xwindow(event.window))
-        window->update_titlebar();
+    //Only the consumers of the property that changed are updated, most property changes of busy clients are ignored
+    auto window = contains_xwindow(event.window);
+    const uint8_t consumers = window ? window->get_properties().invalidate(event.atom)
+        : event.atom == X11::atoms.window_type ? PC_Dock
+        : PC_NONE;
 
-    if (event.atom == X11::atoms.window_type)
+    if (consumers & PC_Titlebar)
     {
-        const X11::WindowProperty type_property = X11::get_window_property(event.window, X11::atoms.window_type);
-        const bool b_is_dock = type_property.status == Success && type_property.format == 32 && type_property.n_items > 0 &&
-            std::ranges::contains(std::span((Atom*)type_property.property_value, type_property.n_items), X11::atoms.window_type_dock);
+        window->update_title();
+        EshyWM::window_title_changed_notify(window);
+    }
 
+    if (consumers & PC_Icon)
+    {
+        window->update_icon();
+        EshyWM::window_icon_changed_notify(window);
+    }
+
+    if (consumers & PC_Dock)
+    {
+        const bool b_is_dock = window ? window->get_properties().is_dock() : WindowPropertyCache(event.window).is_dock();
         if(!b_is_dock)
             return;
 
-        //Window type is dock. Unframe and dock the window.
-        if (auto window = contains_xwindow(event.window))
-            window->unframe_window();
+        //Window type is dock. It stops being a managed window, leaving its tile and the switcher, and is docked.
+        if (window)
+            unmanage_window(window);
 
         register_dock(event.window, false);
     }
@@ -486,7 +624,6 @@ void WindowManager::OnConfigureRequest(const XConfigureRequestEvent& event)
     changes.sibling = event.above;
     changes.stack_mode = event.detail;
 
-    //@TEMP: hashmap
     if (auto window = contains_xwindow(event.window))
     {
         changes.y -= EshyWMConfig::titlebar_height;
@@ -498,14 +635,8 @@ void WindowManager::OnConfigureRequest(const XConfigureRequestEvent& event)
 
 void WindowManager::OnVisibilityNotify(const XVisibilityEvent& event)
 {
-    for(auto window : window_list)
-    {
-        if(event.window != window->get_titlebar())
-            continue;
-        
+    if (auto window = find_xwindow(event.window, WR_Titlebar))
         window->update_titlebar();
-        break;
-    }
 }
 
 void WindowManager::OnButtonPress(const XButtonEvent& event)
@@ -565,6 +696,16 @@ void WindowManager::OnButtonRelease(const XButtonEvent& event)
         return;
     }
 
+    //Clicks are grabbed on the root window, the bar is the child they landed in
+    for (std::shared_ptr<EshyWMStatusBar> status_bar : EshyWM::status_bars)
+    {
+        if (event.subwindow != status_bar->get_menu_window())
+            continue;
+
+        status_bar->button_clicked(event.x_root - status_bar->get_output()->geometry.x, event.y_root);
+        return;
+    }
+
     if (currently_hovered_button)
         currently_hovered_button->click();
     
@@ -608,148 +749,32 @@ void WindowManager::OnKeyPress(const XKeyEvent& event)
         X11::allow_events(ReplayKeyboard, event.time);
         return;
     }
-    
-    //Yes these are annoying, but they help readibility significantly
-    #define CHECK_KEYSYM_PRESSED(event, key_sym)                    if(event.keycode == XKeysymToKeycode(X11::get_display(), key_sym))
-    #define ELSE_CHECK_KEYSYM_PRESSED(event, key_sym)               else if(event.keycode == XKeysymToKeycode(X11::get_display(), key_sym))
-    #define CHECK_KEYSYM_AND_MOD_PRESSED(event, mod, key_sym)       if(event.state & mod && event.keycode == XKeysymToKeycode(X11::get_display(), key_sym))
-    #define ELSE_CHECK_KEYSYM_AND_MOD_PRESSED(event, mod, key_sym)  else if(event.state & mod && event.keycode == XKeysymToKeycode(X11::get_display(), key_sym))
-
-    #define CHECK_WINDOW_RESIZE_CONDITIONS                          if (event.state & ShiftMask && event.state & ControlMask)
-    #define CHECK_WINDOW_SHIFT_MONITOR_CONDITIONS                   else if (event.state & ShiftMask)
-    #define CHECK_WINDOW_MOVE_CONDITIONS                            else if (event.state & ControlMask)
-    #define CHECK_WINDOW_ANCHOR_CONDITIONS                          else
-
-    auto attempt_activate_workspace = [this](int num) {
-        const Pos cursor_position = X11::get_cursor_position();
-        if (auto output = output_at_position(cursor_position.x, cursor_position.y))
-        {
-            for (auto workspace : workspaces | std::views::filter([num](auto workspace) {return workspace->num == num;}))
-                output->activate_workspace(workspace);
-        }
-    };
 
-    CHECK_KEYSYM_AND_MOD_PRESSED(event, Mod1Mask, XK_Tab)
-    {
-        SWITCHER->show();
-        SWITCHER->next_option();
-    }
-    ELSE_CHECK_KEYSYM_AND_MOD_PRESSED(event, Mod4Mask, XK_e | XK_E)
-    EshyWM::b_terminate = true;
-    ELSE_CHECK_KEYSYM_AND_MOD_PRESSED(event, Mod4Mask, XK_t | XK_T)
-    {
-        EshyWMConfig::titlebar = !EshyWMConfig::titlebar;
-        for(auto window : window_list)
-            window->set_show_titlebar(EshyWMConfig::titlebar);
-    }
-    ELSE_CHECK_KEYSYM_AND_MOD_PRESSED(event, Mod4Mask, XK_b | XK_B)
-    {
-        b_show_window_borders = !b_show_window_borders;
-        for(auto window : window_list)
-            window->set_show_border(b_show_window_borders);
-    }
-    ELSE_CHECK_KEYSYM_AND_MOD_PRESSED(event, Mod4Mask, XK_1)
-    attempt_activate_workspace(0);
-    ELSE_CHECK_KEYSYM_AND_MOD_PRESSED(event, Mod4Mask, XK_2)
-    attempt_activate_workspace(1);
-    ELSE_CHECK_KEYSYM_AND_MOD_PRESSED(event, Mod4Mask, XK_3)
-    attempt_activate_workspace(2);
-    ELSE_CHECK_KEYSYM_AND_MOD_PRESSED(event, Mod4Mask, XK_4)
-    attempt_activate_workspace(3);
-    ELSE_CHECK_KEYSYM_AND_MOD_PRESSED(event, Mod4Mask, XK_5)
-    attempt_activate_workspace(4);
-    ELSE_CHECK_KEYSYM_AND_MOD_PRESSED(event, Mod4Mask, XK_6)
-    attempt_activate_workspace(5);
-    ELSE_CHECK_KEYSYM_AND_MOD_PRESSED(event, Mod4Mask, XK_7)
-    attempt_activate_workspace(6);
-    ELSE_CHECK_KEYSYM_AND_MOD_PRESSED(event, Mod4Mask, XK_8)
-    attempt_activate_workspace(7);
-    ELSE_CHECK_KEYSYM_AND_MOD_PRESSED(event, Mod4Mask, XK_9)
-    attempt_activate_workspace(8);
-
-    for(EshyWMConfig::KeyBinding key_binding : EshyWMConfig::key_bindings)
-    {
-        CHECK_KEYSYM_AND_MOD_PRESSED(event, Mod4Mask, key_binding.key)
-        system(key_binding.command.c_str());
-    }
-
-    if(!focused_window || !(event.state & Mod4Mask))
-    {
-        X11::allow_events(ReplayKeyboard, event.time);
+    //The switcher grabs the keyboard while it is open, typing filters it
+    if (SWITCHER && SWITCHER->filter_key_pressed(event))
         return;
-    }
 
-    b_manipulating_with_keys = true;
-    manipulating_window_geometry = focused_window->get_frame_geometry();
-
-    CHECK_KEYSYM_PRESSED(event, XK_C)
-    focused_window->close_window();
-    ELSE_CHECK_KEYSYM_PRESSED(event, XK_d | XK_D)
-    focused_window->toggle_maximize();
-    ELSE_CHECK_KEYSYM_PRESSED(event, XK_f | XK_F)
-    focused_window->toggle_fullscreen();
-    ELSE_CHECK_KEYSYM_PRESSED(event, XK_a | XK_A)
-    focused_window->toggle_minimize();
-    ELSE_CHECK_KEYSYM_PRESSED(event, XK_Left)
-    {
-        CHECK_WINDOW_RESIZE_CONDITIONS
-        focused_window->resize_window_absolute(std::max((int)manipulating_window_geometry.width - EshyWMConfig::window_width_resize_step, 10), manipulating_window_geometry.height, false);
-        CHECK_WINDOW_SHIFT_MONITOR_CONDITIONS
-        focused_window->attempt_shift_monitor(WS_ANCHORED_LEFT);
-        CHECK_WINDOW_MOVE_CONDITIONS
-        focused_window->move_window_absolute(manipulating_window_geometry.x - EshyWMConfig::window_x_movement_step, manipulating_window_geometry.y, false);
-        CHECK_WINDOW_ANCHOR_CONDITIONS
-        focused_window->anchor_window(WS_ANCHORED_LEFT);
-    }
-    ELSE_CHECK_KEYSYM_PRESSED(event, XK_Up)
-    {
-        CHECK_WINDOW_RESIZE_CONDITIONS
-        focused_window->resize_window_absolute(manipulating_window_geometry.width, std::max((int)manipulating_window_geometry.height - EshyWMConfig::window_height_resize_step, 10), false);
-        CHECK_WINDOW_SHIFT_MONITOR_CONDITIONS
-        focused_window->attempt_shift_monitor(WS_ANCHORED_UP);
-        CHECK_WINDOW_MOVE_CONDITIONS
-        focused_window->move_window_absolute(manipulating_window_geometry.x, manipulating_window_geometry.y - EshyWMConfig::window_y_movement_step, false);
-        CHECK_WINDOW_ANCHOR_CONDITIONS
-        focused_window->anchor_window(WS_ANCHORED_UP);
-    }
-    ELSE_CHECK_KEYSYM_PRESSED(event, XK_Right)
-    {
-        CHECK_WINDOW_RESIZE_CONDITIONS
-        focused_window->resize_window_absolute(std::max((int)manipulating_window_geometry.width + EshyWMConfig::window_width_resize_step, 10), manipulating_window_geometry.height, false);
-        CHECK_WINDOW_SHIFT_MONITOR_CONDITIONS
-        focused_window->attempt_shift_monitor(WS_ANCHORED_RIGHT);
-        CHECK_WINDOW_MOVE_CONDITIONS
-        focused_window->move_window_absolute(manipulating_window_geometry.x + EshyWMConfig::window_x_movement_step, manipulating_window_geometry.y, false);
-        CHECK_WINDOW_ANCHOR_CONDITIONS
-        focused_window->anchor_window(WS_ANCHORED_RIGHT);
-    }
-    ELSE_CHECK_KEYSYM_PRESSED(event, XK_Down)
-    {
-        CHECK_WINDOW_RESIZE_CONDITIONS
-        focused_window->resize_window_absolute(manipulating_window_geometry.width, std::max((int)manipulating_window_geometry.height + EshyWMConfig::window_height_resize_step, 10), false);
-        CHECK_WINDOW_SHIFT_MONITOR_CONDITIONS
-        focused_window->attempt_shift_monitor(WS_ANCHORED_DOWN);
-        CHECK_WINDOW_MOVE_CONDITIONS
-        focused_window->move_window_absolute(manipulating_window_geometry.x, manipulating_window_geometry.y + EshyWMConfig::window_y_movement_step, false);
-        CHECK_WINDOW_ANCHOR_CONDITIONS
-        focused_window->anchor_window(WS_ANCHORED_DOWN);
-    }
-
-    #undef CHECK_KEYSYM_PRESSED
-    #undef ELSE_CHECK_KEYSYM_PRESSED
-    #undef CHECK_KEYSYM_AND_MOD_PRESSED
-    #undef ELSE_CHECK_KEYSYM_AND_MOD_PRESSED
-    #undef CHECK_WINDOW_RESIZE_CONDITIONS
-    #undef CHECK_WINDOW_SHIFT_MONITOR_CONDITIONS
-    #undef CHECK_WINDOW_MOVE_CONDITIONS
-    #undef CHECK_WINDOW_ANCHOR_CONDITIONS
+    if (const uint32_t* action_index = key_action_table.find(key_action_key(event.keycode, event.state)))
+    {
+        const key_action& action = key_actions[*action_index];
+        if (!action.b_window_action)
+        {
+            action.callback();
+        }
+        else if (focused_window)
+        {
+            b_manipulating_with_keys = true;
+            manipulating_window_geometry = focused_window->get_frame_geometry();
+            action.callback();
+        }
+    }
 
     X11::allow_events(ReplayKeyboard, event.time);
 }
 
 void WindowManager::OnKeyRelease(const XKeyEvent& event)
 {
-    if(SWITCHER && SWITCHER->get_menu_active() && event.keycode == XKeysymToKeycode(X11::get_display(), XK_Alt_L))
+    if(SWITCHER && SWITCHER->get_menu_active() && event.keycode == switcher_confirm_keycode)
         SWITCHER->confirm_choice();
 
     b_manipulating_with_keys = false;
@@ -757,11 +782,10 @@ void WindowManager::OnKeyRelease(const XKeyEvent& event)
 
 void WindowManager::OnEnterNotify(const XCrossingEvent& event)
 {
-    auto it = std::ranges::find_if(window_list, [frame = event.window](auto w) {return w->get_frame() == frame;});
-    if (it != window_list.end())
+    if (auto window = find_xwindow(event.window, WR_Frame))
     {
         if (!b_manipulating_with_keys)
-            focus_window(*it, false);
+            focus_window(window, false);
     }
     else
         handle_button_hovered(event.window, true, event.mode);
@@ -769,15 +793,51 @@ void WindowManager::OnEnterNotify(const XCrossingEvent& event)
 
 void WindowManager::OnClientMessage(const XClientMessageEvent& event)
 {
-    //@TEMP: hashmap
     auto window = contains_xwindow(event.window);
     if (window && event.message_type == X11::atoms.state && (event.data.l[1] == X11::atoms.state_fullscreen || event.data.l[2] == X11::atoms.state_fullscreen))
         window->fullscreen_window(event.data.l[0]);
 }
 
+void WindowManager::OnMappingNotify(XMappingEvent& event)
+{
+    XRefreshKeyboardMapping(&event);
+    if (event.request != MappingKeyboard && event.request != MappingModifier)
+        return;
+
+    //Keysyms may be on other keycodes now, so the grabs and the table are made again from them
+    ungrab_keys();
+    grab_keys();
+    build_key_action_table();
+}
+
+
+void WindowManager::index_window(std::shared_ptr<EshyWMWindow> window)
+{
+    xwindow_index.insert_or_assign(window->get_window(), {window, WR_Client});
+    xwindow_index.insert_or_assign(window->get_frame(), {window, WR_Frame});
+    xwindow_index.insert_or_assign(window->get_titlebar(), {window, WR_Titlebar});
+
+    if(window->get_close_button())
+        xwindow_index.insert_or_assign(window->get_close_button()->get_window(), {window, WR_CloseButton});
+}
+
+void WindowManager::unindex_window(std::shared_ptr<EshyWMWindow> window)
+{
+    xwindow_index.erase(window->get_window());
+    xwindow_index.erase(window->get_frame());
+    xwindow_index.erase(window->get_titlebar());
+
+    if(window->get_close_button())
+        xwindow_index.erase(window->get_close_button()->get_window());
+}
+
+std::shared_ptr<EshyWMWindow> WindowManager::find_xwindow(Window xwindow, EWindowRole role) const
+{
+    const indexed_xwindow* entry = xwindow_index.find(xwindow);
+    return entry && entry->role == role ? entry->window : nullptr;
+}
 
 std::shared_ptr<EshyWMWindow> WindowManager::contains_xwindow(Window window)
 {
-    auto it = std::ranges::find_if(window_list, [window](auto w) {return w->get_window() == window;});
-    return it != window_list.end() ? *it : nullptr;
+    return find_xwindow(window, WR_Client);
 }
\ No newline at end of file
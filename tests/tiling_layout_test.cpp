@@ -0,0 +1,146 @@
+#include "tiling_layout.h"
+#include "config.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+static int failures = 0;
+
+#define EXPECT(condition) \
+    if (!(condition)) { fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #condition); failures++; }
+
+uint EshyWMConfig::tiling_gap = 0;
+float EshyWMConfig::tiling_master_ratio = 0.5f;
+
+//Only holds the tile the layout last applied to it
+class EshyWMWindow
+{
+public:
+
+    Rect tile = {0};
+};
+
+Rect get_window_tile(const EshyWMWindow* window)
+{
+    return window->tile;
+}
+
+void tile_windows(const std::vector<window_tile>& tiles)
+{
+    for (const window_tile& tile : tiles)
+        tile.window->tile = tile.geometry;
+}
+
+static bool is_tile(const std::shared_ptr<EshyWMWindow>& window, int x, int y, uint width, uint height)
+{
+    return window->tile.x == x && window->tile.y == y && window->tile.width == width && window->tile.height == height;
+}
+
+static const Rect BOUNDS = {0, 0, 1000, 600};
+
+//A removed leaf's sibling takes over the parent's space, whether it is a window or a subtree
+static void test_bsp_sibling_pull_up()
+{
+    EshyWMConfig::tiling_gap = 0;
+
+    std::shared_ptr<TilingLayout> layout = create_tiling_layout(LT_BSP, BOUNDS);
+    const auto a = std::make_shared<EshyWMWindow>();
+    const auto b = std::make_shared<EshyWMWindow>();
+    const auto c = std::make_shared<EshyWMWindow>();
+
+    layout->add_window(a, nullptr);
+    layout->add_window(b, a.get());
+    layout->add_window(c, b.get());
+    layout->apply();
+
+    EXPECT(is_tile(a, 0, 0, 500, 600));
+    EXPECT(is_tile(b, 500, 0, 500, 300));
+    EXPECT(is_tile(c, 500, 300, 500, 300));
+
+    //The leaf sibling c takes the half b shared with it
+    EXPECT(layout->remove_window(b.get()));
+    layout->apply();
+    EXPECT(is_tile(a, 0, 0, 500, 600));
+    EXPECT(is_tile(c, 500, 0, 500, 600));
+    EXPECT(!layout->remove_window(b.get()));
+
+    //The subtree sibling of a is pulled up to the root and split again
+    const auto d = std::make_shared<EshyWMWindow>();
+    layout->add_window(d, c.get());
+    EXPECT(layout->remove_window(a.get()));
+    layout->apply();
+    EXPECT(is_tile(c, 0, 0, 500, 600));
+    EXPECT(is_tile(d, 500, 0, 500, 600));
+
+    const std::vector<std::shared_ptr<EshyWMWindow>> windows = layout->get_windows();
+    EXPECT(windows.size() == 2 && windows[0] == c && windows[1] == d);
+}
+
+//The first stacked window becomes the master, the last window left takes the whole workspace
+static void test_master_stack_master_removal()
+{
+    EshyWMConfig::tiling_gap = 0;
+
+    std::shared_ptr<TilingLayout> layout = create_tiling_layout(LT_MasterStack, BOUNDS);
+    const auto a = std::make_shared<EshyWMWindow>();
+    const auto b = std::make_shared<EshyWMWindow>();
+    const auto c = std::make_shared<EshyWMWindow>();
+
+    layout->add_window(a, nullptr);
+    layout->add_window(b, a.get());
+    layout->add_window(c, b.get());
+    layout->apply();
+
+    EXPECT(is_tile(a, 0, 0, 500, 600));
+    EXPECT(is_tile(b, 500, 0, 500, 300));
+    EXPECT(is_tile(c, 500, 300, 500, 300));
+
+    EXPECT(layout->remove_window(a.get()));
+    layout->apply();
+    EXPECT(is_tile(b, 0, 0, 500, 600));
+    EXPECT(is_tile(c, 500, 0, 500, 600));
+
+    EXPECT(layout->remove_window(b.get()));
+    layout->apply();
+    EXPECT(is_tile(c, 0, 0, 1000, 600));
+}
+
+//Neighbouring tiles are one gap apart, the same as from the workspace edge
+static void test_gap_is_even()
+{
+    EshyWMConfig::tiling_gap = 10;
+
+    std::shared_ptr<TilingLayout> layout = create_tiling_layout(LT_MasterStack, BOUNDS);
+    const auto a = std::make_shared<EshyWMWindow>();
+    const auto b = std::make_shared<EshyWMWindow>();
+    const auto c = std::make_shared<EshyWMWindow>();
+
+    layout->add_window(a, nullptr);
+    layout->add_window(b, a.get());
+    layout->add_window(c, b.get());
+    layout->apply();
+
+    EXPECT(is_tile(a, 10, 10, 485, 580));
+    EXPECT(is_tile(b, 505, 10, 485, 285));
+    EXPECT(is_tile(c, 505, 305, 485, 285));
+
+    //An odd gap is split unevenly between the two sides but still adds up
+    EshyWMConfig::tiling_gap = 7;
+    layout->relayout();
+    layout->apply();
+    EXPECT(a->tile.x + (int)a->tile.width + 7 == b->tile.x);
+    EXPECT(b->tile.y + (int)b->tile.height + 7 == c->tile.y);
+    EXPECT(c->tile.y + (int)c->tile.height + 7 == BOUNDS.y + (int)BOUNDS.height);
+}
+
+int main()
+{
+    test_bsp_sibling_pull_up();
+    test_master_stack_master_removal();
+    test_gap_is_even();
+
+    if (failures == 0)
+        printf("tiling_layout_test: all passed\n");
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
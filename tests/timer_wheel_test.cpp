@@ -0,0 +1,81 @@
+#include "timer_wheel.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+static int failures = 0;
+
+#define EXPECT(condition) \
+    if (!(condition)) { fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #condition); failures++; }
+
+//Expiries that cross the end of the top level's rotation land in slots before the current one
+static void test_crosses_top_level_rotation()
+{
+    const uint64_t rotation = uint64_t(1) << 24;
+
+    for (const uint64_t start : {rotation - 100, rotation - 1, 3 * rotation - 7, rotation - (uint64_t(1) << 18) - 5})
+    {
+        TimerWheel wheel(start);
+        std::vector<uint64_t> fired;
+        uint64_t tick = start;
+        wheel.add(8, [&fired, &tick](){ fired.push_back(tick); });
+
+        //Track the tick the wheel was advanced to so the callback can record it
+        const uint64_t end_tick = start + 1000;
+        while (std::optional<uint64_t> next_tick = wheel.get_next_tick())
+        {
+            if (*next_tick > end_tick)
+                break;
+
+            tick = *next_tick;
+            wheel.advance(tick);
+        }
+
+        EXPECT(wheel.get_next_tick().has_value());
+        EXPECT(fired.size() == 125);
+        for (size_t i = 0; i < fired.size(); i++)
+            EXPECT(fired[i] == (start / 8 + 1 + i) * 8);
+    }
+}
+
+//A timer further away than the wheel covers is parked and still expires on time
+static void test_long_interval_across_rotation()
+{
+    const uint64_t rotation = uint64_t(1) << 24;
+    const uint64_t start = rotation - 3;
+
+    TimerWheel wheel(start);
+    uint64_t tick = start;
+    std::vector<uint64_t> fired;
+    wheel.add(rotation + 12345, [&fired, &tick](){ fired.push_back(tick); });
+
+    for (int i = 0; i < 1000 && fired.size() < 2; i++)
+    {
+        const std::optional<uint64_t> next_tick = wheel.get_next_tick();
+        EXPECT(next_tick.has_value());
+        if (!next_tick)
+            break;
+
+        tick = *next_tick;
+        wheel.advance(tick);
+    }
+
+    EXPECT(fired.size() == 2);
+    if (fired.size() == 2)
+    {
+        EXPECT(fired[0] == rotation + 12345);
+        EXPECT(fired[1] == 2 * (rotation + 12345));
+    }
+}
+
+int main()
+{
+    test_crosses_top_level_rotation();
+    test_long_interval_across_rotation();
+
+    if (failures == 0)
+        printf("timer_wheel_test: all passed\n");
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}